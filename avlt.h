@@ -12,714 +12,4256 @@
 #pragma once
 
 #include <iostream>
+#include <fstream>
+#include <string>
 #include <vector>
-#include <stack>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <future>
+#include <thread>
+#include <exception>
+#include <memory>
+#include <atomic>
+
+#if __cplusplus > 201703L
+#include <compare>
+#endif
+
+#include "frozen_avlt.h"
+#include "avlt_file.h"
+
+//
+// software prefetch hint, a no-op where the compiler has none:
+//
+#if defined(__GNUC__)
+#define AVLT_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define AVLT_PREFETCH(p) ((void) 0)
+#endif
 
 using namespace std;
 
-template<typename KeyT, typename ValueT>
+//
+// avlt_links:
+//
+// The fields every avlt node has besides its key and value; they come
+// first so that the optional subtree count below fits in what would
+// otherwise be padding.
+//
+template<typename NodeT>
+struct avlt_links
+{
+  NodeT* Left;
+  NodeT* Right;
+  bool   isThreaded; // true => Right is a thread, false => non-threaded
+  int    Height;     // height of tree rooted at this node
+
+  avlt_links()
+    : Left(nullptr), Right(nullptr), isThreaded(true), Height(0)
+  { }
+};
+
+//
+// avlt_counted:
+//
+// Adds the # of nodes in the subtree to the links of order-statistic
+// trees, avlt<KeyT, ValueT, true>; other trees pay nothing for it.
+//
+template<typename NodeT, bool Counted>
+struct avlt_counted : avlt_links<NodeT>
+{ };
+
+template<typename NodeT>
+struct avlt_counted<NodeT, true> : avlt_links<NodeT>
+{
+  int Count;         // # of nodes in tree rooted at this node
+
+  avlt_counted()
+    : Count(1)
+  { }
+};
+
+//
+// Aggregate policies:
+//
+// An aggregate is an associative "combine" over the values of a run of
+// keys, with an "identity" for the empty run; "lift" turns one value
+// into an aggregate.  A tree with an aggregate policy caches the
+// aggregate of every subtree in its root, so aggregate(lower, upper)
+// needs only O(lgN) of them.  combine need not be commutative; it is
+// always applied in key order.
+//
+struct avlt_no_aggregate
+{
+  typedef void type;
+};
+
+template<typename T>
+struct avlt_sum
+{
+  typedef T type;
+
+  static T identity() { return T{ }; }
+  static T lift(const T& value) { return value; }
+  static T combine(const T& a, const T& b) { return a + b; }
+};
+
+template<typename T>
+struct avlt_min
+{
+  typedef T type;
+
+  static T identity() { return numeric_limits<T>::max(); }
+  static T lift(const T& value) { return value; }
+  static T combine(const T& a, const T& b) { return b < a ? b : a; }
+};
+
+template<typename T>
+struct avlt_max
+{
+  typedef T type;
+
+  static T identity() { return numeric_limits<T>::lowest(); }
+  static T lift(const T& value) { return value; }
+  static T combine(const T& a, const T& b) { return a < b ? b : a; }
+};
+
+//
+// avlt_aggregated:
+//
+// Adds the aggregate of the subtree to the nodes of trees with an
+// aggregate policy; other trees pay nothing for it.
+//
+template<typename Base, typename Aggregate>
+struct avlt_aggregated : Base
+{
+  typename Aggregate::type Agg;  // aggregate of tree rooted at this node
+};
+
+template<typename Base>
+struct avlt_aggregated<Base, avlt_no_aggregate> : Base
+{ };
+
+//
+// Stats policies:
+//
+// A tree with the avlt_stats policy counts what its hot paths do, for
+// finding out whether slow operations come from deep paths, rotations
+// or allocation; stats() returns a snapshot of the counts.  The default
+// avlt_no_stats policy has nothing to count with, and every call to it
+// is an empty inline function, so uninstrumented trees pay nothing.
+//
+enum avlt_stat
+{
+  AVLT_LOOKUPS,           // descents from the root, and search_batch finger walks
+  AVLT_COMPARISONS,       // key comparisons made by those descents
+  AVLT_PATH_NODES,        // nodes visited by those descents
+  AVLT_SINGLE_ROTATIONS,  // inserts rebalanced by one rotation
+  AVLT_DOUBLE_ROTATIONS,  // inserts rebalanced by two
+  AVLT_LEFT_ROTATIONS,    // leftRotate calls, by inserts and erases
+  AVLT_RIGHT_ROTATIONS,   // rightRotate calls, by inserts and erases
+  AVLT_ALLOCATIONS,       // nodes allocated
+  AVLT_NEXTS,             // next() calls that returned a key
+  AVLT_THREAD_HOPS,       // next() and search_batch steps that followed a thread
+  AVLT_STAT_COUNT
+};
+
+struct avlt_stats_snapshot
+{
+  uint64_t Lookups;
+  uint64_t Comparisons;
+  uint64_t PathNodes;
+  uint64_t SingleRotations;
+  uint64_t DoubleRotations;
+  uint64_t LeftRotations;
+  uint64_t RightRotations;
+  uint64_t Allocations;
+  uint64_t Nexts;
+  uint64_t ThreadHops;
+};
+
+//
+// lookups by the # of nodes they visited and the # of comparisons they
+// made; the last bucket also holds everything larger.
+//
+struct avlt_stats_histogram
+{
+  static const int BUCKETS = 128;
+
+  uint64_t PathNodes[BUCKETS];
+  uint64_t Comparisons[BUCKETS];
+};
+
+struct avlt_no_stats
+{
+  void add(avlt_stat, uint64_t = 1) const { }
+  void lookup(unsigned, unsigned) const { }
+  void reset() { }
+
+  avlt_stats_snapshot snapshot() const { return avlt_stats_snapshot(); }
+};
+
+//
+// avlt_stats<true> also keeps a histogram of the lookups made by each
+// thread, in all the trees with that policy; thread_histogram() is the
+// calling thread's.  The counts are relaxed atomics, so a tree that is
+// read by many threads at once counts correctly, and a copy of a tree
+// starts counting from zero.
+//
+template<bool PerThreadHistograms = false>
+class avlt_stats
+{
+private:
+  mutable atomic<uint64_t> Counts[AVLT_STAT_COUNT];
+
+  uint64_t _get(avlt_stat which) const
+  {
+    return Counts[which].load(memory_order_relaxed);
+  }
+
+public:
+  avlt_stats() { reset(); }
+  avlt_stats(const avlt_stats&) { reset(); }
+  avlt_stats& operator=(const avlt_stats&) { return *this; }
+
+  void add(avlt_stat which, uint64_t n = 1) const
+  {
+    Counts[which].fetch_add(n, memory_order_relaxed);
+  }
+
+  void lookup(unsigned comparisons, unsigned nodes) const
+  {
+    add(AVLT_LOOKUPS);
+    add(AVLT_COMPARISONS, comparisons);
+    add(AVLT_PATH_NODES, nodes);
+
+    if (PerThreadHistograms)
+    {
+      avlt_stats_histogram& histogram = thread_histogram();
+      const unsigned last = avlt_stats_histogram::BUCKETS - 1;
+
+      histogram.PathNodes[std::min(nodes, last)]++;
+      histogram.Comparisons[std::min(comparisons, last)]++;
+    }
+  }
+
+  void reset()
+  {
+    for (auto& count : Counts)
+      count.store(0, memory_order_relaxed);
+  }
+
+  avlt_stats_snapshot snapshot() const
+  {
+    avlt_stats_snapshot s;
+
+    s.Lookups = _get(AVLT_LOOKUPS);
+    s.Comparisons = _get(AVLT_COMPARISONS);
+    s.PathNodes = _get(AVLT_PATH_NODES);
+    s.SingleRotations = _get(AVLT_SINGLE_ROTATIONS);
+    s.DoubleRotations = _get(AVLT_DOUBLE_ROTATIONS);
+    s.LeftRotations = _get(AVLT_LEFT_ROTATIONS);
+    s.RightRotations = _get(AVLT_RIGHT_ROTATIONS);
+    s.Allocations = _get(AVLT_ALLOCATIONS);
+    s.Nexts = _get(AVLT_NEXTS);
+    s.ThreadHops = _get(AVLT_THREAD_HOPS);
+
+    return s;
+  }
+
+  static avlt_stats_histogram& thread_histogram()
+  {
+    static thread_local avlt_stats_histogram histogram;  // zeroed, as a static
+    return histogram;
+  }
+};
+
+//
+// Comparators:
+//
+// The Compare parameter orders the keys, as for std::map: comp(a, b) is
+// true when a goes before b.  A Compare that also has a three-way
+// comp.compare(a, b), < 0, 0 or > 0 as a goes before, with or after b,
+// lets each level of a search decide with one comparison instead of
+// two, which matters for keys such as strings.  A Compare with an
+// is_transparent type allows lookups by any type it can compare with
+// the keys, e.g. a string_view in an avlt<string, ...>, without making
+// a KeyT to search for.
+//
+// avlt_less<KeyT>, the default, orders by <; avlt_less<> is the same,
+// but transparent.  Their compare() uses the key's own compare() where
+// it has one (std::string does), then <=> under C++20, then <.
+//
+template<typename A, typename B>
+auto _avlt_three_way(const A& a, const B& b, int) -> decltype((int) a.compare(b))
+{
+  return a.compare(b);
+}
+
+#if __cplusplus > 201703L
+template<typename A, typename B>
+auto _avlt_three_way(const A& a, const B& b, long) -> decltype(a <=> b < 0, 0)
+{
+  auto c = a <=> b;
+  return c < 0 ? -1 : (c > 0 ? 1 : 0);
+}
+#endif
+
+template<typename A, typename B>
+int _avlt_three_way(const A& a, const B& b, ...)
+{
+  return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+template<typename A, typename B>
+int avlt_three_way(const A& a, const B& b)
+{
+  return _avlt_three_way(a, b, 0);
+}
+
+template<typename T = void>
+struct avlt_less
+{
+  bool operator()(const T& a, const T& b) const { return a < b; }
+  int compare(const T& a, const T& b) const { return avlt_three_way(a, b); }
+};
+
+template<>
+struct avlt_less<void>
+{
+  typedef void is_transparent;
+
+  template<typename A, typename B>
+  bool operator()(const A& a, const B& b) const { return a < b; }
+
+  template<typename A, typename B>
+  int compare(const A& a, const B& b) const { return avlt_three_way(a, b); }
+};
+
+//
+// OrderStatistics = true keeps a subtree count in every node, which
+// rank(), select() and count_range() need, and which split() needs to
+// run in O(lgN) (without the counts it has to walk the smaller half to
+// size the two trees); an Aggregate policy such as
+// avlt_sum<ValueT> keeps a subtree aggregate for aggregate().  A Stats
+// policy of avlt_stats<> counts what the tree does, for stats().
+// Compare orders the keys, see above.
+//
+template<typename KeyT, typename ValueT, bool OrderStatistics = false,
+         typename Aggregate = avlt_no_aggregate, typename Stats = avlt_no_stats,
+         typename Compare = avlt_less<KeyT>>
 class avlt
 {
 private:
-  struct NODE
+  struct NODE : avlt_aggregated<avlt_counted<NODE, OrderStatistics>, Aggregate>
+  {
+    KeyT   Key;
+    ValueT Value;
+
+    // a new leaf; the value is built in place from args:
+    template<typename K, typename... Args>
+    NODE(K&& key, Args&&... args)
+      : Key(std::forward<K>(key)), Value(std::forward<Args>(args)...)
+    { }
+  };
+
+  typedef integral_constant<bool, OrderStatistics> COUNTED;
+  typedef integral_constant<bool, !is_same<Aggregate, avlt_no_aggregate>::value> AGGREGATED;
+  typedef typename Aggregate::type AGG;
+  typedef integral_constant<bool, is_same<Compare, avlt_less<KeyT>>::value ||
+                                  is_same<Compare, avlt_less<>>::value> LESS_ORDERED;
+
+  //
+  // the deepest AVL tree of 2^31 nodes has height < 1.45 lg(2^31) = 45,
+  // so a search path always fits in a fixed buffer of this size:
+  //
+  static const int MAX_HEIGHT = 64;
+
+  //
+  // ARENA:
+  //
+  // The chunks of raw memory that nodes are carved out of.  An arena is shared
+  // by every pool holding nodes that live in it -- after a union or a
+  // split, nodes carved out by one tree belong to another -- and its
+  // chunks are freed when the last of those pools lets go.
+  //
+  struct ARENA
+  {
+    vector<void*> Chunks;
+
+    ARENA() { }
+    ARENA(const ARENA&) = delete;
+    ARENA& operator=(const ARENA&) = delete;
+
+    ~ARENA()
+    {
+      for (void* mem : Chunks)
+        ::operator delete(mem);
+    }
+  };
+
+  //
+  // NODEPOOL:
+  //
+  // Slab allocator for the tree's nodes.  Nodes are carved out of large
+  // chunks of raw memory (64 nodes at first, doubling up to 64K nodes per
+  // chunk), and freed nodes go on a free list for reuse.  Releasing the
+  // pool returns every chunk at once, in O(chunks) rather than O(N).
+  //
+  // The pool only hands out raw storage; constructing and destroying the
+  // NODE in that storage is up to the tree (see _newNode / _freeNode).
+  //
+  class NODEPOOL
+  {
+  private:
+    shared_ptr<ARENA> Arena;         // chunks we carve new slots from
+    vector<shared_ptr<ARENA>> Held;  // other arenas some of our nodes live in
+    NODE*  FreeList;          // slots given back, linked through their first word
+    NODE*  Bump;              // next unused slot in the newest chunk
+    size_t Remaining;         // # of unused slots left at Bump
+    size_t NextChunk;         // # of slots in the next chunk we allocate
+
+    static const size_t FIRST_CHUNK = 64;
+    static const size_t MAX_CHUNK = 65536;
+
+    static NODE*& _link(NODE* slot)
+    {
+      return *reinterpret_cast<NODE**>(slot);
+    }
+
+    void _newChunk(size_t count)
+    {
+      //
+      // don't waste what is left of the current chunk:
+      //
+      while (Remaining > 0)
+      {
+        release(Bump);
+        Bump++;
+        Remaining--;
+      }
+
+      if (!Arena)
+        Arena = make_shared<ARENA>();
+      Arena->Chunks.reserve(Arena->Chunks.size() + 1);
+
+      void* mem = ::operator new(count * sizeof(NODE));
+      Arena->Chunks.push_back(mem);
+
+      Bump = static_cast<NODE*>(mem);
+      Remaining = count;
+    }
+
+    void _hold(const shared_ptr<ARENA>& arena)
+    {
+      if (arena && arena != Arena && std::find(Held.begin(), Held.end(), arena) == Held.end())
+        Held.push_back(arena);
+    }
+
+  public:
+    NODEPOOL()
+      : FreeList(nullptr), Bump(nullptr), Remaining(0), NextChunk(FIRST_CHUNK)
+    { }
+
+    NODEPOOL(const NODEPOOL&) = delete;
+    NODEPOOL& operator=(const NODEPOOL&) = delete;
+
+    ~NODEPOOL()
+    {
+      releaseAll();
+    }
+
+    //
+    // allocate: returns storage for one NODE, reusing a freed slot if
+    // there is one.
+    //
+    NODE* allocate()
+    {
+      if (FreeList != nullptr)
+      {
+        NODE* slot = FreeList;
+        FreeList = _link(slot);
+        return slot;
+      }
+
+      if (Remaining == 0)
+      {
+        _newChunk(NextChunk);
+        if (NextChunk < MAX_CHUNK)
+          NextChunk *= 2;
+      }
+
+      Remaining--;
+      return Bump++;
+    }
+
+    //
+    // release: gives the storage of an already destroyed NODE back.
+    //
+    void release(NODE* slot)
+    {
+      _link(slot) = FreeList;
+      FreeList = slot;
+    }
+
+    //
+    // reserve: guarantees the next "count" fresh slots come from one
+    // contiguous chunk, so that a bulk build lays its nodes out together.
+    //
+    void reserve(size_t count)
+    {
+      if (Remaining < count)
+        _newChunk(count);
+    }
+
+    //
+    // allocateBlock: returns storage for "count" NODEs that sit next to
+    // each other in memory.  Slots the caller ends up not using can be
+    // given back one at a time with release().
+    //
+    NODE* allocateBlock(size_t count)
+    {
+      reserve(count);
+
+      NODE* block = Bump;
+      Bump += count;
+      Remaining -= count;
+
+      return block;
+    }
+
+    //
+    // absorb: takes over the other pool's memory, for when its nodes
+    // become ours.  Its free slots join our free list; the other pool is
+    // left empty.
+    //
+    void absorb(NODEPOOL& other)
+    {
+      Held.reserve(Held.size() + other.Held.size() + 1);
+
+      _hold(other.Arena);
+      for (const shared_ptr<ARENA>& arena : other.Held)
+        _hold(arena);
+
+      while (other.FreeList != nullptr)
+      {
+        NODE* slot = other.FreeList;
+        other.FreeList = _link(slot);
+        release(slot);
+      }
+      for ( ; other.Remaining > 0; other.Remaining--)
+        release(other.Bump++);
+
+      other.releaseAll();
+    }
+
+    //
+    // share: lets the other pool hold on to our memory too, for when
+    // some of our nodes become its own.
+    //
+    void share(NODEPOOL& other)
+    {
+      other.Held.reserve(other.Held.size() + Held.size() + 1);
+
+      other._hold(Arena);
+      for (const shared_ptr<ARENA>& arena : Held)
+        other._hold(arena);
+    }
+
+    //
+    // releaseAll: lets go of every chunk; all nodes must already be
+    // destroyed (or be trivially destructible).  Chunks still holding
+    // another tree's nodes are freed along with that tree instead.
+    //
+    void releaseAll()
+    {
+      Arena.reset();
+      Held.clear();
+      FreeList = nullptr;
+      Bump = nullptr;
+      Remaining = 0;
+      NextChunk = FIRST_CHUNK;
+    }
+
+    //
+    // swap: exchanges everything two pools own, in O(1).
+    //
+    void swap(NODEPOOL& other) noexcept
+    {
+      Arena.swap(other.Arena);
+      Held.swap(other.Held);
+      std::swap(FreeList, other.FreeList);
+      std::swap(Bump, other.Bump);
+      std::swap(Remaining, other.Remaining);
+      std::swap(NextChunk, other.NextChunk);
+    }
+  };
+
+  NODE* Root;  // pointer to root node of tree (nullptr if empty)
+  int Size;  // # of nodes in the tree (0 if empty)
+  Stats Counters;  // what the hot paths did, if the policy counts anything
+  Compare Comp;  // the order of the keys
+  NODE* ptr = nullptr; //pointer to copy the node data from the begin function to the next function
+  NODEPOOL Pool;  // where all of our nodes come from
+
+  //
+  // cached right spine, Root down to the largest key, so that appending
+  // a new largest key needs no search; empty when not known (see
+  // _spineValid), which is after anything but an insert changes the tree.
+  //
+  vector<NODE*> Spine;
+  
+  //
+  // _iterator:
+  //
+  // Forward iterator over the keys in order.  It holds nothing but a
+  // pointer to the current node and advances along the threads, so it
+  // is O(1) space and amortized O(1) per step, and it never touches the
+  // tree itself: any number of iterators may walk the same const tree
+  // at once.  Dereferencing yields the key; value() yields the value.
+  //
+  // An iterator stays valid until its node is erased or the tree is
+  // cleared / rebuilt (assign_sorted, erase_range, erase_batch).
+  //
+  template<bool Const>
+  class _iterator
+  {
+  private:
+    NODE* cur;
+
+    friend class avlt;
+    friend class _iterator<!Const>;
+
+  public:
+    typedef std::forward_iterator_tag  iterator_category;
+    typedef KeyT                       value_type;
+    typedef std::ptrdiff_t             difference_type;
+    typedef const KeyT*                pointer;
+    typedef const KeyT&                reference;
+
+    typedef typename std::conditional<Const, const ValueT&, ValueT&>::type  value_reference;
+
+    _iterator(NODE* node = nullptr)
+      : cur(node)
+    { }
+
+    //
+    // iterator converts to const_iterator, not the other way around:
+    //
+    template<bool C, typename = typename std::enable_if<Const && !C>::type>
+    _iterator(const _iterator<C>& other)
+      : cur(other.cur)
+    { }
+
+    reference operator*() const  { return cur->Key; }
+    pointer operator->() const   { return &cur->Key; }
+
+    const KeyT& key() const      { return cur->Key; }
+    value_reference value() const { return cur->Value; }
+
+    _iterator& operator++()
+    {
+      cur = _successor(cur);
+      return *this;
+    }
+
+    _iterator operator++(int)
+    {
+      _iterator before = *this;
+      cur = _successor(cur);
+      return before;
+    }
+
+    template<bool C>
+    bool operator==(const _iterator<C>& other) const { return cur == other.cur; }
+
+    template<bool C>
+    bool operator!=(const _iterator<C>& other) const { return cur != other.cur; }
+  };
+
+  //
+  // _leftmost:
+  //
+  // Returns the node with the smallest key in the subtree, or nullptr.
+  //
+  static NODE* _leftmost(NODE* cur)
+  {
+    if (cur != nullptr)
+      while (cur->Left != nullptr)
+        cur = cur->Left;
+
+    return cur;
+  }
+
+public:
+  typedef _iterator<false>  iterator;
+  typedef _iterator<true>   const_iterator;
+
+  //
+  // default constructor:
+  //
+  // Creates an empty tree.
+  //
+  avlt()
+  {
+    Root = nullptr;
+    Size = 0;
+  }
+
+  //
+  // constructor with a comparator:
+  //
+  // Creates an empty tree ordered by comp, for a Compare with state.
+  //
+  explicit avlt(const Compare& comp)
+    : Root(nullptr), Size(0), Comp(comp)
+  { }
+
+  //
+  // constructor from a sorted range:
+  //
+  // Builds the tree from a range of (key, value) pairs sorted by key,
+  // e.g. a vector<pair<KeyT, ValueT>> or a std::map.  See assign_sorted.
+  //
+  template<typename ForwardIt>
+  avlt(ForwardIt first, ForwardIt last)
+  {
+    Root = nullptr;
+    Size = 0;
+
+    assign_sorted(first, last);
+  }
+  
+  //
+  // helper functions to return the Left and Right pointers; in
+  // particular the ptr returned for the Right is controlled by 
+  // the "isThreaded" field:  if "isThreaded" is true then nullptr
+  // pointer is returned, otherwise the actual underyling ptr
+  // is returned.
+  //
+  NODE* _getActualLeft(NODE* cur) const
+  {
+    return cur->Left;
+  }
+
+  NODE* _getActualRight(NODE* cur) const
+  {
+    if (cur->isThreaded)  // then actual Right ptr is null:
+      return nullptr;
+    else  // actual Right is contents of Right ptr:
+      return cur->Right;
+  }
+
+  //
+  // _count / _agg / _update / _copyAugment / _refresh:
+  //
+  // Maintain the subtree counts of an order-statistic tree and the
+  // subtree aggregates of an aggregated one; for other trees they
+  // compile away.  _update recomputes a node's fields from its
+  // children, and must follow any change to its links or value.
+  //
+  static int _count(const NODE* cur)
+  {
+    return cur == nullptr ? 0 : cur->Count;
+  }
+
+  static AGG _agg(const NODE* cur)
+  {
+    return cur == nullptr ? Aggregate::identity() : cur->Agg;
+  }
+
+  static void _update(NODE* cur, true_type, false_type)
+  {
+    cur->Count = 1 + _count(cur->Left) + (cur->isThreaded ? 0 : _count(cur->Right));
+  }
+
+  static void _update(NODE* cur, false_type, true_type)
+  {
+    cur->Agg = Aggregate::combine(
+                 Aggregate::combine(_agg(cur->Left), Aggregate::lift(cur->Value)),
+                 _agg(cur->isThreaded ? nullptr : cur->Right));
+  }
+
+  static void _update(NODE* cur, true_type, true_type)
+  {
+    _update(cur, true_type(), false_type());
+    _update(cur, false_type(), true_type());
+  }
+
+  static void _update(NODE*, false_type, false_type) { }
+
+  static void _update(NODE* cur)
+  {
+    _update(cur, COUNTED(), AGGREGATED());
+  }
+
+  static void _copyAugment(NODE* dst, const NODE* src, true_type, false_type)
+  {
+    dst->Count = src->Count;
+  }
+
+  static void _copyAugment(NODE* dst, const NODE* src, false_type, true_type)
+  {
+    dst->Agg = src->Agg;
+  }
+
+  static void _copyAugment(NODE* dst, const NODE* src, true_type, true_type)
+  {
+    dst->Count = src->Count;
+    dst->Agg = src->Agg;
+  }
+
+  static void _copyAugment(NODE*, const NODE*, false_type, false_type) { }
+
+  static void _copyAugment(NODE* dst, const NODE* src)
+  {
+    _copyAugment(dst, src, COUNTED(), AGGREGATED());
+  }
+
+  //
+  // recomputes the nodes of a search path, deepest first:
+  //
+  static void _refresh(NODE** path, int depth)
+  {
+    if (!(COUNTED::value || AGGREGATED::value))
+      return;
+
+    while (depth > 0)
+      _update(path[--depth]);
+  }
+
+  //
+  // _compare:
+  //
+  // Three-way comparison of a and b by the tree's order: < 0, 0 or > 0
+  // as a goes before, with or after b.  One call to Comp.compare() if
+  // Compare has it, otherwise one or two calls to Comp.
+  //
+  template<typename C, typename A, typename B>
+  static auto _compare(const C& comp, const A& a, const B& b, int)
+    -> decltype((int) comp.compare(a, b))
+  {
+    return comp.compare(a, b);
+  }
+
+  template<typename C, typename A, typename B>
+  static int _compare(const C& comp, const A& a, const B& b, long)
+  {
+    return comp(a, b) ? -1 : (comp(b, a) ? 1 : 0);
+  }
+
+  template<typename A, typename B>
+  int _compare(const A& a, const B& b) const
+  {
+    return _compare(Comp, a, b, 0);
+  }
+
+  //
+  // PROBE:
+  //
+  // Counts the nodes visited and the key comparisons made by one descent
+  // from the root, and hands them to the stats policy when it goes out
+  // of scope.  Without stats it is all empty inline calls, and the
+  // counting compiles away.
+  //
+  struct PROBE
+  {
+    const Stats& Counters;
+    unsigned Nodes;
+    unsigned Comparisons;
+
+    explicit PROBE(const Stats& counters)
+      : Counters(counters), Nodes(0), Comparisons(0)
+    { }
+
+    ~PROBE() { Counters.lookup(Comparisons, Nodes); }
+
+    void visit() { Nodes++; Comparisons++; }  // a node, and its comparison
+  };
+
+  //
+  // _newNode:
+  //
+  // Allocates a node from the pool and constructs it as a leaf, with
+  // the key and value forwarded straight into place; the caller links
+  // it into the tree and sets up the thread.
+  //
+  template<typename K, typename... Args>
+  NODE* _newNode(K&& key, Args&&... args)
+  {
+    NODE* slot = Pool.allocate();
+    Counters.add(AVLT_ALLOCATIONS);
+
+    try
+    {
+      return new (slot) NODE(std::forward<K>(key), std::forward<Args>(args)...);
+    }
+    catch (...)  // a throwing constructor must not leak the slot
+    {
+      Pool.release(slot);
+      throw;
+    }
+  }
+
+  //
+  // _freeNode:
+  //
+  // Destroys the node and hands its storage back to the pool.
+  //
+  void _freeNode(NODE* node)
+  {
+    node->~NODE();
+    Pool.release(node);
+  }
+
+  //
+  // _build:
+  //
+  // Links the nodes at(lo) .. at(hi-1), which are in sorted order, into
+  // a perfectly balanced subtree and returns its root.  "after" is the
+  // inorder successor of the whole range (nullptr if none), so every
+  // node without a right subtree gets its thread set on the way down.
+  // Heights are computed on the way back up; no rotations are needed.
+  //
+  // Time complexity:  O(hi - lo)
+  //
+  template<typename NodeAt>
+  NODE* _build(NodeAt at, size_t lo, size_t hi, NODE* after)
+  {
+    if (lo >= hi)
+      return nullptr;
+
+    size_t mid = lo + (hi - lo) / 2;
+    NODE* cur = at(mid);
+
+    cur->Left = _build(at, lo, mid, cur);
+
+    NODE* right = _build(at, mid + 1, hi, after);
+    if (right == nullptr)
+    {
+      cur->Right = after;
+      cur->isThreaded = true;
+    }
+    else
+    {
+      cur->Right = right;
+      cur->isThreaded = false;
+    }
+
+    cur->Height = 1 + max(heightHelper(cur->Left), heightHelper(right));
+    _update(cur);
+
+    return cur;
+  }
+
+  //
+  // _cloneSubtree
+  //
+  // Copies the subtree rooted at "src" without recursion, constructing
+  // the copies in preorder into consecutive slots starting at "slot"
+  // and moving by "step" (+1 or -1).  Threads are rebuilt from "succ",
+  // the copy of src's inorder successor, so they never point back into
+  // the source tree.  "made" counts the nodes constructed so far, so a
+  // caller can clean up if a key or value copy throws.
+  //
+  static NODE* _cloneSubtree(NODE* src, NODE* succ, NODE* slot, ptrdiff_t step, size_t& made)
+  {
+    struct FRAME
+    {
+      NODE* Src;     // node to copy
+      NODE* Parent;  // copy to link it under (nullptr for the top)
+      bool  isLeft;  // which side of Parent it goes
+      NODE* Succ;    // copy of src's inorder successor
+    };
+
+    //
+    // only pending right subtrees wait on the stack, at most one
+    // per level:
+    //
+    FRAME frames[MAX_HEIGHT + 1];
+    int top = 0;
+    NODE* result = nullptr;
+
+    if (src != nullptr)
+      frames[top++] = FRAME{ src, nullptr, false, succ };
+
+    while (top > 0)
+    {
+      FRAME f = frames[--top];
+
+      NODE* copy = new (slot) NODE(f.Src->Key, f.Src->Value);
+      copy->Height = f.Src->Height;
+      _copyAugment(copy, f.Src);
+      slot += step;
+      made++;
+
+      if (f.Parent == nullptr)
+        result = copy;
+      else if (f.isLeft)
+        f.Parent->Left = copy;
+      else
+      {
+        f.Parent->Right = copy;
+        f.Parent->isThreaded = false;
+      }
+
+      if (f.Src->isThreaded)
+        copy->Right = f.Succ;
+      else
+        frames[top++] = FRAME{ f.Src->Right, copy, false, f.Succ };
+
+      if (f.Src->Left != nullptr)  // pushed last so it is copied next
+        frames[top++] = FRAME{ f.Src->Left, copy, true, copy };
+    }//while
+
+    return result;
+  }
+
+  //
+  // _destroySlots
+  //
+  // Runs the destructors of "count" nodes starting at "slot" and moving
+  // by "step"; undoes a partial _cloneSubtree.
+  //
+  static void _destroySlots(NODE* slot, size_t count, ptrdiff_t step)
+  {
+    for (; count > 0; --count, slot += step)
+      slot->~NODE();
+  }
+
+  //
+  // _clone
+  //
+  // Makes "this" (which must be empty) an exact copy of "other", such
+  // that making the copy requires no rotations.  All the nodes come
+  // from one contiguous block: the root first, its left subtree filling
+  // the block forward from the front and its right subtree backward
+  // from the end, so the two halves never need each other's sizes and
+  // large trees copy them on two threads.  If copying a key or value
+  // throws, everything constructed is destroyed and "this" stays empty.
+  //
+  // Time complexity:  O(N)
+  //
+  void _clone(const avlt& other)
+  {
+    static const int PARALLEL_SIZE = 32768;
+
+    if (other.Root == nullptr)
+      return;
+
+    NODE* src = other.Root;
+    int size = other.Size;
+    NODE* block = Pool.allocateBlock(size);
+    NODE* last = block + (size - 1);
+    Counters.add(AVLT_ALLOCATIONS, size);
+
+    size_t leftMade = 0, rightMade = 0;
+    bool rootMade = false;
+
+    try
+    {
+      NODE* root = new (block) NODE(src->Key, src->Value);
+      root->Height = src->Height;
+      _copyAugment(root, src);
+      rootMade = true;
+
+      NODE* srcRight = src->isThreaded ? nullptr : src->Right;
+      NODE* right = nullptr;
+
+      if (size >= PARALLEL_SIZE && thread::hardware_concurrency() > 1)
+      {
+        future<NODE*> rightCopy = async(launch::async, [&]()
+          { return _cloneSubtree(srcRight, nullptr, last, -1, rightMade); });
+
+        exception_ptr failed;
+
+        try
+        {
+          root->Left = _cloneSubtree(src->Left, root, block + 1, +1, leftMade);
+        }
+        catch (...)
+        {
+          failed = current_exception();
+        }
+
+        try  // always wait, the other thread writes into our block
+        {
+          right = rightCopy.get();
+        }
+        catch (...)
+        {
+          failed = current_exception();
+        }
+
+        if (failed)
+          rethrow_exception(failed);
+      }
+      else
+      {
+        root->Left = _cloneSubtree(src->Left, root, block + 1, +1, leftMade);
+        right = _cloneSubtree(srcRight, nullptr, last, -1, rightMade);
+      }
+
+      if (right != nullptr)
+      {
+        root->Right = right;
+        root->isThreaded = false;
+      }
+    }
+    catch (...)
+    {
+      if (rootMade)
+        block->~NODE();
+      _destroySlots(block + 1, leftMade, +1);
+      _destroySlots(last, rightMade, -1);
+
+      Pool.releaseAll();
+      throw;
+    }
+
+    Root = block;
+    Size = size;
+  }
+
+  //
+  // copy constructor
+  //
+  // NOTE: makes an exact copy of the "other" tree, such that making the
+  // copy requires no rotations.
+  //
+  // Time complexity:  O(N)
+  //
+  avlt (const avlt& other)
+    : Root(nullptr), Size(0), Comp(other.Comp)
+  {
+    _clone(other);
+  }
+
+  //
+  // move constructor
+  //
+  // Takes over the nodes of "other", leaving it empty.
+  //
+  // Time complexity:  O(1)
+  //
+  avlt (avlt&& other) noexcept
+    : Root(nullptr), Size(0), Comp(other.Comp)
+  {
+    swap(other);
+  }
+
+  //
+  //destroy:
+  //
+  //Helper function to run the destructors of the nodes; the memory
+  //itself goes back when the pool is released.
+  //
+  void destroy(NODE* cur)
+  {
+      if(cur == NULL) 
+          return;
+      else{
+          destroy(cur->Left);
+          if(cur->isThreaded == false){
+              destroy(cur->Right);
+          }
+          cur->~NODE();
+      }
+  }
+
+  //
+  // destructor:
+  //
+  // Called automatically by system when tree is about to be destroyed;
+  // this is our last chance to free any resources / memory used by
+  // this tree.
+  //
+  virtual ~avlt()
+  {
+    clear();
+  }
+
+  //
+  // operator=
+  //
+  // Replaces "this" tree with a copy of the "other" tree.  The copy is
+  // made before anything is released, so self-assignment is safe and a
+  // throwing copy leaves "this" unchanged.
+  //
+  // NOTE: makes an exact copy of the "other" tree, such that making the
+  // copy requires no rotations.
+  //
+  avlt& operator=(const avlt& other)
+  {
+    if (this != &other)
+    {
+      avlt copy(other);
+      swap(copy);
+    }
+
+    return *this;
+  }
+
+  //
+  // move assignment
+  //
+  // Clears "this" tree and takes over the nodes of "other", leaving it
+  // empty.
+  //
+  avlt& operator=(avlt&& other) noexcept
+  {
+    if (this != &other)
+    {
+      clear();
+      swap(other);
+    }
+
+    return *this;
+  }
+
+  //
+  // swap
+  //
+  // Exchanges the contents of two trees, nodes and pools included.
+  // Iterators stay valid and now refer into the other tree.
+  //
+  // Time complexity:  O(1)
+  //
+  void swap(avlt& other) noexcept
+  {
+    std::swap(Root, other.Root);
+    std::swap(Size, other.Size);
+    std::swap(ptr, other.ptr);
+    Pool.swap(other.Pool);
+    Spine.swap(other.Spine);
+    std::swap(Comp, other.Comp);
+  }
+
+  friend void swap(avlt& a, avlt& b) noexcept
+  {
+    a.swap(b);
+  }
+
+  //
+  // clear:
+  //
+  // Clears the contents of the tree, resetting the tree to empty.
+  //
+  // Time complexity:  O(chunks) when KeyT and ValueT are trivially
+  // destructible, since the whole pool is released at once; otherwise
+  // O(N) to run the destructors.
+  //
+  void clear()
+  {
+    if (!(std::is_trivially_destructible<KeyT>::value &&
+          std::is_trivially_destructible<ValueT>::value))
+      destroy(Root);
+
+    Pool.releaseAll();
+    Size = 0;
+    Root = NULL;
+    ptr = nullptr;
+    Spine.clear();
+  }
+
+  //
+  // node_bytes:
+  //
+  // Returns the # of bytes each entry takes in the pool.
+  //
+  static size_t node_bytes()
+  {
+    return sizeof(NODE);
+  }
+
+  // 
+  // size:
+  //
+  // Returns the # of nodes in the tree, 0 if empty.
+  //
+  // Time complexity:  O(1) 
+  //
+  int size() const
+  {
+    return Size;
+  }
+
+  // 
+  // height:
+  //
+  // Returns the height of the tree, -1 if empty.
+  //
+  // Time complexity:  O(1) 
+  //
+  int height() const
+  {
+    if (Root == nullptr)
+      return -1;
+    else
+      return Root->Height;
+  }
+
+  //
+  // stats / reset_stats:
+  //
+  // A snapshot of what the tree has counted since it was made or last
+  // reset: lookups with their comparisons and path lengths, rotations,
+  // allocations and next() steps.  All zeros unless the tree has the
+  // avlt_stats policy, e.g. avlt<int, int, false, avlt_no_aggregate,
+  // avlt_stats<>>.
+  //
+  // Time complexity:  O(1)
+  //
+  avlt_stats_snapshot stats() const
+  {
+    return Counters.snapshot();
+  }
+
+  void reset_stats()
+  {
+    Counters.reset();
+  }
+
+  // 
+  // search:
+  //
+  // Searches the tree for the given key, returning true if found
+  // and false if not.  If the key is found, the corresponding value
+  // is returned via the reference parameter.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    NODE* cur = Root;
+    PROBE probe(Counters);
+
+      while (cur != nullptr)
+      {
+        probe.visit();
+        int c = _compare(key, cur->Key);
+
+        if (c == 0){ // already in tree
+            value = cur->Value;
+            return true;
+        }  
+          
+        if (c < 0)  // search left:
+        {
+          cur = cur->Left;
+        }
+        else //searches right
+        {
+            if(cur->isThreaded){ //if the right is threaded
+                cur = nullptr; //declare the right as null ptr and stop the transversal
+            }else{ //if right is not threaded
+                cur = cur->Right;
+            }
+        }
+      }//while  
+  
+      // if get here, not found
+      return false;
+  }
+  
+  //
+  // _lowerBound:
+  //
+  // Returns the node containing the smallest key >= the given key,
+  // or nullptr if every key in the tree is smaller.  This is a single
+  // descent from the root.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K>
+  NODE* _lowerBound(const K& key) const
+  {
+    NODE* cur = Root;
+    NODE* candidate = nullptr;
+    PROBE probe(Counters);
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      if (!Comp(cur->Key, key))  // cur qualifies, look for a smaller one:
+      {
+        candidate = cur;
+        cur = cur->Left;
+      }
+      else  // everything at cur and to the left is too small:
+      {
+        cur = _getActualRight(cur);
+      }
+    }//while
+
+    return candidate;
+  }
+
+  //
+  // _upperBound / _floor:
+  //
+  // _upperBound returns the node containing the smallest key > the given
+  // key, or nullptr; _floor returns the node containing the largest key
+  // <= the given key (< it, unless inclusive), or nullptr.  Like
+  // _lowerBound, each is a single descent from the root.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K>
+  NODE* _upperBound(const K& key) const
+  {
+    NODE* cur = Root;
+    NODE* candidate = nullptr;
+    PROBE probe(Counters);
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      if (Comp(key, cur->Key))  // cur qualifies, look for a smaller one:
+      {
+        candidate = cur;
+        cur = cur->Left;
+      }
+      else  // everything at cur and to the left is too small:
+      {
+        cur = _getActualRight(cur);
+      }
+    }//while
+
+    return candidate;
+  }
+
+  template<typename K>
+  NODE* _floor(const K& key, bool inclusive) const
+  {
+    NODE* cur = Root;
+    NODE* candidate = nullptr;
+    PROBE probe(Counters);
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      if (inclusive ? !Comp(key, cur->Key) : Comp(cur->Key, key))  // cur qualifies, look for a larger one:
+      {
+        candidate = cur;
+        cur = _getActualRight(cur);
+      }
+      else  // everything at cur and to the right is too large:
+      {
+        cur = cur->Left;
+      }
+    }//while
+
+    return candidate;
+  }
+
+  //
+  // _findNode:
+  //
+  // Returns the node containing the given key, or nullptr.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K>
+  NODE* _findNode(const K& key) const
+  {
+    NODE* cur = Root;
+    PROBE probe(Counters);
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      int c = _compare(key, cur->Key);
+
+      if (c == 0)
+        return cur;
+
+      if (c < 0)
+        cur = cur->Left;
+      else
+        cur = _getActualRight(cur);
+    }//while
+
+    return nullptr;
+  }
+
+  //
+  // _successor:
+  //
+  // Returns the next inorder node after cur, or nullptr if cur holds
+  // the largest key.  If cur is threaded we simply follow the thread,
+  // otherwise the successor is the leftmost node of the right subtree.
+  //
+  // Time complexity:  O(1) amortized over a full traversal
+  //
+  static NODE* _successor(NODE* cur)
+  {
+    if (cur->isThreaded)
+      return cur->Right;
+
+    cur = cur->Right;
+    while (cur->Left != nullptr)
+      cur = cur->Left;
+
+    return cur;
+  }
+
+  //
+  // search_batch
+  //
+  // Looks up keys[0..n-1], setting found_out[i] to whether keys[i] is in
+  // the tree and, if so, values_out[i] to its value (otherwise
+  // values_out[i] is left alone, as with search).  The outputs can be
+  // anything indexable: pointers, vectors, vector<bool>, ...
+  //
+  // Unsorted batches are looked up GROUP keys at a time, advancing the
+  // descents in lockstep and prefetching each next child, so the cache
+  // misses of different keys overlap instead of happening one after
+  // another.  Sorted batches start each search where the previous one
+  // ended and follow the threads a few steps, which answers runs of
+  // nearby keys without going back to the root.
+  //
+  // Time complexity:  O(n lgN) worst-case, O(n + lgN) for a sorted
+  // batch of adjacent keys
+  //
+  template<typename ValuesOut, typename FoundOut>
+  void search_batch(const KeyT* keys, size_t n, ValuesOut& values_out, FoundOut& found_out) const
+  {
+    if (std::is_sorted(keys, keys + n, Comp))
+      _searchSorted(keys, n, values_out, found_out);
+    else
+      _searchInterleaved(keys, n, values_out, found_out);
+  }
+
+  //
+  // search_batch
+  //
+  // Convenience version for vectors; the outputs are resized to match.
+  //
+  void search_batch(const vector<KeyT>& keys, vector<ValueT>& values_out, vector<bool>& found_out) const
+  {
+    values_out.resize(keys.size());
+    found_out.assign(keys.size(), false);
+
+    search_batch(keys.data(), keys.size(), values_out, found_out);
+  }
+
+  //
+  // _searchInterleaved:
+  //
+  // The lockstep part of search_batch.  Each descent keeps its own node
+  // count, and reports to the stats policy when it ends, as a PROBE
+  // would.
+  //
+  static const size_t GROUP = 16;
+
+  template<typename ValuesOut, typename FoundOut>
+  void _searchInterleaved(const KeyT* keys, size_t n, ValuesOut& values_out, FoundOut& found_out) const
+  {
+    NODE* cur[GROUP];
+    unsigned visited[GROUP];
+
+    for (size_t base = 0; base < n; base += GROUP)
+    {
+      size_t count = (n - base < GROUP) ? n - base : GROUP;
+      size_t active = count;
+
+      for (size_t j = 0; j < count; ++j)
+      {
+        cur[j] = Root;
+        visited[j] = 0;
+        found_out[base + j] = false;
+      }
+
+      if (Root == nullptr)
+      {
+        for (size_t j = 0; j < count; ++j)
+          Counters.lookup(0, 0);
+        continue;
+      }
+
+      while (active > 0)
+      {
+        for (size_t j = 0; j < count; ++j)
+        {
+          NODE* node = cur[j];
+          if (node == nullptr)
+            continue;
+
+          const KeyT& key = keys[base + j];
+
+          visited[j]++;  // a node, and its comparison
+          int c = _compare(key, node->Key);
+
+          if (c == 0)
+          {
+            values_out[base + j] = node->Value;
+            found_out[base + j] = true;
+            node = nullptr;
+          }
+          else if (c < 0)
+            node = node->Left;
+          else
+            node = _getActualRight(node);
+
+          if (node != nullptr)
+            AVLT_PREFETCH(node);
+          else
+          {
+            Counters.lookup(visited[j], visited[j]);
+            active--;
+          }
+
+          cur[j] = node;
+        }
+      }//while
+    }
+  }
+
+  //
+  // _searchSorted:
+  //
+  // The sorted part of search_batch: "finger" is the first node >= the
+  // previous key, so the next key's lower bound is usually a few thread
+  // hops away; if it isn't within HOPS steps we descend from the root.
+  // The walk along the threads counts as a lookup of its own, and the
+  // descent it may fall back to as another.
+  //
+  static const int HOPS = 8;
+
+  template<typename ValuesOut, typename FoundOut>
+  void _searchSorted(const KeyT* keys, size_t n, ValuesOut& values_out, FoundOut& found_out) const
+  {
+    NODE* finger = nullptr;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      const KeyT& key = keys[i];
+      int hops = 0;
+
+      if (i == 0)
+        finger = _lowerBound(key);
+      else
+      {
+        bool tooFar;
+        {
+          PROBE probe(Counters);
+
+          while (finger != nullptr && hops < HOPS)
+          {
+            probe.visit();
+            if (!Comp(finger->Key, key))
+              break;
+
+            if (finger->isThreaded)
+              Counters.add(AVLT_THREAD_HOPS);
+            finger = _successor(finger);
+            hops++;
+          }
+
+          tooFar = (finger != nullptr && Comp(finger->Key, key));
+        }
+
+        if (tooFar)  // start over
+          finger = _lowerBound(key);
+      }
+
+      if (finger != nullptr && !Comp(key, finger->Key))  // finger >= key, so ==
+      {
+        values_out[i] = finger->Value;
+        found_out[i] = true;
+      }
+      else
+        found_out[i] = false;
+    }
+  }
+
+  //
+  // range_search
+  //
+  // Searches the tree for all keys in the range [lower..upper], inclusive.
+  // It is assumed that lower <= upper.  The keys are returned in a vector;
+  // if no keys are found, then the returned vector is empty.
+  //
+  // Time complexity: O(lgN + M), where M is the # of keys in the range
+  // [lower..upper], inclusive.
+  //
+  vector<KeyT> range_search(KeyT lower, KeyT upper) const
+  {
+    vector<KeyT>  keys;
+
+    range_search(lower, upper, back_inserter(keys));
+
+    return keys; //return the vector
+  }
+
+  //
+  // range_search
+  //
+  // Same as above, but streams the keys in [lower..upper] to the given
+  // output iterator instead of building a vector.  Returns the output
+  // iterator positioned after the last key written.
+  //
+  // Time complexity: O(lgN + M)
+  //
+  template<typename OutputIt>
+  OutputIt range_search(const KeyT& lower, const KeyT& upper, OutputIt out) const
+  {
+    range_for_each(lower, upper,
+      [&out](const KeyT& key, const ValueT&) { *out++ = key; });
+
+    return out;
+  }
+
+  //
+  // range_for_each
+  //
+  // Calls visit(key, value) for every key in [lower..upper], in order.
+  // One descent finds the first key >= lower, and from there we follow
+  // the threads until we pass upper.
+  //
+  // Time complexity: O(lgN + M)
+  //
+  template<typename Visitor>
+  void range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    NODE* cur = _lowerBound(lower);
+
+    while (cur != nullptr && !Comp(upper, cur->Key))
+    {
+      visit(cur->Key, cur->Value);
+      cur = _successor(cur);
+    }
+  }
+  
+  //
+  // Helper functions to get the heights 
+  // of various nodes that are used in
+  // the insert function, etc.
+  // 
+  int heightHelper(NODE* A){
+      if(A == nullptr)
+          return -1;
+      else
+         return A->Height;
+  }
+  
+  int heightRight(NODE* A){
+      if(A->isThreaded == true)
+          return -1;
+      else
+          return A->Right->Height;
+  }
+
+  //
+  // _RightRotate
+  //
+  // Rotates the tree around the node N, where Parent is N's parent.  Note that
+  // Parent could be null, which means N is the root of the entire tree.  If 
+  // Parent denotes a node, note that N could be to the left of Parent, or to
+  // the right.  You'll need to take all this into account when linking in the
+  // new root after the rotation. Update the heights and the threads as well.
+  //
+   void rightRotate(NODE* Parent, NODE* N)
+  {
+     // 1) Lable the components
+     // 2) rotate
+     // 3) update parent to link to L
+     // 4) update N's height
+     // 5) update L's height
+     
+     NODE* L = N->Left; // Step 1
+     NODE* B = L->Right;
+     
+     if(L->isThreaded){
+         B = nullptr;
+     }
+     
+     N->Left = B; //Step 2
+     L->Right = N;
+     L->isThreaded = false;
+     
+     if(Parent == nullptr){ //Step 3
+        Root = L;
+     }
+     else if (Parent->Left == N){
+        Parent->Left = L;
+     }
+     else{
+        Parent->Right = L;
+     }
+     
+     N->Height = 1 + max(heightHelper(N->Left), heightRight(N)); //Step 4
+     L->Height = 1 + max(heightHelper(L->Left), heightRight(L)); //Step 5
+     _update(N);
+     _update(L);
+     Counters.add(AVLT_RIGHT_ROTATIONS);
+  }
+  
+  //
+  // _LeftRotate
+  //
+  // Rotates the tree around the node N, where Parent is N's parent.  Note that
+  // Parent could be null, which means N is the root of the entire tree.  If 
+  // Parent denotes a node, note that N could be to the left of Parent, or to
+  // the right.  You'll need to take all this into account when linking in the
+  // new root after the rotation. Update the heights and the threads as well.
+  //
+  void leftRotate(NODE* Parent, NODE* N)
+  {
+     // 1) Lable the components
+     // 2) rotate
+     // 3) update parent to link to L
+     // 4) update N's height
+     // 5) update R's height
+     
+     NODE* R = N->Right; //Step 1
+     NODE* B = R->Left;
+
+     R->Left = N; //Step 2
+     N->Right = B;
+     if(B == nullptr){
+         N->Right = R;
+         N->isThreaded = true;
+     }
+
+     if(Parent == nullptr){ //Step 3
+        Root = R;
+     }
+     else if (Parent->Right  == N){
+        Parent->Right = R;
+     }
+     else{
+        Parent->Left = R;
+     }
+    
+     N->Height = 1 + max(heightHelper(N->Left), heightRight(N));
+     R->Height = 1 + max(N->Height, heightRight(R));
+     _update(N);
+     _update(R);
+     Counters.add(AVLT_LEFT_ROTATIONS);
+  }
+
+  //
+  // _findOrPath:
+  //
+  // Searches for key; if found, its node is returned.  Otherwise nullptr
+  // is returned and path[0..depth) holds the nodes visited, the last of
+  // which is where a new node for key would be linked in.
+  //
+  NODE* _findOrPath(const KeyT& key, NODE** path, int& depth) const
+  {
+    NODE* cur = Root;
+    PROBE probe(Counters);
+    depth = 0;
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      int c = _compare(key, cur->Key);
+
+      if (c == 0)  // the key is in current/root
+        return cur;
+
+      path[depth++] = cur;  // remember so we can return later:
+
+      if (c < 0)  // search left:
+        cur = cur->Left;
+      else
+        cur = _getActualRight(cur);
+    }//while
+
+    return nullptr;
+  }
+
+  //
+  // _linkNew:
+  //
+  // Links newNode in below path[depth-1] (the node where the search fell
+  // out of the tree, or the empty tree when depth is 0), then walks back
+  // up the path fixing heights and rotating as needed.  Returns the index
+  // in path where the walk stopped: path[0..stop] kept their heights and
+  // subtrees, apart from one child link of path[stop].  -1 if the walk
+  // went all the way up.
+  //
+  int _linkNew(NODE* newNode, NODE** path, int depth)
+  {
+    NODE* prev = depth > 0 ? path[depth - 1] : nullptr;
+
+    //
+    // 1. link in the new node:
+    //
+    // NOTE: if prev is null, then the tree is empty and the
+    // Root pointer needs to be updated.
+    //
+    if (prev == nullptr)
+    {
+      Root = newNode;
+    }
+    else if (Comp(newNode->Key, prev->Key))  // a left leaf is threaded to its parent
+    {
+      prev->Left = newNode;
+      newNode->Right = prev;
+    }
+    else  // a right leaf takes over its parent's thread
+    {
+      newNode->Right = prev->Right;
+      prev->isThreaded = false;
+      prev->Right = newNode;
+    }
+
+    Size++;
+
+    _update(newNode);
+    _refresh(path, depth);  // every node on the path gained one
+
+    //
+    // 2. walk back up the path, adjusting heights; at most one
+    // (single or double) rotation is needed after an insert:
+    //
+    while (depth > 0)
+    {
+      NODE* cur = path[--depth];
+
+      int HL = heightHelper(cur->Left);
+      int HR = heightRight(cur);
+      int HC = 1 + std::max(HL, HR);
+      int BF = HL - HR;
+
+      // if height is same, nothing above us changes
+      if (HC == cur->Height)
+        return depth;
+
+      cur->Height = HC;
+
+      NODE* parent = depth > 0 ? path[depth - 1] : nullptr;
+
+      if (abs(BF) > 1)
+      {
+        if (HR > HL)
+        {
+          // right right case
+          if (heightRight(cur->Right) > heightHelper(cur->Right->Left))
+          {
+            leftRotate(parent, cur);
+            Counters.add(AVLT_SINGLE_ROTATIONS);
+          }
+          else  // right left case
+          {
+            rightRotate(cur, cur->Right);
+            leftRotate(parent, cur);
+            Counters.add(AVLT_DOUBLE_ROTATIONS);
+          }
+        }
+        else
+        {
+          // left left case
+          if (heightHelper(cur->Left->Left) > heightRight(cur->Left))
+          {
+            rightRotate(parent, cur);
+            Counters.add(AVLT_SINGLE_ROTATIONS);
+          }
+          else  // left right case
+          {
+            leftRotate(cur, cur->Left);
+            rightRotate(parent, cur);
+            Counters.add(AVLT_DOUBLE_ROTATIONS);
+          }
+        }
+      }
+    }//while
+
+    return -1;
+  }
+
+  //
+  // _spineValid / _respine:
+  //
+  // The cached right spine is known when it is non-empty, or trivially
+  // when the tree is.  _respine keeps its first "keep" nodes and walks
+  // down the Right links from there for the rest.
+  //
+  bool _spineValid() const
+  {
+    return !Spine.empty() || Root == nullptr;
+  }
+
+  void _respine(int keep)
+  {
+    Spine.resize(keep);
+
+    NODE* cur = Spine.empty() ? Root : _getActualRight(Spine.back());
+
+    while (cur != nullptr)
+    {
+      Spine.push_back(cur);
+      cur = _getActualRight(cur);
+    }
+  }
+
+  //
+  // _locate:
+  //
+  // Searches for key as _findOrPath does, but a key larger than every
+  // key in the tree needs no search at all: "path" is pointed at the
+  // cached right spine instead.  With fromRight, any other key is
+  // searched for from the bottom of the spine upward, and then down
+  // from there; for keys near the largest that is far shorter than a
+  // search from the Root.
+  //
+  NODE* _locate(const KeyT& key, NODE**& path, int& depth, bool fromRight)
+  {
+    if (fromRight && Spine.empty() && Root != nullptr)
+      _respine(0);
+
+    if (Spine.empty())
+      return _findOrPath(key, path, depth);
+
+    int j = (int) Spine.size() - 1;
+
+    if (Comp(Spine[j]->Key, key))  // a new largest key goes below the spine
+    {
+      Counters.lookup(1, 1);
+      path = Spine.data();
+      depth = (int) Spine.size();
+      return nullptr;
+    }
+
+    if (!fromRight)
+      return _findOrPath(key, path, depth);
+
+    //
+    // climb to the lowest spine node < key; the search from the Root
+    // would have turned left at the spine node just below it:
+    //
+    PROBE probe(Counters);
+
+    while (j >= 0)
+    {
+      probe.visit();
+      int c = _compare(key, Spine[j]->Key);
+
+      if (c > 0)
+        break;
+      if (c == 0)
+        return Spine[j];
+      j--;
+    }
+
+    depth = 0;
+    for (int i = 0; i <= j + 1; ++i)
+      path[depth++] = Spine[i];
+
+    NODE* cur = Spine[j + 1]->Left;
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      int c = _compare(key, cur->Key);
+
+      if (c == 0)
+        return cur;
+
+      path[depth++] = cur;
+
+      if (c < 0)
+        cur = cur->Left;
+      else
+        cur = _getActualRight(cur);
+    }//while
+
+    return nullptr;
+  }
+
+  //
+  // _insertAt:
+  //
+  // Links newNode in at the end of a path found by _locate and keeps the
+  // cached right spine up to date.  A new largest key starts the spine
+  // cache if it is not known; only the part of the spine below where the
+  // rebalancing stopped is walked again, which for a run of appends is
+  // O(1) amortized.
+  //
+  void _insertAt(NODE* newNode, NODE** path, int depth)
+  {
+    NODE* prev = depth > 0 ? path[depth - 1] : nullptr;
+
+    bool newMax = prev == nullptr ||
+                  (prev->isThreaded && prev->Right == nullptr && Comp(prev->Key, newNode->Key));
+
+    bool track = _spineValid();
+    bool appended = path == Spine.data();
+
+    if (!track && newMax)  // the path to a new largest key is the spine
+    {
+      Spine.assign(path, path + depth);
+      track = appended = true;
+    }
+
+    int stop = _linkNew(newNode, path, depth);
+
+    if (!track)
+      return;
+
+    //
+    // the spine changes if the new node joins it, or if the rebalancing
+    // reached the spine: the path follows the spine from the Root for a
+    // while, so that is when path[stop + 1] was a spine node:
+    //
+    if (appended || newMax ||
+        (stop + 1 < (int) Spine.size() && stop + 1 < depth && path[stop + 1] == Spine[stop + 1]))
+      _respine(stop + 1);
+  }
+
+  //
+  // insert
+  //
+  // Inserts the given key into the tree; if the key has already been insert then
+  // the function returns without changing the tree.  Rotations are performed
+  // as necessary to keep the tree balanced according to AVL definition.  The
+  // rvalue overload moves the key and value into the new node.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    try_emplace(key, value);
+  }
+
+  void insert(KeyT&& key, ValueT&& value)
+  {
+    try_emplace(std::move(key), std::move(value));
+  }
+
+  //
+  // try_emplace
+  //
+  // If key is not in the tree, inserts it with a value constructed in
+  // place from args; otherwise nothing is constructed, moved from or
+  // changed.  Returns an iterator to the key's node and true if the key
+  // was inserted.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename... Args>
+  pair<iterator, bool> try_emplace(const KeyT& key, Args&&... args)
+  {
+    NODE* buffer[MAX_HEIGHT];
+    NODE** path = buffer;
+    int depth;
+
+    NODE* cur = _locate(key, path, depth, false);
+    if (cur != nullptr)
+      return make_pair(iterator(cur), false);
+
+    cur = _newNode(key, std::forward<Args>(args)...);
+    _insertAt(cur, path, depth);
+
+    return make_pair(iterator(cur), true);
+  }
+
+  template<typename... Args>
+  pair<iterator, bool> try_emplace(KeyT&& key, Args&&... args)
+  {
+    NODE* buffer[MAX_HEIGHT];
+    NODE** path = buffer;
+    int depth;
+
+    NODE* cur = _locate(key, path, depth, false);
+    if (cur != nullptr)
+      return make_pair(iterator(cur), false);
+
+    cur = _newNode(std::move(key), std::forward<Args>(args)...);
+    _insertAt(cur, path, depth);
+
+    return make_pair(iterator(cur), true);
+  }
+
+  //
+  // emplace
+  //
+  // Constructs a node in place from a key (or arguments a key converts
+  // from) and the value's constructor arguments, then inserts it if the
+  // key is new.  Since the key is only known once built, a duplicate's
+  // node is constructed and destroyed again; prefer try_emplace when a
+  // KeyT is already at hand.  Returns as try_emplace.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, typename... Args>
+  pair<iterator, bool> emplace(K&& key, Args&&... args)
+  {
+    NODE* node = _newNode(std::forward<K>(key), std::forward<Args>(args)...);
+
+    NODE* buffer[MAX_HEIGHT];
+    NODE** path = buffer;
+    int depth;
+
+    NODE* cur = _locate(node->Key, path, depth, false);
+    if (cur != nullptr)
+    {
+      _freeNode(node);
+      return make_pair(iterator(cur), false);
+    }
+
+    _insertAt(node, path, depth);
+
+    return make_pair(iterator(node), true);
+  }
+
+  //
+  // _valueChanged:
+  //
+  // Recomputes the aggregates on the path down to key's node after its
+  // value was assigned; a no-op for trees without an aggregate.
+  //
+  void _valueChanged(const KeyT& key)
+  {
+    if (!AGGREGATED::value)
+      return;
+
+    NODE* path[MAX_HEIGHT];
+    int depth;
+
+    NODE* cur = _findOrPath(key, path, depth);
+
+    _update(cur);
+    _refresh(path, depth);
+  }
+
+  //
+  // insert_or_assign
+  //
+  // Like insert, but if key is already in the tree its value is
+  // overwritten with (forwarded) value.  Returns an iterator to the key's
+  // node and true if the key was inserted, false if assigned.
+  //
+  // With an Aggregate policy, this is the way to change a value: the
+  // cached aggregates are refreshed, which writing through at() or an
+  // iterator would bypass.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename M>
+  pair<iterator, bool> insert_or_assign(const KeyT& key, M&& value)
+  {
+    pair<iterator, bool> result = try_emplace(key, std::forward<M>(value));
+
+    if (!result.second)
+    {
+      result.first.value() = std::forward<M>(value);
+      _valueChanged(result.first.key());
+    }
+
+    return result;
+  }
+
+  template<typename M>
+  pair<iterator, bool> insert_or_assign(KeyT&& key, M&& value)
+  {
+    pair<iterator, bool> result = try_emplace(std::move(key), std::forward<M>(value));
+
+    if (!result.second)
+    {
+      result.first.value() = std::forward<M>(value);
+      _valueChanged(result.first.key());
+    }
+
+    return result;
+  }
+
+  //
+  // insert_hint
+  //
+  // Inserts the key, if it is not already in the tree, starting the
+  // search from "hint".  Returns an iterator to the key's node.
+  //
+  // Nodes have no parent links, so the hint that helps is end(): the
+  // search then climbs the cached right spine from the largest key and
+  // descends from the first spine node below the key, which is what
+  // keys arriving nearly in order (timestamps, sequence numbers) need.
+  // Any other hint searches from the Root, as insert does.  Keys larger
+  // than every key in the tree are appended without a search either way.
+  //
+  // Time complexity:  O(1) amortized plus rebalancing for appends,
+  // O(lg d) for a key with d larger keys after an end() hint,
+  // O(lgN) worst-case
+  //
+  iterator insert_hint(const_iterator hint, const KeyT& key, const ValueT& value)
+  {
+    NODE* buffer[MAX_HEIGHT];
+    NODE** path = buffer;
+    int depth;
+
+    NODE* cur = _locate(key, path, depth, hint == cend());
+    if (cur != nullptr)
+      return iterator(cur);
+
+    cur = _newNode(key, value);
+    _insertAt(cur, path, depth);
+
+    return iterator(cur);
+  }
+
+  //
+  // _replaceChild:
+  //
+  // Makes "child" take the place of "old" under "parent" (or as the Root
+  // when parent is null).  If old was a real right child and child is
+  // null, parent's Right turns back into a thread to "succ".
+  //
+  void _replaceChild(NODE* parent, NODE* old, NODE* child, NODE* succ)
+  {
+    if (parent == nullptr)
+      Root = child;
+    else if (parent->Left == old)
+      parent->Left = child;
+    else if (child != nullptr)
+      parent->Right = child;
+    else
+    {
+      parent->Right = succ;
+      parent->isThreaded = true;
+    }
+  }
+
+  //
+  // _rebalanceAfterErase:
+  //
+  // Walks back up the search path after a node was unlinked, fixing
+  // heights and rotating wherever a node is out of balance.  Unlike
+  // insert, one rotation may not be enough, so we keep going until a
+  // balanced node's height is unchanged.
+  //
+  void _rebalanceAfterErase(NODE** path, int depth)
+  {
+    while (depth > 0)
+    {
+      NODE* cur = path[--depth];
+
+      int HL = heightHelper(cur->Left);
+      int HR = heightRight(cur);
+      int HC = 1 + std::max(HL, HR);
+      int BF = HL - HR;
+
+      NODE* parent = depth > 0 ? path[depth - 1] : nullptr;
+
+      if (abs(BF) <= 1)
+      {
+        if (HC == cur->Height)  // nothing above us changes
+          break;
+
+        cur->Height = HC;
+        continue;
+      }
+
+      cur->Height = HC;
+
+      if (HR > HL)
+      {
+        NODE* R = cur->Right;
+
+        if (heightRight(R) >= heightHelper(R->Left))  // right right case
+        {
+          leftRotate(parent, cur);
+        }
+        else  // right left case
+        {
+          rightRotate(cur, R);
+          leftRotate(parent, cur);
+        }
+      }
+      else
+      {
+        NODE* L = cur->Left;
+
+        if (heightHelper(L->Left) >= heightRight(L))  // left left case
+        {
+          rightRotate(parent, cur);
+        }
+        else  // left right case
+        {
+          leftRotate(cur, L);
+          rightRotate(parent, cur);
+        }
+      }
+    }//while
+  }
+
+  //
+  // erase
+  //
+  // Removes the given key from the tree, returning true if it was there
+  // and false if not.  The nodes on the search path are rebalanced with
+  // leftRotate / rightRotate, and the thread that pointed at the removed
+  // node (from its inorder predecessor) is redirected.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool erase(const KeyT& key)
+  {
+    NODE* cur = Root;
+    NODE* path[MAX_HEIGHT];
+    int depth = 0;
+
+    //
+    // 1. find the node, stacking its ancestors:
+    //
+    PROBE probe(Counters);
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      int c = _compare(key, cur->Key);
+
+      if (c == 0)
+        break;
+
+      path[depth++] = cur;
+
+      if (c < 0)
+        cur = cur->Left;
+      else
+        cur = _getActualRight(cur);
+    }//while
+
+    if (cur == nullptr)  // not found
+      return false;
+
+    NODE* z = cur;
+    NODE* parent = depth > 0 ? path[depth - 1] : nullptr;
+    NODE* succ = _successor(z);
+
+    //
+    // 2. the inorder predecessor (if it is below us) is threaded to z:
+    //
+    NODE* pred = nullptr;
+    if (z->Left != nullptr)
+    {
+      pred = z->Left;
+      while (!pred->isThreaded)
+        pred = pred->Right;
+    }
+
+    //
+    // 3. unlink z:
+    //
+    if (z->isThreaded)  // no right subtree, the left one moves up
+    {
+      if (pred != nullptr)
+        pred->Right = succ;
+
+      _replaceChild(parent, z, z->Left, succ);
+    }
+    else if (z->Left == nullptr)  // only a right subtree, it moves up
+    {
+      _replaceChild(parent, z, z->Right, succ);
+    }
+    else  // two children: relink the successor into z's place
+    {
+      //
+      // succ takes z's place on the path, followed by the path
+      // from z->Right down to succ's parent:
+      //
+      path[depth++] = succ;
+
+      NODE* sParent = z;
+      NODE* walk = z->Right;
+
+      while (walk != succ)
+      {
+        path[depth++] = walk;
+        sParent = walk;
+        walk = walk->Left;
+      }
+
+      if (sParent != z)  // succ leaves its spot, its right subtree moves up
+      {
+        sParent->Left = succ->isThreaded ? nullptr : succ->Right;
+        succ->Right = z->Right;
+        succ->isThreaded = false;
+      }
+
+      succ->Left = z->Left;
+      succ->Height = z->Height;
+      pred->Right = succ;
+
+      _replaceChild(parent, z, succ, nullptr);
+    }
+
+    if (ptr == z)  // keep an ongoing begin()/next() traversal valid
+      ptr = succ;
+
+    Spine.clear();  // rotations may move the spine; found again on demand
+
+    _freeNode(z);
+    Size--;
+    _refresh(path, depth);  // every node on the path lost one
+
+    //
+    // 4. walk back up, fixing heights and rotating:
+    //
+    _rebalanceAfterErase(path, depth);
+
+    return true;
+  }
+
+  //
+  // _rebuildIsCheaper:
+  //
+  // Rebuilding the tree costs O(N), erasing k keys one by one costs
+  // O(k lgN); returns true when the rebuild is the cheaper of the two.
+  //
+  bool _rebuildIsCheaper(size_t k) const
+  {
+    size_t lgN = 1;
+    while (((size_t) 1 << lgN) <= (size_t) Size)
+      lgN++;
+
+    return k * lgN >= (size_t) Size;
+  }
+
+  //
+  // _rebuildWithout:
+  //
+  // Walks the whole tree in order, frees every node for which
+  // drop(node) returns true, and relinks the survivors into a
+  // perfectly balanced tree.  Returns the # of nodes removed.
+  //
+  // Time complexity:  O(N)
+  //
+  template<typename Predicate>
+  int _rebuildWithout(Predicate drop)
+  {
+    vector<NODE*> keep;
+    keep.reserve(Size);
+
+    NODE* cur = Root;
+    if (cur != nullptr)
+      while (cur->Left != nullptr)
+        cur = cur->Left;
+
+    bool cursorLost = false;
+
+    while (cur != nullptr)
+    {
+      NODE* next = _successor(cur);
+
+      if (drop(cur))
+      {
+        if (cur == ptr)
+          cursorLost = true;
+        _freeNode(cur);
+      }
+      else
+      {
+        if (cursorLost)  // the begin()/next() cursor moves on to here
+        {
+          ptr = cur;
+          cursorLost = false;
+        }
+        keep.push_back(cur);
+      }
+
+      cur = next;
+    }//while
+
+    if (cursorLost)
+      ptr = nullptr;
+
+    int removed = Size - (int) keep.size();
+
+    Spine.clear();
+
+    Root = _build([&keep](size_t i) { return keep[i]; }, 0, keep.size(), nullptr);
+    Size = (int) keep.size();
+
+    return removed;
+  }
+
+  //
+  // erase_range
+  //
+  // Removes every key in [lower..upper], inclusive, and returns how
+  // many were removed.  The tree is split at lower and at upper, the
+  // middle piece is freed, and the two outer pieces are joined back
+  // together, so no key is searched for more than once.
+  //
+  // Time complexity:  O(lgN + k) for k keys in the range
+  //
+  int erase_range(const KeyT& lower, const KeyT& upper)
+  {
+    if (Root == nullptr || Comp(upper, lower))
+      return 0;
+
+    SUBTREE less, rest, between, more;
+    NODE* first;  // the node with key lower, if any
+    NODE* last;   // the node with key upper, if any
+
+    _split(Root, nullptr, lower, less, first, rest);
+    _split(rest.Root, rest.Max, upper, between, last, more);
+
+    if (ptr != nullptr && !Comp(ptr->Key, lower) && !Comp(upper, ptr->Key))
+      ptr = _leftmost(more.Root);  // the begin()/next() cursor moves past the range
+
+    DROPPED dropped;
+    dropped.addSubtree(between.Root);
+    if (first != nullptr)
+      dropped.add(first);
+    if (last != nullptr)
+      dropped.add(last);
+
+    NODE* joint;
+    Root = _joinLast(less.Root, more.Root, joint);
+    _endThread(more.Root != nullptr ? more.Max : joint);
+
+    Size -= dropped.Count;
+    Spine.clear();
+
+    _freeDropped(dropped);
+
+    return dropped.Count;
+  }
+
+  //
+  // erase_batch
+  //
+  // Removes every key in "keys", which must be sorted, and returns how
+  // many were actually in the tree.  Large batches are merged against
+  // an inorder walk of the tree and the survivors relinked in one pass;
+  // small ones are carried down the tree together, split at each node
+  // into the keys for its left and right subtrees, and the nodes found
+  // are cut out by joining around them on the way back up.
+  //
+  // Time complexity:  O(min(k lg(N/k + 1), N + k)) for k keys
+  //
+  int erase_batch(const vector<KeyT>& keys)
+  {
+    if (keys.empty() || Root == nullptr)
+      return 0;
+
+    if (_rebuildIsCheaper(keys.size()))
+    {
+      size_t i = 0;
+
+      return _rebuildWithout([&](NODE* cur)
+      {
+        while (i < keys.size() && Comp(keys[i], cur->Key))  // skip keys not in tree
+          i++;
+
+        return i < keys.size() && !Comp(cur->Key, keys[i]);
+      });
+    }
+
+    if (ptr != nullptr)  // move the begin()/next() cursor past keys that go
+    {
+      size_t i = std::lower_bound(keys.begin(), keys.end(), ptr->Key, Comp) - keys.begin();
+
+      while (ptr != nullptr && i < keys.size() && !Comp(ptr->Key, keys[i]))
+      {
+        ptr = _successor(ptr);
+        while (ptr != nullptr && i < keys.size() && Comp(keys[i], ptr->Key))
+          i++;
+      }
+    }
+
+    DROPPED dropped;
+
+    SUBTREE result = _eraseSorted(SUBTREE{ Root, nullptr },
+                                  keys.data(), keys.data() + keys.size(), dropped);
+    _endThread(result.Max);
+
+    Root = result.Root;
+    Size -= dropped.Count;
+    Spine.clear();
+
+    _freeDropped(dropped);
+
+    return dropped.Count;
+  }
+
+  //
+  // assign_sorted
+  //
+  // Replaces the contents of the tree with the (key, value) pairs in
+  // [first, last), which must be sorted by key; pairs are accessed as
+  // it->first and it->second.  If a key repeats, the first one wins, as
+  // with insert.  The tree is built perfectly balanced in one pass, with
+  // all nodes drawn from a single contiguous block of the pool.
+  //
+  // If the input turns out not to be sorted, the sorted prefix is built
+  // as above and the rest is inserted one key at a time.  If copying a
+  // key or value throws, the tree is left empty.
+  //
+  // Time complexity:  O(N) for sorted input
+  //
+  template<typename ForwardIt>
+  void assign_sorted(ForwardIt first, ForwardIt last)
+  {
+    clear();
+
+    size_t count = (size_t) std::distance(first, last);
+    if (count == 0)
+      return;
+
+    NODE* block = Pool.allocateBlock(count);
+    size_t used = 0;
+    Counters.add(AVLT_ALLOCATIONS, count);
+
+    try
+    {
+      for (; first != last; ++first)
+      {
+        if (used > 0)
+        {
+          const KeyT& prev = block[used - 1].Key;
+
+          if (Comp(first->first, prev))  // not sorted after all
+            break;
+          if (!Comp(prev, first->first))  // duplicate, keep the first one
+            continue;
+        }
+
+        new (&block[used]) NODE(first->first, first->second);
+        used++;
+      }
+    }
+    catch (...)  // a copy threw; the tree stays empty
+    {
+      _destroySlots(block, used, +1);
+      for (size_t i = 0; i < count; ++i)
+        Pool.release(&block[i]);
+      throw;
+    }
+
+    for (size_t i = used; i < count; ++i)  // return what we didn't need
+      Pool.release(&block[i]);
+
+    Root = _build([block](size_t i) { return &block[i]; }, 0, used, nullptr);
+    Size = (int) used;
+
+    for (; first != last; ++first)
+      insert(first->first, first->second);
+  }
+
+  //
+  // SUBTREE:
+  //
+  // A piece of a tree being split apart or joined together: its root,
+  // and its largest node.  The pieces keep every right thread correct
+  // except the one out of their largest node, which is set once the
+  // piece's successor is known (see _join).  A null Max means "the same
+  // largest node as the first tree's piece this came from, thread
+  // untouched" -- that node's identity is never needed, and finding it
+  // would cost a walk down the right spine.
+  //
+  struct SUBTREE
+  {
+    NODE* Root;
+    NODE* Max;
+  };
+
+  static int _h(NODE* cur)
+  {
+    return cur == nullptr ? -1 : cur->Height;
+  }
+
+  static NODE* _rightChild(NODE* cur)
+  {
+    return cur->isThreaded ? nullptr : cur->Right;
+  }
+
+  static NODE* _max(NODE* cur)
+  {
+    while (cur != nullptr && !cur->isThreaded)
+      cur = cur->Right;
+    return cur;
+  }
+
+  // the largest node of a whole tree threads to nothing
+  static void _endThread(NODE* max)
+  {
+    if (max != nullptr)
+    {
+      max->Right = nullptr;
+      max->isThreaded = true;
+    }
+  }
+
+  //
+  // _attach:
+  //
+  // Makes "l" and "r" the children of "k" and recomputes k.  With no
+  // right subtree, k keeps whatever thread it had; the caller sets it.
+  //
+  static NODE* _attach(NODE* l, NODE* k, NODE* r)
+  {
+    k->Left = l;
+    if (r != nullptr)
+    {
+      k->Right = r;
+      k->isThreaded = false;
+    }
+    else
+      k->isThreaded = true;
+
+    k->Height = 1 + max(_h(l), _h(r));
+    _update(k);
+    return k;
+  }
+
+  //
+  // _rotateLeft / _rotateRight:
+  //
+  // Rotations of a detached subtree, returning its new root.  They keep
+  // the threads: a node losing its right subtree threads to the node
+  // that took its place.
+  //
+  static NODE* _rotateLeft(NODE* x)
+  {
+    NODE* y = x->Right;
+    NODE* b = y->Left;
+
+    _attach(x->Left, x, b);
+    if (b == nullptr)
+      x->Right = y;
+
+    return _attach(x, y, _rightChild(y));
+  }
+
+  static NODE* _rotateRight(NODE* y)
+  {
+    NODE* x = y->Left;
+
+    _attach(_rightChild(x), y, _rightChild(y));
+    return _attach(x->Left, x, y);
+  }
+
+  //
+  // _join:
+  //
+  // Returns the AVL tree of l, then k, then r, where every key of l is
+  // < k and every key of r is > k.  The largest node of l must already
+  // thread to k.  k is hung off the right spine of l or the left spine
+  // of r where the heights meet, and the rotations on the way back up
+  // rebalance the spine.
+  //
+  // Time complexity:  O(|height(l) - height(r)| + 1)
+  //
+  static NODE* _join(NODE* l, NODE* k, NODE* r)
+  {
+    if (_h(l) > _h(r) + 1)
+      return _joinRight(l, k, r);
+    if (_h(r) > _h(l) + 1)
+      return _joinLeft(l, k, r);
+    return _attach(l, k, r);
+  }
+
+  static NODE* _joinRight(NODE* l, NODE* k, NODE* r)
+  {
+    NODE* c = _rightChild(l);
+
+    if (_h(c) <= _h(r) + 1)
+    {
+      NODE* t = _attach(c, k, r);
+
+      if (_h(t) <= _h(l->Left) + 1)
+        return _attach(l->Left, l, t);
+
+      return _rotateLeft(_attach(l->Left, l, _rotateRight(t)));
+    }
+
+    NODE* t = _joinRight(c, k, r);
+    _attach(l->Left, l, t);
+
+    return _h(t) <= _h(l->Left) + 1 ? l : _rotateLeft(l);
+  }
+
+  static NODE* _joinLeft(NODE* l, NODE* k, NODE* r)
+  {
+    NODE* c = r->Left;
+
+    if (_h(c) <= _h(l) + 1)
+    {
+      NODE* t = _attach(l, k, c);
+      if (c == nullptr)
+        k->Right = r;  // r is k's successor
+
+      if (_h(t) <= _h(_rightChild(r)) + 1)
+        return _attach(t, r, _rightChild(r));
+
+      return _rotateRight(_attach(_rotateLeft(t), r, _rightChild(r)));
+    }
+
+    NODE* t = _joinLeft(l, k, c);
+    _attach(t, r, _rightChild(r));
+
+    return _h(t) <= _h(_rightChild(r)) + 1 ? r : _rotateRight(r);
+  }
+
+  //
+  // _splitLast / _joinLast:
+  //
+  // _joinLast joins l and r with no key in between, by taking the largest node of
+  // l as the middle key, which _splitLast takes out; "last" is set to
+  // that node.
+  //
+  // Time complexity:  O(lgN)
+  //
+  static NODE* _splitLast(NODE* cur, NODE*& last)
+  {
+    NODE* r = _rightChild(cur);
+
+    if (r == nullptr)
+    {
+      last = cur;
+      return cur->Left;
+    }
+
+    // cur keeps its old Right, last, as its thread if it ends up largest
+    return _join(cur->Left, cur, _splitLast(r, last));
+  }
+
+  static NODE* _joinLast(NODE* l, NODE* r, NODE*& last)
+  {
+    last = nullptr;
+    if (l == nullptr)
+      return r;
+
+    NODE* rest = _splitLast(l, last);
+    return _join(rest, last, r);
+  }
+
+  //
+  // _split:
+  //
+  // Splits the subtree "root" into the keys < key ("less") and the keys
+  // > key ("more"); the node with the key itself, if any, is detached
+  // and returned via "found".  "max" is the largest node of the subtree
+  // when known.  The nodes on the search path are joined back onto the
+  // two sides on the way up, and since each of them is joined to the
+  // subtree it was already next to, only less's largest node is left
+  // with a thread to fix.
+  //
+  // Time complexity:  O(lgN)
+  //
+  void _split(NODE* root, NODE* max, const KeyT& key,
+              SUBTREE& less, NODE*& found, SUBTREE& more) const
+  {
+    if (root == nullptr)
+    {
+      less = more = SUBTREE{ nullptr, nullptr };
+      found = nullptr;
+      return;
+    }
+
+    NODE* l = root->Left;
+    NODE* r = _rightChild(root);
+    int c = _compare(key, root->Key);
+
+    if (c < 0)
+    {
+      SUBTREE between;
+      _split(l, nullptr, key, less, found, between);
+
+      more.Root = _join(between.Root, root, r);
+      more.Max = r != nullptr ? max : root;
+    }
+    else if (c > 0)
+    {
+      SUBTREE between;
+      _split(r, max, key, between, found, more);
+
+      less.Root = _join(l, root, between.Root);
+      less.Max = between.Root != nullptr ? between.Max : root;
+    }
+    else
+    {
+      found = root;
+      less = SUBTREE{ l, _max(l) };
+      more = SUBTREE{ r, r != nullptr ? max : nullptr };
+    }
+  }
+
+  //
+  // DROPPED:
+  //
+  // Nodes a set operation leaves out, linked through their Left
+  // pointers so that gathering them never allocates (and never throws).
+  //
+  struct DROPPED
+  {
+    NODE*  First;
+    NODE** Last;
+    int    Count;
+
+    DROPPED() : First(nullptr), Last(&First), Count(0) { }
+    DROPPED(const DROPPED&) = delete;
+    DROPPED& operator=(const DROPPED&) = delete;
+
+    void add(NODE* node)
+    {
+      node->Left = nullptr;
+      *Last = node;
+      Last = &node->Left;
+      Count++;
+    }
+
+    void add(DROPPED& other)
+    {
+      if (other.First == nullptr)
+        return;
+
+      *Last = other.First;
+      Last = other.Last;
+      Count += other.Count;
+    }
+
+    void addSubtree(NODE* cur)
+    {
+      if (cur == nullptr)
+        return;
+
+      NODE* left = cur->Left;
+      NODE* right = _rightChild(cur);
+
+      add(cur);
+      addSubtree(left);
+      addSubtree(right);
+    }
+  };
+
+  //
+  // _fork: runs left() and right(), on two threads if "parallel".
+  //
+  template<typename Left, typename Right>
+  static void _fork(bool parallel, Left left, Right right)
+  {
+    future<void> done;
+
+    if (parallel)
+    {
+      try
+      {
+        done = async(launch::async, left);
+      }
+      catch (...)  // no thread to be had, do it here
+      {
+        parallel = false;
+      }
+    }
+
+    if (!parallel)
+      left();
+
+    try
+    {
+      right();
+    }
+    catch (...)
+    {
+      if (parallel)
+        done.wait();
+      throw;
+    }
+
+    if (parallel)
+      done.get();
+  }
+
+  //
+  // _forks: how many levels of fork-join to use, lg of the # of cores.
+  // Asking for the # of cores takes a system call, so it's asked once.
+  //
+  static int _forks()
+  {
+    static const int forks = []()
+    {
+      int levels = 0;
+      for (unsigned threads = thread::hardware_concurrency(); threads > 1; threads /= 2)
+        levels++;
+
+      return levels;
+    }();
+
+    return forks;
+  }
+
+  //
+  // _setOperation:
+  //
+  // Shared by union, intersection and difference, which are
+  // divide-and-conquer on the root k of a: split b by k, combine the two
+  // halves of a with the two halves of b (independently, so in parallel
+  // when they are big enough), then join the results around k -- or
+  // without k when it has to go.  Nodes dropped from either tree are
+  // gathered in "dropped" and freed by the caller.  Nothing here
+  // allocates, so both trees are always left whole.
+  //
+  // Time complexity:  O(m lg(n/m + 1)) for trees of m <= n nodes
+  //
+  enum SETOP { UNION, INTERSECTION, DIFFERENCE };
+
+  static const int PARALLEL_HEIGHT = 12;
+
+  SUBTREE _setOperation(SETOP op, SUBTREE a, SUBTREE b,
+                        DROPPED& dropped, int forks) const
+  {
+    if (a.Root == nullptr || b.Root == nullptr)
+    {
+      if (op == UNION)
+        return a.Root != nullptr ? a : b;
+
+      dropped.addSubtree(b.Root);
+      if (op == DIFFERENCE)
+        return a;
+
+      dropped.addSubtree(a.Root);
+      return SUBTREE{ nullptr, nullptr };
+    }
+
+    NODE* k = a.Root;
+
+    SUBTREE bLess, bMore;
+    NODE* same;
+    _split(b.Root, b.Max, k->Key, bLess, same, bMore);
+
+    SUBTREE less, more;
+    DROPPED droppedLess;
+
+    bool parallel = forks > 0 && _h(a.Root) >= PARALLEL_HEIGHT && _h(b.Root) >= PARALLEL_HEIGHT / 2;
+
+    _fork(parallel,
+      [&]() { less = _setOperation(op, SUBTREE{ k->Left, nullptr }, bLess, droppedLess, forks - 1); },
+      [&]() { more = _setOperation(op, SUBTREE{ _rightChild(k), a.Max }, bMore, dropped, forks - 1); });
+
+    dropped.add(droppedLess);
+
+    if (same != nullptr)
+      dropped.add(same);
+
+    bool keep = (op == UNION) || ((same != nullptr) == (op == INTERSECTION));
+
+    if (!keep)
+    {
+      dropped.add(k);
+
+      NODE* last;
+      NODE* root = _joinLast(less.Root, more.Root, last);
+
+      return SUBTREE{ root, more.Root != nullptr ? more.Max : last };
+    }
+
+    if (less.Root != nullptr && less.Max != nullptr)
+    {
+      less.Max->Right = k;
+      less.Max->isThreaded = true;
+    }
+
+    NODE* root = _join(less.Root, k, more.Root);
+
+    return SUBTREE{ root, more.Root != nullptr ? more.Max : k };
+  }
+
+  //
+  // _combine:
+  //
+  // Runs op with this tree as a and other as b, leaving the result in
+  // this tree and other empty.  other's memory is taken over, since
+  // some of its nodes may end up here.
+  //
+  void _combine(SETOP op, avlt& other)
+  {
+    int forks = _forks();
+
+    Pool.absorb(other.Pool);
+
+    DROPPED dropped;
+
+    SUBTREE result = _setOperation(op, SUBTREE{ Root, nullptr },
+                                   SUBTREE{ other.Root, _max(other.Root) }, dropped, forks);
+
+    _endThread(result.Max);
+
+    Root = result.Root;
+    Size += other.Size - dropped.Count;
+    ptr = nullptr;
+    Spine.clear();
+
+    other.Root = nullptr;
+    other.Size = 0;
+    other.ptr = nullptr;
+    other.Spine.clear();
+
+    _freeDropped(dropped);
+  }
+
+  //
+  // _eraseSorted:
+  //
+  // Removes the sorted keys [first, last) from the subtree "a", top-down
+  // the way _setOperation takes a difference: the keys below the root go
+  // to the left subtree, the ones above it to the right, and the two
+  // results are joined back around the root -- or without it when its
+  // key is one of them.  Subtrees no key falls in are left untouched,
+  // so the work follows the union of the k search paths.  Removed nodes
+  // are gathered in "dropped".
+  //
+  // Time complexity:  O(k lg(n/k + 1)) for k keys and n nodes
+  //
+  SUBTREE _eraseSorted(SUBTREE a, const KeyT* first, const KeyT* last,
+                       DROPPED& dropped) const
+  {
+    if (a.Root == nullptr || first == last)
+      return a;
+
+    NODE* k = a.Root;
+
+    const KeyT* mid = std::lower_bound(first, last, k->Key, Comp);
+    bool drop = mid != last && !Comp(k->Key, *mid);
+
+    SUBTREE less = _eraseSorted(SUBTREE{ k->Left, nullptr }, first, mid, dropped);
+    SUBTREE more = _eraseSorted(SUBTREE{ _rightChild(k), a.Max }, drop ? mid + 1 : mid, last, dropped);
+
+    if (drop)
+    {
+      dropped.add(k);
+
+      NODE* joint;
+      NODE* root = _joinLast(less.Root, more.Root, joint);
+
+      return SUBTREE{ root, more.Root != nullptr ? more.Max : joint };
+    }
+
+    if (less.Root != nullptr && less.Max != nullptr)
+    {
+      less.Max->Right = k;
+      less.Max->isThreaded = true;
+    }
+
+    NODE* root = _join(less.Root, k, more.Root);
+
+    return SUBTREE{ root, more.Root != nullptr ? more.Max : k };
+  }
+
+  //
+  // _freeDropped: frees the nodes gathered by a set operation or erase.
+  //
+  void _freeDropped(DROPPED& dropped)
+  {
+    for (NODE* cur = dropped.First; cur != nullptr; )
+    {
+      NODE* next = cur->Left;
+      _freeNode(cur);
+      cur = next;
+    }
+  }
+
+  //
+  // union_with
+  //
+  // Adds every key of "other" that is not already in the tree; where
+  // both have a key, this tree's value wins, as with insert.  Pass
+  // other with std::move to hand its nodes over rather than copy them.
+  //
+  // Time complexity:  O(m lg(n/m + 1)) for trees of m <= n keys, plus
+  // O(m) to copy other if it is not moved
+  //
+  void union_with(avlt other)
+  {
+    _combine(UNION, other);
+  }
+
+  //
+  // intersect_with
+  //
+  // Keeps only the keys that are also in "other", with this tree's
+  // values.
+  //
+  // Time complexity:  O(m lg(n/m + 1)) for trees of m <= n keys, plus
+  // O(1) per key removed
+  //
+  void intersect_with(avlt other)
+  {
+    _combine(INTERSECTION, other);
+  }
+
+  //
+  // difference_with
+  //
+  // Removes every key that is in "other".
+  //
+  // Time complexity:  O(m lg(n/m + 1)) for trees of m <= n keys, plus
+  // O(1) per key removed
+  //
+  void difference_with(avlt other)
+  {
+    _combine(DIFFERENCE, other);
+  }
+
+  //
+  // _sizeOfLess:
+  //
+  // The # of nodes in "less", the smaller-key half of a split tree of
+  // "total" nodes whose other half is "more".  Both halves' threads
+  // must already end in nullptr.
+  //
+  static int _sizeOfLess(NODE* less, NODE*, int, true_type)
+  {
+    return _count(less);
+  }
+
+  static int _sizeOfLess(NODE* less, NODE* more, int total, false_type)
+  {
+    int n = 0;
+    NODE* a = _leftmost(less);
+    NODE* b = _leftmost(more);
+
+    while (a != nullptr && b != nullptr)
+    {
+      a = _successor(a);
+      b = _successor(b);
+      n++;
+    }
+
+    return a == nullptr ? n : total - n;
+  }
+
+  //
+  // split
+  //
+  // Splits "tree" in two, returning the keys < key as first and the
+  // keys >= key as second.  No nodes are copied or moved in memory: the
+  // search path for key is cut and each side rejoined, and the two
+  // trees share the original tree's memory from then on.  Pass the
+  // tree with std::move, or it is copied first.
+  //
+  // The O(lgN) bound holds only for avlt<KeyT, ValueT, true>.  Without
+  // order statistics the nodes don't know the sizes of their subtrees,
+  // and nothing on the cut path does either, so the two halves are
+  // walked in step until the smaller one runs out and its size gives
+  // the other's: a split near the middle then costs O(N).  Trees that
+  // are split often, such as shards handed off by key range, should
+  // turn order statistics on.
+  //
+  // Time complexity:  O(lgN) with OrderStatistics = true; otherwise
+  // O(lgN + min(|first|, |second|)), O(N) at worst.  Plus O(N) to copy
+  // a tree not moved
+  //
+  static pair<avlt, avlt> split(avlt tree, const KeyT& key)
   {
-    KeyT   Key;
-    ValueT Value;
-    NODE*  Left;
-    NODE*  Right;
-    bool   isThreaded; // true => Right is a thread, false => non-threaded
-    int    Height;     // height of tree rooted at this node
-  };
+    pair<avlt, avlt> halves(avlt(tree.Comp), avlt(tree.Comp));
+    avlt& less = halves.first;
+    avlt& more = halves.second;
+
+    tree.Pool.share(more.Pool);
+
+    SUBTREE lower, upper;
+    NODE* found;
+    tree._split(tree.Root, _max(tree.Root), key, lower, found, upper);
+
+    if (found != nullptr)  // key itself goes with the larger keys
+    {
+      upper.Root = _join(nullptr, found, upper.Root);
+      if (upper.Max == nullptr)
+        upper.Max = found;
+    }
+
+    _endThread(lower.Max);
+    _endThread(upper.Max);
+
+    less.Root = lower.Root;
+    more.Root = upper.Root;
+    less.Size = _sizeOfLess(lower.Root, upper.Root, tree.Size, COUNTED());
+    more.Size = tree.Size - less.Size;
+
+    less.Pool.swap(tree.Pool);
+    tree.Root = nullptr;
+    tree.Size = 0;
+
+    return halves;
+  }
 
-  NODE* Root;  // pointer to root node of tree (nullptr if empty)
-  int   Size;  // # of nodes in the tree (0 if empty)
-  NODE* ptr = nullptr; //pointer to copy the node data from the begin function to the next function
-  
-public:
   //
-  // default constructor:
+  // concat
   //
-  // Creates an empty tree.
+  // Returns the tree holding the keys of "left" followed by the keys of
+  // "right"; every key in left must be < every key in right, otherwise
+  // std::invalid_argument is thrown and nothing is changed.  Pass the
+  // trees with std::move, or they are copied first.
   //
-  avlt()
+  // Time complexity:  O(lgN), plus O(N) to copy trees not moved
+  //
+  static avlt concat(avlt left, avlt right)
   {
-    Root = nullptr;
-    Size = 0;
+    NODE* leftMax = _max(left.Root);
+
+    if (leftMax != nullptr && right.Root != nullptr
+        && !left.Comp(leftMax->Key, _leftmost(right.Root)->Key))
+      throw invalid_argument("avlt::concat: keys of left must be < keys of right");
+
+    left.Pool.absorb(right.Pool);
+
+    NODE* last;
+    left.Root = _joinLast(left.Root, right.Root, last);
+
+    if (right.Root == nullptr)  // left's largest is still the largest
+      _endThread(last);
+
+    left.Size += right.Size;
+    left.ptr = nullptr;
+    left.Spine.clear();
+
+    right.Root = nullptr;
+    right.Size = 0;
+
+    return left;
   }
-  
+
   //
-  // helper functions to return the Left and Right pointers; in
-  // particular the ptr returned for the Right is controlled by 
-  // the "isThreaded" field:  if "isThreaded" is true then nullptr
-  // pointer is returned, otherwise the actual underyling ptr
-  // is returned.
+  // _sortBatch:
   //
-  NODE* _getActualLeft(NODE* cur) const
+  // Stable sort of [first, last) by key.  The two halves are sorted on
+  // separate threads, "forks" levels deep, and then merged.
+  //
+  // Time complexity:  O(k lgk / P + k) for k pairs and P threads
+  //
+  typedef pair<KeyT, ValueT> PAIR;
+
+  bool _pairLess(const PAIR& a, const PAIR& b) const
   {
-    return cur->Left;
+    return Comp(a.first, b.first);
   }
 
-  NODE* _getActualRight(NODE* cur) const
+  void _sortBatch(PAIR* first, PAIR* last, int forks) const
   {
-    if (cur->isThreaded)  // then actual Right ptr is null:
-      return nullptr;
-    else  // actual Right is contents of Right ptr:
-      return cur->Right;
+    static const ptrdiff_t PARALLEL_SORT = 16384;
+
+    auto less = [this](const PAIR& a, const PAIR& b) { return _pairLess(a, b); };
+
+    if (forks <= 0 || last - first < PARALLEL_SORT)
+    {
+      std::stable_sort(first, last, less);
+      return;
+    }
+
+    PAIR* mid = first + (last - first) / 2;
+
+    _fork(true,
+      [this, first, mid, forks]() { _sortBatch(first, mid, forks - 1); },
+      [this, mid, last, forks]() { _sortBatch(mid, last, forks - 1); });
+
+    std::inplace_merge(first, mid, last, less);
   }
 
   //
-  // _copy
+  // _mergeRebuild:
   //
-  // Makes a copy of "othercur" into "this" tree.
+  // Merges the sorted, duplicate-free batch with an inorder walk of the
+  // tree, making nodes for the keys not already there, and relinks all
+  // of them into a perfectly balanced tree.
   //
-  void _copy(NODE* &cur, NODE* other)
+  // Time complexity:  O(N + k)
+  //
+  void _mergeRebuild(const vector<PAIR>& batch)
   {
-    if(other == nullptr){
-            return;
-        }      
-    if(other != nullptr){
-        NODE *node = new NODE();
-        node->Key = other->Key;
-        node->Value = other->Value;
-        node->Height = other->Height;
-        node->isThreaded = other->isThreaded;
-        node->Left = other->Left;
-        node->Right = other->Right;
-        cur = node;
+    vector<NODE*> nodes, made;
+    nodes.reserve(Size + batch.size());
+    made.reserve(batch.size());
+
+    NODE* cur = _leftmost(Root);
+    size_t i = 0;
+
+    try
+    {
+      while (cur != nullptr || i < batch.size())
+      {
+        if (i == batch.size() || (cur != nullptr && !Comp(batch[i].first, cur->Key)))
+        {
+          if (i < batch.size() && !Comp(cur->Key, batch[i].first))  // already there
+            i++;
 
-        _copy(node->Left,other->Left);
-        if(other->isThreaded == false){
-            _copy(node->Right, other->Right);
+          nodes.push_back(cur);
+          cur = _successor(cur);
+        }
+        else
+        {
+          made.push_back(_newNode(batch[i].first, batch[i].second));
+          nodes.push_back(made.back());
+          i++;
         }
-    }   
+      }
+    }
+    catch (...)  // the tree is untouched; drop the nodes made so far
+    {
+      for (NODE* node : made)
+        _freeNode(node);
+      throw;
+    }
+
+    Spine.clear();
+
+    Root = _build([&nodes](size_t j) { return nodes[j]; }, 0, nodes.size(), nullptr);
+    Size = (int) nodes.size();
   }
 
   //
-  // copy constructor
+  // _insertEach:
   //
-  // NOTE: makes an exact copy of the "other" tree, such that making the
-  // copy requires no rotations.
+  // Inserts the batch one pair at a time.  If a copy throws, the keys
+  // this added are erased again, so the tree is left as it was.
   //
-  avlt (const avlt& other)
+  // Time complexity:  O(k lgN)
+  //
+  void _insertEach(const vector<PAIR>& batch)
   {
-    Root = NULL;
-    Size = other.Size;
-    ptr = nullptr;
+    vector<size_t> added;
+    added.reserve(batch.size());
+
+    try
+    {
+      for (size_t i = 0; i < batch.size(); ++i)
+      {
+        int before = Size;
+        insert(batch[i].first, batch[i].second);
 
-    _copy(Root, other.Root);  // to be safe, copy this state as well:
+        if (Size != before)
+          added.push_back(i);
+      }
+    }
+    catch (...)
+    {
+      for (size_t i : added)
+        erase(batch[i].first);
+      throw;
+    }
   }
-  
+
   //
-  //destroy:
+  // insert_bulk
   //
-  //Helper function to delete the nodes and free up the space
+  // Inserts the (key, value) pairs in [first, last), in any order;
+  // pairs are accessed as it->first and it->second.  As with insert,
+  // keys already in the tree keep their values, and of keys repeated in
+  // the batch the first one wins.
   //
-  void destroy(NODE* cur)
+  // The batch is sorted, in parallel where there are cores for it, and
+  // then goes in one of three ways depending on its size k next to the
+  // tree's: merged with the whole tree and the tree rebuilt when k >=
+  // Size / BULK_REBUILD; built into a tree of its own and joined in with
+  // union_with, which runs in parallel, when k >= Size / BULK_PARALLEL
+  // and there is more than one core; otherwise inserted one key at a
+  // time in sorted order, where each search finds the path of the one
+  // before it still in cache -- or, in a tree of fewer than BULK_SORTED
+  // keys, which stays in cache anyway, in the batch's own order without
+  // sorting it at all.
+  //
+  // The constants come from the "bulk" workload of bench.cpp (make
+  // bench).  On one core an insert loop in sorted order beats the join
+  // up to batches of about Size / 3, and the merge-and-rebuild beats
+  // both from there on; sorting the batch first starts to pay at about
+  // 10^5 keys in the tree, and is 1.3x-2x faster at 10^6.
+  //
+  // Time complexity:  O(k lgk / P + N + k) for large batches, O(k lgk / P
+  // + k lg(N/k + 1)) for medium ones, O(k lgN) for small ones, for k
+  // pairs and P threads
+  //
+  static const int BULK_REBUILD = 4;
+  static const int BULK_PARALLEL = 10;
+  static const int BULK_SORTED = 65536;
+
+  template<typename InputIt>
+  void insert_bulk(InputIt first, InputIt last)
   {
-      if(cur == NULL) 
-          return;
-      else{
-          destroy(cur->Left);
-          if(cur->isThreaded == true){
-              cur->Right = nullptr;
-          }
-          destroy(cur->Right);
-          delete cur;
-      }
+    vector<PAIR> batch;
+
+    for (; first != last; ++first)
+      batch.emplace_back(first->first, first->second);
+
+    if (batch.empty())
+      return;
+
+    size_t k = batch.size();
+    bool parallel = k * BULK_PARALLEL >= (size_t) Size && _forks() > 0;
+
+    if (k * BULK_REBUILD < (size_t) Size && !parallel && Size < BULK_SORTED)
+    {
+      _insertEach(batch);  // a tree this small stays in cache
+      return;
+    }
+
+    _sortBatch(batch.data(), batch.data() + batch.size(), _forks());
+
+    batch.erase(std::unique(batch.begin(), batch.end(),
+                            [this](const PAIR& a, const PAIR& b) { return !_pairLess(a, b); }),
+                batch.end());
+
+    k = batch.size();
+
+    if (k * BULK_REBUILD >= (size_t) Size)
+      _mergeRebuild(batch);
+    else if (parallel)
+    {
+      avlt delta(Comp);
+      delta.assign_sorted(batch.begin(), batch.end());
+      union_with(std::move(delta));
+    }
+    else
+      _insertEach(batch);
   }
 
   //
-  // destructor:
+  // []
   //
-  // Called automatically by system when tree is about to be destroyed;
-  // this is our last chance to free any resources / memory used by
-  // this tree.
+  // Returns a reference to the value for the given key; if the key is
+  // not found, a reference to a default value ValueT{} is returned.
+  // Unlike std::map, [] never inserts; see at() and try_emplace().
   //
-  virtual ~avlt()
+  // Time complexity:  O(lgN) worst-case
+  //
+  const ValueT& operator[](const KeyT& key) const
   {
-    destroy(Root);
+    static const ValueT none{ };
+
+    NODE* cur = _findNode(key);
+
+    return cur != nullptr ? cur->Value : none;
   }
 
   //
-  // operator=
+  // at
   //
-  // Clears "this" tree and then makes a copy of the "other" tree.
+  // Returns a reference to the value for the given key; throws
+  // std::out_of_range if the key is not in the tree.
   //
-  // NOTE: makes an exact copy of the "other" tree, such that making the
-  // copy requires no rotations.
+  // Time complexity:  O(lgN) worst-case
   //
-  avlt& operator=(const avlt& other)
+  ValueT& at(const KeyT& key)
+  {
+    NODE* cur = _findNode(key);
+
+    if (cur == nullptr)
+      throw out_of_range("avlt::at: key not found");
+
+    return cur->Value;
+  }
+
+  const ValueT& at(const KeyT& key) const
+  {
+    return const_cast<avlt*>(this)->at(key);
+  }
+
+  //
+  // ()
+  //
+  // Finds the key in the tree, and returns the key to the "right".
+  // If the right is threaded, this will be the next inorder key.
+  // if the right is not threaded, it will be the key of whatever
+  // node is immediately to the right.
+  //
+  // If no such key exists, or there is no key to the "right", the
+  // default key value KeyT{} is returned; successor() answers for any
+  // key, and says "none" with end().
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  KeyT operator()(const KeyT& key) const
   {
+    NODE* cur = Root;
+    PROBE probe(Counters);
     
-    clear();
-    //
-    // now copy the other one:
-    //
-    _copy(Root, other.Root);
-    Size = other.Size;
+    while (cur != nullptr)
+    {
+      probe.visit();
+      int c = _compare(key, cur->Key);
+
+      if (c == 0){  // the key is in current/root, i.e the key has been found...
+      
+          if(cur->isThreaded == true && cur->Right == nullptr){
+              return KeyT{ }; //no right key exists, then break and return the default value
+          }
+          else if(cur->isThreaded == true && cur->Right != nullptr){
+              cur = cur->Right; //transverse the thread to go to they key connected with the thread...
+              return cur->Key; //return the key at the threaded link
+          }
+          else if (cur->isThreaded == false){
+              cur = cur->Right;
+              return cur->Key; //if there is no thread then just return the key to the right of the required key 
+          }
+      }
 
-    this->ptr = other.ptr;  // to be safe, copy this state as well:
+      if (c < 0)  // search left:
+      {
+          cur = cur->Left;
+      }
+      else
+      {
+          if(cur->isThreaded) //if the right is threaded
+              cur = nullptr; //stop the transversal, meaning the thread is not there
+          else //not threaded, meaning there is a node to go to
+              cur = cur->Right;
+      }
+    }//while
 
-    return *this;
+    return KeyT{ };
   }
 
   //
-  // clear:
+  // %
   //
-  // Clears the contents of the tree, resetting the tree to empty.
+  // Returns the height stored in the node that contains key; if key is
+  // not found, -1 is returned.
   //
-  void clear()
+  // Example:  cout << tree%12345 << endl;
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  int operator%(const KeyT& key) const
   {
-    destroy(Root);
-    Size = 0;
-    Root = NULL;
+    NODE* cur = Root;
+    PROBE probe(Counters);
+
+    while (cur != nullptr)
+    {
+      probe.visit();
+      int c = _compare(key, cur->Key);
+
+      if (c == 0){ // already in tree
+          return cur->Height;
+      }  
+        
+      if (c < 0)  // search left:
+      {
+        cur = cur->Left;
+      }
+      else //searches right
+      {
+          if(cur->isThreaded){ //if the right is threaded
+              cur = nullptr; //declare the right as null ptr and stop the transversal
+          }else{ //if right is not threaded
+              cur = cur->Right;
+          }
+      }
+    }//while  
+  
+    // if get here, not found
+    return -1;
   }
 
-  // 
-  // size:
   //
-  // Returns the # of nodes in the tree, 0 if empty.
+  // begin
   //
-  // Time complexity:  O(1) 
+  // Resets internal state for an inorder traversal.  After the 
+  // call to begin(), the internal state denotes the first inorder
+  // key; this ensure that first call to next() function returns
+  // the first inorder key.
   //
-  int size() const
+  // Space complexity: O(1)
+  // Time complexity:  O(lgN) worst-case
+  //
+  // Example usage:
+  //    tree.begin();
+  //    while (tree.next(key))
+  //      cout << key << endl;
+  //
+  // Also returns an iterator to the first key, so begin() / end() work
+  // with range-based for loops and the standard algorithms.
+  //
+  iterator begin()
   {
-    return Size;
+    ptr = _leftmost(Root); //copy the data of the cur node to the ptr node
+
+    return iterator(ptr);
+  }
+
+  //
+  // begin / end / cbegin / cend
+  //
+  // Iterators over the keys in order.  The const versions leave the
+  // internal begin()/next() state alone, so several threads may iterate
+  // the same const tree at once without locking.
+  //
+  // Time complexity:  O(lgN) for begin, O(1) for end
+  //
+  const_iterator begin() const
+  {
+    return const_iterator(_leftmost(Root));
+  }
+
+  const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+  iterator end()
+  {
+    return iterator(nullptr);
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(nullptr);
+  }
+
+  const_iterator cend() const
+  {
+    return end();
   }
 
-  // 
-  // height:
   //
-  // Returns the height of the tree, -1 if empty.
+  // find
   //
-  // Time complexity:  O(1) 
+  // Returns an iterator to the given key, or end() if not found.
   //
-  int height() const
+  // Time complexity:  O(lgN) worst-case
+  //
+  iterator find(const KeyT& key)
   {
-    if (Root == nullptr)
-      return -1;
-    else
-      return Root->Height;
+    return iterator(_findNode(key));
+  }
+
+  const_iterator find(const KeyT& key) const
+  {
+    return const_iterator(_findNode(key));
   }
 
-  // 
-  // search:
   //
-  // Searches the tree for the given key, returning true if found
-  // and false if not.  If the key is found, the corresponding value
-  // is returned via the reference parameter.
+  // lower_bound
+  //
+  // Returns an iterator to the first key >= the given key, or end().
   //
   // Time complexity:  O(lgN) worst-case
   //
-  bool search(KeyT key, ValueT& value) const
+  iterator lower_bound(const KeyT& key)
   {
-    NODE* cur = Root;
+    return iterator(_lowerBound(key));
+  }
 
-      while (cur != nullptr)
-      {
-        if (key == cur->Key){ // already in tree
-            value = cur->Value;
-            return true;
-        }  
-          
-        if (key < cur->Key)  // search left:
-        {
-          cur = cur->Left;
-        }
-        else //searches right
-        {
-            if(cur->isThreaded){ //if the right is threaded
-                cur = nullptr; //declare the right as null ptr and stop the transversal
-            }else{ //if right is not threaded
-                cur = cur->Right;
-            }
-        }
-      }//while  
-  
-      // if get here, not found
-      return false;
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    return const_iterator(_lowerBound(key));
   }
-  
-  // 
-  // search_helper:
+
+  //
+  // upper_bound
   //
-  // Helper function for the range_search
-  // Find the lower key in the avl tree
-  // and returns true if found
+  // Returns an iterator to the first key > the given key, or end().
   //
   // Time complexity:  O(lgN) worst-case
   //
-  bool search_helper(KeyT key)
+  iterator upper_bound(const KeyT& key)
   {
-    NODE* cur = Root;
+    return iterator(_upperBound(key));
+  }
 
-      while (cur != nullptr)
-      {
-        if (key == cur->Key){ // already in tree
-            return true;
-        }  
-          
-        if (key < cur->Key)  // search left:
-        {
-          cur = cur->Left;
-        }
-        else //searches right
-        {
-            if(cur->isThreaded){ //if the right is threaded
-                cur = nullptr; //declare the right as null ptr and stop the transversal
-            }else{ //if right is not threaded
-                cur = cur->Right;
-            }
-        }
-      }//while  
-  
-      // if get here, not found
-      return false;
+  const_iterator upper_bound(const KeyT& key) const
+  {
+    return const_iterator(_upperBound(key));
   }
 
   //
-  // range_search
-  //
-  // Searches the tree for all keys in the range [lower..upper], inclusive.
-  // It is assumed that lower <= upper.  The keys are returned in a vector;
-  // if no keys are found, then the returned vector is empty.
+  // ceiling / floor
   //
-  // Time complexity: O(lgN + M), where M is the # of keys in the range
-  // [lower..upper], inclusive.
+  // ceiling returns an iterator to the smallest key >= the given key,
+  // the same as lower_bound; floor returns an iterator to the largest
+  // key <= the given key.  Either is end() if there is no such key.
+  // The key need not be in the tree, and the iterator can go on to scan
+  // the keys after it, following the threads with no further search.
   //
-  // NOTE: do not simply traverse the entire tree and select the keys
-  // that fall within the range.  That would be O(N), and thus invalid.
-  // Be smarter, you have the technology.
+  // Time complexity:  O(lgN) worst-case
   //
-  vector<KeyT> range_search(KeyT lower, KeyT upper)
+  iterator ceiling(const KeyT& key)
   {
-    vector<KeyT>  keys;
-    
-    while(lower <= upper){
-        if(search_helper(lower) == true){
-            keys.push_back(lower);
-            lower++; //increase the lower limit
-        }else{
-            lower++; //increase the lower limit
-        }
-    }
-    return keys; //return the vector
+    return iterator(_lowerBound(key));
   }
-  
-  //
-  // Helper functions to get the heights 
-  // of various nodes that are used in
-  // the insert function, etc.
-  // 
-  int heightHelper(NODE* A){
-      if(A == nullptr)
-          return -1;
-      else
-         return A->Height;
+
+  const_iterator ceiling(const KeyT& key) const
+  {
+    return const_iterator(_lowerBound(key));
   }
-  
-  int heightRight(NODE* A){
-      if(A->isThreaded == true)
-          return -1;
-      else
-          return A->Right->Height;
+
+  iterator floor(const KeyT& key)
+  {
+    return iterator(_floor(key, true));
+  }
+
+  const_iterator floor(const KeyT& key) const
+  {
+    return const_iterator(_floor(key, true));
   }
 
   //
-  // _RightRotate
+  // successor / predecessor
   //
-  // Rotates the tree around the node N, where Parent is N's parent.  Note that
-  // Parent could be null, which means N is the root of the entire tree.  If 
-  // Parent denotes a node, note that N could be to the left of Parent, or to
-  // the right.  You'll need to take all this into account when linking in the
-  // new root after the rotation. Update the heights and the threads as well.
+  // successor returns an iterator to the smallest key > the given key,
+  // the same as upper_bound; predecessor returns an iterator to the
+  // largest key < the given key.  Either is end() if there is no such
+  // key.  Unlike (), the key need not be in the tree, and "none" is
+  // end() rather than KeyT{ }.
   //
-   void rightRotate(NODE* Parent, NODE* N)
+  // Time complexity:  O(lgN) worst-case
+  //
+  iterator successor(const KeyT& key)
   {
-     // 1) Lable the components
-     // 2) rotate
-     // 3) update parent to link to L
-     // 4) update N's height
-     // 5) update L's height
-     
-     NODE* L = N->Left; // Step 1
-     NODE* B = L->Right;
-     
-     if(L->isThreaded){
-         B = nullptr;
-     }
-     
-     N->Left = B; //Step 2
-     L->Right = N;
-     L->isThreaded = false;
-     
-     if(Parent == nullptr){ //Step 3
-        Root = L;
-     }
-     else if (L->Key < Parent->Key){
-        Parent->Left = L;
-     }
-     else{
-        Parent->Right = L;
-     }
-     
-     N->Height = 1 + max(heightHelper(N->Left), heightRight(N)); //Step 4
-     L->Height = 1 + max(heightHelper(L->Left), heightRight(L)); //Step 5
+    return iterator(_upperBound(key));
   }
-  
+
+  const_iterator successor(const KeyT& key) const
+  {
+    return const_iterator(_upperBound(key));
+  }
+
+  iterator predecessor(const KeyT& key)
+  {
+    return iterator(_floor(key, false));
+  }
+
+  const_iterator predecessor(const KeyT& key) const
+  {
+    return const_iterator(_floor(key, false));
+  }
+
   //
-  // _LeftRotate
+  // search / find / lower_bound / at / rank and the neighbor queries
+  // by another type of key
   //
-  // Rotates the tree around the node N, where Parent is N's parent.  Note that
-  // Parent could be null, which means N is the root of the entire tree.  If 
-  // Parent denotes a node, note that N could be to the left of Parent, or to
-  // the right.  You'll need to take all this into account when linking in the
-  // new root after the rotation. Update the heights and the threads as well.
+  // With a transparent Compare, one with an is_transparent type such as
+  // avlt_less<>, lookups take any key type that Compare can compare with
+  // KeyT, and no KeyT is made: e.g. an avlt<string, int, false,
+  // avlt_no_aggregate, avlt_no_stats, avlt_less<>> can be searched with
+  // a string_view or a const char*.
   //
-  void leftRotate(NODE* Parent, NODE* N)
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  bool search(const K& key, ValueT& value) const
   {
-     // 1) Lable the components
-     // 2) rotate
-     // 3) update parent to link to L
-     // 4) update N's height
-     // 5) update R's height
-     
-     NODE* R = N->Right; //Step 1
-     NODE* B = R->Left;
+    NODE* cur = _findNode(key);
 
-     R->Left = N; //Step 2
-     N->Right = B;
-     if(B == nullptr){
-         N->Right = R;
-         N->isThreaded = true;
-     }
+    if (cur == nullptr)
+      return false;
 
-     if(Parent == nullptr){ //Step 3
-        Root = R;
-     }
-     else if (Parent->Right  == N){
-        Parent->Right = R;
-     }
-     else{
-        Parent->Left = R;
-     }
-    
-     N->Height = 1 + max(heightHelper(N->Left), heightRight(N));
-     R->Height = 1 + max(N->Height, heightRight(R));
+    value = cur->Value;
+    return true;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator find(const K& key)
+  {
+    return iterator(_findNode(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator find(const K& key) const
+  {
+    return const_iterator(_findNode(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator lower_bound(const K& key)
+  {
+    return iterator(_lowerBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator lower_bound(const K& key) const
+  {
+    return const_iterator(_lowerBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator upper_bound(const K& key)
+  {
+    return iterator(_upperBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator upper_bound(const K& key) const
+  {
+    return const_iterator(_upperBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator ceiling(const K& key)
+  {
+    return iterator(_lowerBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator ceiling(const K& key) const
+  {
+    return const_iterator(_lowerBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator floor(const K& key)
+  {
+    return iterator(_floor(key, true));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator floor(const K& key) const
+  {
+    return const_iterator(_floor(key, true));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator successor(const K& key)
+  {
+    return iterator(_upperBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator successor(const K& key) const
+  {
+    return const_iterator(_upperBound(key));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  iterator predecessor(const K& key)
+  {
+    return iterator(_floor(key, false));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const_iterator predecessor(const K& key) const
+  {
+    return const_iterator(_floor(key, false));
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  ValueT& at(const K& key)
+  {
+    NODE* cur = _findNode(key);
+
+    if (cur == nullptr)
+      throw out_of_range("avlt::at: key not found");
+
+    return cur->Value;
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  const ValueT& at(const K& key) const
+  {
+    return const_cast<avlt*>(this)->at(key);
+  }
+
+  template<typename K, typename C = Compare, typename = typename C::is_transparent>
+  int rank(const K& key) const
+  {
+    static_assert(OrderStatistics, "rank() needs avlt<KeyT, ValueT, true>");
+
+    return _countBelow(key, false);
   }
 
   //
-  // insert
+  // key_comp
   //
-  // Inserts the given key into the tree; if the key has already been insert then
-  // the function returns without changing the tree.  Rotations are performed
-  // as necessary to keep the tree balanced according to AVL definition.
+  // Returns a copy of the comparator that orders the keys.
   //
-  // Time complexity:  O(lgN) worst-case
+  Compare key_comp() const
+  {
+    return Comp;
+  }
+
+  //
+  // _countBelow:
   //
-  void insert(KeyT key, ValueT value)
+  // Returns the # of keys < key, or <= key when inclusive, by adding up
+  // the subtree counts to the left of the search path.
+  //
+  template<typename K>
+  int _countBelow(const K& key, bool inclusive) const
   {
-    NODE* prev = nullptr;
+    int below = 0;
     NODE* cur = Root;
-    
-    //
-    // stack the nodes we visit so we can walk back up
-    // the search path later, adjusting heights:
-    //
-    stack<NODE*> nodes;
+    PROBE probe(Counters);
 
-    //
-    // 1. Search to see if tree already contains key, and push the nodes on to the stack
-    //
     while (cur != nullptr)
     {
-      if (key == cur->Key)  // the key is in current/root
-        return;
-        
-      nodes.push(cur);  // stack so we can return later:
-      
-      if (key < cur->Key)  // search left:
-      {
-        prev = cur;
+      probe.visit();
+      if (inclusive ? Comp(key, cur->Key) : !Comp(cur->Key, key))
         cur = cur->Left;
-      }
       else
       {
-        prev = cur;
-        if(cur->isThreaded) //if the right is threaded
-            cur = nullptr; //stop the transversal, meaning the thread is not there
-        else //not threaded, meaning there is a node to go to
-            cur = cur->Right;
+        below += 1 + _count(cur->Left);
+        cur = _getActualRight(cur);
       }
     }//while
-    
-    //
-    // 2. if we get here, key is not in tree, so allocate
-    // a new node to insert:
-    // 
-    
-    NODE* newNode = new NODE();
-    newNode->Key = key;
-    newNode->Value = value;
-    newNode->Height = 0;
-    newNode->Left = nullptr;
-    newNode->Right = nullptr;
-    newNode->isThreaded = true; //Mark all nodes as having a thread..
-    //
-    // 2.2 link in the new node:
-    //
-    // NOTE: cur is null, and prev denotes node where
-    // we fell out of the tree.  if prev is null, then
-    // the tree is empty and the Root pointer needs 
-    // to be updated.
-    //
 
-      if(prev == nullptr)
-      {
-         Root = newNode;  
-      } 
-      
-      //Whenever we add a new node, we only have to worry about the right node of the new node...
-      
-      else if(key < prev->Key) //When we are adding a left node, we only have to worry about the right node of the new node
-      {
-          prev->Left = newNode;//declare the new node
-          newNode->Right = prev; //make a thread to connect the right node of the new ptr to the parent node...
-         
-      }
-      else //When we are adding the right node, we only have to worry about the right node of the new node
-      {
-         newNode->Right = prev->Right; // prev->right is a thread pointing to its parent
-                                       //We connect the right pointer from the new node
-                                       //to the "old thread pointer" of its parent.
-         prev->isThreaded = false; //Mark the thread of the previous node to be non-existant now
-         prev->Right = newNode; //declare the new node..
-      }
-      
-      // #. Increment the size
-      Size++;
-      
-      while(!nodes.empty()){
-           // 4.a cur = top of stack
-           cur = nodes.top();
-           
-           nodes.pop();
-           
-           // 4.b compute new height of cur
-           int HL, HR, HC, BF;
-
-           HL = heightHelper(cur->Left);
-
-           HR = heightRight(cur);
-
-           HC = 1 + std::max(HL, HR);
-           
-           BF = HL - HR;
-           
-           // 4.c if height is same, exit loop
-           if(HC == cur->Height){
-               break;
-           }else{
-               cur->Height = HC;
-           }
-           NODE* parent  = nullptr;
-           if(!nodes.empty()){
-               parent = nodes.top();
-           }
-           
-           if(abs(BF) > 1){
-               if(HR > HL){
-                   int HRL, HRR;
-
-                   HRL = heightHelper(cur->Right->Left);
-                   
-                   HRR = heightRight(cur->Right);
-                   
-                   // right right case
-                   if(HRR > HRL){
-                       leftRotate(parent, cur);
-                   }
-                   else{
-                       rightRotate(cur, cur->Right);
-                       leftRotate(parent, cur);
-                   }
-               }
-               else{
-                   int HLL = -1, HLR = -1;
-
-                   HLL = heightHelper(cur->Left->Left);
-                   
-                   HLR = heightRight(cur->Left);
-                   
-                   //left left case
-                   if(HLL > HLR){
-                       rightRotate(parent, cur);
-                   }
-                   //left right case
-                   else{
-                       leftRotate(cur, cur->Left);
-                       rightRotate(parent, cur);
-                   }
-               }
-           }
-       }
+    return below;
   }
 
   //
-  // []
-  //
-  // Returns the value for the given key; if the key is not found,
-  // the default value ValueT{} is returned.
+  // _select:
   //
-  // Time complexity:  O(lgN) worst-case
+  // Returns the node holding the k-th smallest key (0-based), or
+  // nullptr if k is out of range.
   //
-  ValueT operator[](KeyT key) const
+  NODE* _select(int k) const
   {
-    NODE* prev = nullptr;
+    if (k < 0 || k >= Size)
+      return nullptr;
+
     NODE* cur = Root;
-    
-    while (cur != nullptr)
+    PROBE probe(Counters);
+
+    while (true)
     {
-      if (key == cur->Key)  // the key is in current/root
-        return cur->Value;
+      probe.visit();  // comparing k with the left count
+      int left = _count(cur->Left);
 
-      if (key < cur->Key)  // search left:
-      {
-        prev = cur;
+      if (k == left)
+        return cur;
+
+      if (k < left)
         cur = cur->Left;
-      }
       else
       {
-        prev = cur;
-        if(cur->isThreaded) //if the right is threaded
-            cur = nullptr; //stop the transversal, meaning the thread is not there
-        else //not threaded, meaning there is a node to go to
-            cur = cur->Right;
+        k -= left + 1;
+        cur = cur->Right;  // k is in range, so this is a real child
       }
     }//while
-    return ValueT{ };
   }
 
   //
-  // ()
+  // rank
   //
-  // Finds the key in the tree, and returns the key to the "right".
-  // If the right is threaded, this will be the next inorder key.
-  // if the right is not threaded, it will be the key of whatever
-  // node is immediately to the right.
+  // Returns the # of keys in the tree less than the given key, which is
+  // the key's 0-based position if it is in the tree.  Needs a tree with
+  // OrderStatistics, e.g. avlt<int, int, true>.
   //
-  // If no such key exists, or there is no key to the "right", the
-  // default key value KeyT{} is returned.
+  // Time complexity:  O(lgN) worst-case
+  //
+  int rank(const KeyT& key) const
+  {
+    static_assert(OrderStatistics, "rank() needs avlt<KeyT, ValueT, true>");
+
+    return _countBelow(key, false);
+  }
+
+  //
+  // select
+  //
+  // Returns an iterator to the k-th smallest key (0-based), or end() if
+  // k is not in [0, size()).  Needs a tree with OrderStatistics.
   //
   // Time complexity:  O(lgN) worst-case
   //
-  KeyT operator()(KeyT key) const
+  iterator select(int k)
   {
-    NODE* cur = Root;
-    
-    while (cur != nullptr)
-    {
-      if (key == cur->Key){  // the key is in current/root, i.e the key has been found...
-      
-          if(cur->isThreaded == true && cur->Right == nullptr){
-              return KeyT{ }; //no right key exists, then break and return the default value
-          }
-          else if(cur->isThreaded == true && cur->Right != nullptr){
-              cur = cur->Right; //transverse the thread to go to they key connected with the thread...
-              return cur->Key; //return the key at the threaded link
-          }
-          else if (cur->isThreaded == false){
-              cur = cur->Right;
-              return cur->Key; //if there is no thread then just return the key to the right of the required key 
-          }
-      }
+    static_assert(OrderStatistics, "select() needs avlt<KeyT, ValueT, true>");
 
-      if (key < cur->Key)  // search left:
-      {
-          cur = cur->Left;
-      }
-      else
-      {
-          if(cur->isThreaded) //if the right is threaded
-              cur = nullptr; //stop the transversal, meaning the thread is not there
-          else //not threaded, meaning there is a node to go to
-              cur = cur->Right;
-      }
-    }//while
+    return iterator(_select(k));
+  }
 
-    return KeyT{ };
+  const_iterator select(int k) const
+  {
+    static_assert(OrderStatistics, "select() needs avlt<KeyT, ValueT, true>");
+
+    return const_iterator(_select(k));
   }
 
   //
-  // %
-  //
-  // Returns the height stored in the node that contains key; if key is
-  // not found, -1 is returned.
+  // count_range
   //
-  // Example:  cout << tree%12345 << endl;
+  // Returns the # of keys in [lower..upper], inclusive, without visiting
+  // them.  Needs a tree with OrderStatistics.
   //
   // Time complexity:  O(lgN) worst-case
   //
-  int operator%(KeyT key) const
+  int count_range(const KeyT& lower, const KeyT& upper) const
   {
-    NODE* cur = Root;
+    static_assert(OrderStatistics, "count_range() needs avlt<KeyT, ValueT, true>");
 
-    while (cur != nullptr)
-    {
-      if (key == cur->Key){ // already in tree
-          return cur->Height;
-      }  
-        
-      if (key < cur->Key)  // search left:
-      {
-        cur = cur->Left;
-      }
-      else //searches right
-      {
-          if(cur->isThreaded){ //if the right is threaded
-              cur = nullptr; //declare the right as null ptr and stop the transversal
-          }else{ //if right is not threaded
-              cur = cur->Right;
-          }
-      }
-    }//while  
-  
-    // if get here, not found
-    return -1;
+    if (Comp(upper, lower))
+      return 0;
+
+    return _countBelow(upper, true) - _countBelow(lower, false);
   }
 
   //
-  // begin
+  // aggregate
   //
-  // Resets internal state for an inorder traversal.  After the 
-  // call to begin(), the internal state denotes the first inorder
-  // key; this ensure that first call to next() function returns
-  // the first inorder key.
+  // Returns the Aggregate policy's combine over the values of every key
+  // in [lower..upper], inclusive, in key order; the identity if there
+  // are none.  Only the two boundary paths below the node where the
+  // searches for lower and upper part ways are visited: every subtree
+  // hanging inside the range contributes its cached aggregate.  Needs a
+  // tree with an Aggregate, e.g. avlt<int, long, false, avlt_sum<long>>.
   //
-  // Space complexity: O(1)
   // Time complexity:  O(lgN) worst-case
   //
-  // Example usage:
-  //    tree.begin();
-  //    while (tree.next(key))
-  //      cout << key << endl;
-  //
-  void begin()
+  AGG aggregate(const KeyT& lower, const KeyT& upper) const
   {
-    NODE* cur = Root;
-     
-    if(cur == nullptr){ //check if the current node is null or not
-        ptr = cur; // copy the data of the cur node to the ptr node
-        return;
-    }
-    
-    while(cur->Left != NULL){
+    static_assert(AGGREGATED::value, "aggregate() needs an Aggregate policy");
+
+    //
+    // 1. find the highest node in the range:
+    //
+    NODE* split = Root;
+    PROBE probe(Counters);  // the three paths count as one lookup
+
+    while (split != nullptr)
+    {
+      probe.visit();
+      if (Comp(split->Key, lower))
+        split = _getActualRight(split);
+      else if (Comp(upper, split->Key))
+        split = split->Left;
+      else
+        break;
+    }//while
+
+    if (split == nullptr)
+      return Aggregate::identity();
+
+    //
+    // 2. left boundary: every node >= lower brings its right subtree,
+    // and comes before what we gathered above it:
+    //
+    AGG left = Aggregate::identity();
+
+    for (NODE* cur = split->Left; cur != nullptr; )
+    {
+      probe.visit();
+      if (Comp(cur->Key, lower))
+        cur = _getActualRight(cur);
+      else
+      {
+        left = Aggregate::combine(
+                 Aggregate::combine(Aggregate::lift(cur->Value), _agg(_getActualRight(cur))),
+                 left);
         cur = cur->Left;
-    }
-    
-    ptr = cur; //copy the data of the cur node to the ptr node
+      }
+    }//for
+
+    //
+    // 3. right boundary: every node <= upper brings its left subtree,
+    // and comes after what we gathered above it:
+    //
+    AGG right = Aggregate::identity();
+
+    for (NODE* cur = _getActualRight(split); cur != nullptr; )
+    {
+      probe.visit();
+      if (Comp(upper, cur->Key))
+        cur = cur->Left;
+      else
+      {
+        right = Aggregate::combine(right,
+                  Aggregate::combine(_agg(cur->Left), Aggregate::lift(cur->Value)));
+        cur = _getActualRight(cur);
+      }
+    }//for
+
+    return Aggregate::combine(Aggregate::combine(left, Aggregate::lift(split->Value)), right);
   }
 
   //
@@ -751,6 +4293,10 @@ public:
     }else{
     
         key = cur->Key; //return the key
+        Counters.add(AVLT_NEXTS);
+        if(cur->isThreaded){
+            Counters.add(AVLT_THREAD_HOPS);
+        }
         
         //Increment the pointer to the next inorder key
         if(cur->Left == NULL && cur->isThreaded == true){
@@ -780,6 +4326,261 @@ public:
     return false;
   }
   
+  //
+  // freeze
+  //
+  // Returns an immutable snapshot of the tree laid out in one contiguous
+  // array, for data that is built once and then only queried.  The
+  // snapshot supports search, [], () and range scans with the same
+  // contracts as here, and does not change when this tree does.  The
+  // snapshot orders its keys by <, so the tree must have the default
+  // order.  See frozen_avlt.h.
+  //
+  // Time complexity:  O(N)
+  //
+  frozen_avlt<KeyT, ValueT> freeze() const
+  {
+    static_assert(LESS_ORDERED::value,
+                  "freeze() needs a tree ordered by <, as frozen_avlt is");
+
+    const_iterator it = begin();
+
+    return frozen_avlt<KeyT, ValueT>((size_t) Size, [&it](KeyT& key, ValueT& value)
+    {
+      key = it.key();
+      value = it.value();
+      ++it;
+    });
+  }
+
+  //
+  // _saveSection:
+  //
+  // Pads the file out to byte offset "at", then writes the array.
+  //
+  template<typename T>
+  static bool _saveSection(ostream& out, uint64_t at, const vector<T>& items)
+  {
+    for (uint64_t pos = (uint64_t) out.tellp(); pos < at; ++pos)
+      out.put('\0');
+
+    out.write(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(T));
+
+    return (bool) out;
+  }
+
+  //
+  // save
+  //
+  // Writes the tree to a binary snapshot file (see avlt_file.h): the
+  // keys in order, their values, and each node's height.  Needs
+  // trivially copyable keys and values, and the default order, since
+  // the format (and mapped_avlt) assume keys sorted by <.  Returns true
+  // on success.
+  //
+  // Time complexity:  O(N)
+  //
+  bool save(const string& path) const
+  {
+    static_assert(is_trivially_copyable<KeyT>::value && is_trivially_copyable<ValueT>::value,
+                  "save() needs trivially copyable keys and values");
+    static_assert(LESS_ORDERED::value,
+                  "save() needs a tree ordered by <, as the snapshot format is");
+
+    avlt_file_header header = avlt_file_make_header<KeyT, ValueT>((uint64_t) Size);
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out)
+      return false;
+
+    //
+    // one inorder walk gathers all three sections, since visiting the
+    // nodes is what costs:
+    //
+    vector<KeyT>    keys;
+    vector<ValueT>  values;
+    vector<uint8_t> heights;
+
+    keys.reserve(Size);
+    values.reserve(Size);
+    heights.reserve(Size);
+
+    for (NODE* cur = _leftmost(Root); cur != nullptr; cur = _successor(cur))
+    {
+      keys.push_back(cur->Key);
+      values.push_back(cur->Value);
+      heights.push_back((uint8_t) cur->Height);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    return _saveSection(out, header.KeysAt, keys) &&
+           _saveSection(out, header.ValuesAt, values) &&
+           _saveSection(out, header.HeightsAt, heights) &&
+           (bool) out.flush();
+  }
+
+  //
+  // _checkLoaded:
+  //
+  // Verifies that the subtree rooted at cur is a valid AVL tree whose
+  // stored heights are right, and brings its counts / aggregates up to
+  // date on the way back up.  Returns the subtree's height, or -2 if it
+  // is not valid; "depth" stops a corrupt file from recursing deeply.
+  //
+  int _checkLoaded(NODE* cur, int depth)
+  {
+    if (cur == nullptr)
+      return -1;
+    if (depth >= MAX_HEIGHT)
+      return -2;
+
+    int HL = _checkLoaded(cur->Left, depth + 1);
+    int HR = _checkLoaded(_getActualRight(cur), depth + 1);
+
+    if (HL == -2 || HR == -2 || abs(HL - HR) > 1 || cur->Height != 1 + max(HL, HR))
+      return -2;
+
+    _update(cur);
+
+    return cur->Height;
+  }
+
+  //
+  // _assignLoaded:
+  //
+  // Makes this empty tree hold the n keys / values of a snapshot, in
+  // exactly the shape the heights describe, with no rotations.  Nodes
+  // are linked with one left-to-right pass: the stack holds the right
+  // spine of what is built so far, and each new node adopts the part of
+  // the spine lower than itself as its left subtree.  Returns false,
+  // leaving the tree empty, if the snapshot is not a valid AVL tree.
+  //
+  // Time complexity:  O(N)
+  //
+  bool _assignLoaded(const KeyT* keys, const ValueT* values, const uint8_t* heights, size_t n)
+  {
+    if (n == 0)
+      return true;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (heights[i] >= MAX_HEIGHT)
+        return false;
+      if (i > 0 && !Comp(keys[i - 1], keys[i]))
+        return false;
+    }
+
+    NODE* block = Pool.allocateBlock(n);
+    Counters.add(AVLT_ALLOCATIONS, n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      new (&block[i]) NODE(keys[i], values[i]);
+      block[i].Height = heights[i];
+    }
+
+    //
+    // heights strictly decrease up the stack, so it never holds more
+    // than MAX_HEIGHT nodes:
+    //
+    NODE* spine[MAX_HEIGHT];
+    int top = 0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      NODE* cur = &block[i];
+      NODE* below = nullptr;
+
+      while (top > 0 && spine[top - 1]->Height <= cur->Height)
+        below = spine[--top];
+
+      cur->Left = below;
+
+      if (top > 0)
+      {
+        spine[top - 1]->Right = cur;
+        spine[top - 1]->isThreaded = false;
+      }
+
+      spine[top++] = cur;
+    }//for
+
+    for (size_t i = 0; i < n; ++i)  // the rest of the Rights are threads
+      if (block[i].isThreaded)
+        block[i].Right = (i + 1 < n) ? &block[i + 1] : nullptr;
+
+    if (_checkLoaded(spine[0], 0) == -2)
+    {
+      for (size_t i = 0; i < n; ++i)
+        block[i].~NODE();
+
+      Pool.releaseAll();
+      return false;
+    }
+
+    Root = spine[0];
+    Size = (int) n;
+
+    return true;
+  }
+
+  //
+  // load
+  //
+  // Replaces the contents of the tree with a snapshot written by save().
+  // The tree comes back in exactly the shape it was saved in, rebuilt in
+  // one pass with no rotations.  Returns false, leaving the tree as it
+  // was, if the file cannot be read, was written for other key / value
+  // types, or does not hold a valid tree.
+  //
+  // Time complexity:  O(N)
+  //
+  bool load(const string& path)
+  {
+    static_assert(is_trivially_copyable<KeyT>::value && is_trivially_copyable<ValueT>::value,
+                  "load() needs trivially copyable keys and values");
+    static_assert(LESS_ORDERED::value,
+                  "load() needs a tree ordered by <, as the snapshot format is");
+
+    ifstream in(path, ios::binary);
+    if (!in)
+      return false;
+
+    in.seekg(0, ios::end);
+    uint64_t fileBytes = (uint64_t) in.tellg();
+    in.seekg(0, ios::beg);
+
+    avlt_file_header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !avlt_file_check<KeyT, ValueT>(header, fileBytes) ||
+        header.Count > (uint64_t) numeric_limits<int>::max())
+      return false;
+
+    size_t n = (size_t) header.Count;
+
+    vector<KeyT>    keys(n);
+    vector<ValueT>  values(n);
+    vector<uint8_t> heights(n);
+
+    in.seekg((streamoff) header.KeysAt);
+    in.read(reinterpret_cast<char*>(keys.data()), n * sizeof(KeyT));
+    in.seekg((streamoff) header.ValuesAt);
+    in.read(reinterpret_cast<char*>(values.data()), n * sizeof(ValueT));
+    in.seekg((streamoff) header.HeightsAt);
+    in.read(reinterpret_cast<char*>(heights.data()), n);
+
+    if (!in)
+      return false;
+
+    avlt loaded(Comp);
+    if (!loaded._assignLoaded(keys.data(), values.data(), heights.data(), n))
+      return false;
+
+    swap(loaded);
+    return true;
+  }
+
   //
   // printInOrder:
   //
@@ -796,12 +4597,11 @@ public:
           
           if(cur->isThreaded == true && cur->Right != nullptr){
               output <<"(" << cur->Key << "," << cur->Value << "," << cur->Height << "," << cur->Right->Key  << ")" << endl;
-              cur->Right = NULL;
           }else{
               output <<"(" << cur->Key << "," << cur->Value << "," << cur->Height << ")" << endl;
           }
           
-          printInOrder(cur->Right, output);
+          printInOrder(_getActualRight(cur), output);
       }
    }
 
@@ -0,0 +1,99 @@
+/*avlt_file.h*/
+
+//
+// Binary snapshot format shared by avlt::save / avlt::load and
+// mapped_avlt.
+//
+// A snapshot holds the keys of a tree in order, their values, and the
+// height of every node, each as a flat array starting on a 64-byte
+// boundary:
+//
+//   header | keys[N] | values[N] | heights[N] (one byte each)
+//
+// The keys and heights together pin down the exact shape of the tree
+// (in any subtree, the root is the node with the largest height), so a
+// load rebuilds it in O(N) with no rotations, and the sorted keys can
+// be searched straight from a mapping of the file.  Numbers are stored
+// in the writer's byte order; a reader with a different one, or with
+// keys and values of a different size, rejects the file.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+static const char     AVLT_FILE_MAGIC[8] = { 'A', 'V', 'L', 'T', 'S', 'N', 'A', 'P' };
+static const uint32_t AVLT_FILE_VERSION = 1;
+static const uint32_t AVLT_FILE_BYTE_ORDER = 0x01020304;
+static const uint64_t AVLT_FILE_ALIGN = 64;
+
+struct avlt_file_header
+{
+  char     Magic[8];    // AVLT_FILE_MAGIC
+  uint32_t Version;     // AVLT_FILE_VERSION
+  uint32_t ByteOrder;   // AVLT_FILE_BYTE_ORDER, as the writer stores it
+  uint32_t KeyBytes;    // sizeof(KeyT)
+  uint32_t ValueBytes;  // sizeof(ValueT)
+  uint64_t Count;       // # of keys
+  uint64_t KeysAt;      // byte offsets of the three arrays
+  uint64_t ValuesAt;
+  uint64_t HeightsAt;
+};
+
+//
+// avlt_file_align: rounds a byte offset up to the next section boundary.
+//
+inline uint64_t avlt_file_align(uint64_t offset)
+{
+  return (offset + AVLT_FILE_ALIGN - 1) / AVLT_FILE_ALIGN * AVLT_FILE_ALIGN;
+}
+
+//
+// avlt_file_make_header: lays out a snapshot of "count" keys.
+//
+template<typename KeyT, typename ValueT>
+avlt_file_header avlt_file_make_header(uint64_t count)
+{
+  avlt_file_header header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.Magic, AVLT_FILE_MAGIC, sizeof(header.Magic));
+  header.Version = AVLT_FILE_VERSION;
+  header.ByteOrder = AVLT_FILE_BYTE_ORDER;
+  header.KeyBytes = sizeof(KeyT);
+  header.ValueBytes = sizeof(ValueT);
+  header.Count = count;
+  header.KeysAt = avlt_file_align(sizeof(header));
+  header.ValuesAt = avlt_file_align(header.KeysAt + count * sizeof(KeyT));
+  header.HeightsAt = avlt_file_align(header.ValuesAt + count * sizeof(ValueT));
+
+  return header;
+}
+
+//
+// avlt_file_check: returns true if "header" describes a snapshot of
+// KeyT / ValueT that fits in a file of "fileBytes" bytes.
+//
+template<typename KeyT, typename ValueT>
+bool avlt_file_check(const avlt_file_header& header, uint64_t fileBytes)
+{
+  if (memcmp(header.Magic, AVLT_FILE_MAGIC, sizeof(header.Magic)) != 0 ||
+      header.Version != AVLT_FILE_VERSION ||
+      header.ByteOrder != AVLT_FILE_BYTE_ORDER ||
+      header.KeyBytes != sizeof(KeyT) ||
+      header.ValueBytes != sizeof(ValueT))
+    return false;
+
+  if (header.Count > fileBytes)  // also keeps the products below in range
+    return false;
+
+  avlt_file_header expected = avlt_file_make_header<KeyT, ValueT>(header.Count);
+
+  return header.KeysAt == expected.KeysAt &&
+         header.ValuesAt == expected.ValuesAt &&
+         header.HeightsAt == expected.HeightsAt &&
+         header.HeightsAt + header.Count <= fileBytes;
+}
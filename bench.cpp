@@ -0,0 +1,697 @@
+/*bench.cpp*/
+
+//
+// Benchmarks for the threaded AVL tree, side by side with std::map and
+// std::set, so that regressions in insert, search, range_search and
+// begin()/next() show up as numbers.
+//
+// Usage:  bench.exe [--min N] [--max N] [--workload NAME]
+//
+// Sizes go up by powers of 10 from --min (default 10^3) to --max
+// (default 10^6; 10^8 needs tens of GB).  Workloads:
+//
+//   sequential   keys 0, 1, 2, ... inserted and searched in order
+//   random       random 64-bit keys, inserted and searched in random order
+//   zipf         random keys, searched with a Zipf(0.99) skew (YCSB's)
+//   string       YCSB-style "user..." string keys, in random order
+//   bulk         avlt only: random batches of N/1000, N/100, N/10 and
+//                N new keys into a tree of N, by insert_bulk and by an
+//                insert loop (workloads "bulk-1/1000" ... "bulk-1/1");
+//                where the two cross is what insert_bulk's cutover
+//                between them is tuned from
+//
+// Output is a JSON array on stdout, one result object per line, each
+// line after the first starting with ", " (shown wrapped here):
+//
+//   [
+//     { "structure": "avlt", "workload": "random", "size": 1000000,
+//       "op": "insert", "ops": 1000000, "ns_per_op": 530.8,
+//       "cache_misses_per_op": 4.7, "bytes_per_entry": 40.0 }
+//   , { "structure": "avlt", "workload": "random", "size": 1000000,
+//       "op": "search", "ops": 1000000, "ns_per_op": 412.3,
+//       "cache_misses_per_op": 3.1, "bytes_per_entry": 40.0 }
+//   ]
+//
+// cache_misses_per_op comes from the hardware counters through
+// perf_event_open, and is null where they aren't available (most VMs
+// and containers, or perf_event_paranoid > 2).  bytes_per_entry is
+// the heap in use after building the structure, per entry (for the
+// bulk rows, the tree with the batch in it), and null off glibc.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+#include <malloc.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "avlt.h"
+
+using namespace std;
+
+
+//
+// CacheMisses:
+//
+// Hardware cache-miss counter for this thread, or nothing at all if
+// the kernel won't give us one.
+//
+class CacheMisses
+{
+private:
+  int Fd;
+
+public:
+  CacheMisses()
+    : Fd(-1)
+  {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    Fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+
+  CacheMisses(const CacheMisses&) = delete;
+  CacheMisses& operator=(const CacheMisses&) = delete;
+
+  ~CacheMisses()
+  {
+    if (Fd >= 0)
+      close(Fd);
+  }
+
+  bool available() const
+  {
+    return Fd >= 0;
+  }
+
+  void start()
+  {
+#if defined(__linux__)
+    if (Fd >= 0)
+    {
+      ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  long long stop()
+  {
+    long long count = 0;
+
+#if defined(__linux__)
+    if (Fd >= 0)
+    {
+      ioctl(Fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(Fd, &count, sizeof(count)) != (ssize_t) sizeof(count))
+        count = 0;
+    }
+#endif
+
+    return count;
+  }
+};
+
+//
+// heapInUse: bytes of heap currently allocated, or -1 if unknown.
+//
+static long long heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  return (long long) (info.uordblks + info.hblkhd);
+#else
+  return -1;
+#endif
+}
+
+//
+// Zipf:
+//
+// Ranks 0..N-1 drawn with probability proportional to 1/(rank+1)^theta,
+// by the method of Gray et al. that YCSB uses: O(N) setup, O(1) a draw.
+//
+class Zipf
+{
+private:
+  size_t N;
+  double Theta, Alpha, Zetan, Eta;
+
+  static double _zeta(size_t n, double theta)
+  {
+    double sum = 0;
+    for (size_t i = 1; i <= n; ++i)
+      sum += 1.0 / pow((double) i, theta);
+    return sum;
+  }
+
+public:
+  Zipf(size_t n, double theta)
+    : N(n), Theta(theta)
+  {
+    double zeta2 = _zeta(2, theta);
+
+    Alpha = 1.0 / (1.0 - theta);
+    Zetan = _zeta(n, theta);
+    Eta = (1.0 - pow(2.0 / (double) n, 1.0 - theta)) / (1.0 - zeta2 / Zetan);
+  }
+
+  template<typename Rng>
+  size_t operator()(Rng& rng)
+  {
+    double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+    double uz = u * Zetan;
+
+    if (uz < 1.0)
+      return 0;
+    if (uz < 1.0 + pow(0.5, Theta))
+      return 1;
+
+    size_t rank = (size_t) ((double) N * pow(Eta * u - Eta + 1.0, Alpha));
+    return rank < N ? rank : N - 1;
+  }
+};
+
+
+//
+// The structures under test, behind one small interface.  Keys are
+// copied out by iterate() in all three, as begin()/next() does, and
+// folded into a checksum so the copies can't be optimized away.
+//
+static uint64_t fold(uint64_t key) { return key; }
+static uint64_t fold(const string& key) { return key.size(); }
+
+template<typename KeyT>
+struct AvltUnderTest
+{
+  avlt<KeyT, uint64_t> Tree;
+
+  static const char* name() { return "avlt"; }
+
+  void insert(const KeyT& key, uint64_t value)
+  {
+    Tree.insert(key, value);
+  }
+
+  bool search(const KeyT& key, uint64_t& value)
+  {
+    return Tree.search(key, value);
+  }
+
+  size_t range(const KeyT& lower, const KeyT& upper, vector<KeyT>& keys)
+  {
+    keys.clear();
+    Tree.range_search(lower, upper, back_inserter(keys));
+    return keys.size();
+  }
+
+  uint64_t iterate()
+  {
+    KeyT key;
+    uint64_t sum = 0;
+
+    Tree.begin();
+    while (Tree.next(key))
+      sum += fold(key);
+
+    return sum;
+  }
+};
+
+template<typename KeyT>
+struct MapUnderTest
+{
+  map<KeyT, uint64_t> Tree;
+
+  static const char* name() { return "std::map"; }
+
+  void insert(const KeyT& key, uint64_t value)
+  {
+    Tree.insert(make_pair(key, value));
+  }
+
+  bool search(const KeyT& key, uint64_t& value)
+  {
+    auto it = Tree.find(key);
+    if (it == Tree.end())
+      return false;
+
+    value = it->second;
+    return true;
+  }
+
+  size_t range(const KeyT& lower, const KeyT& upper, vector<KeyT>& keys)
+  {
+    keys.clear();
+    for (auto it = Tree.lower_bound(lower); it != Tree.end() && !(upper < it->first); ++it)
+      keys.push_back(it->first);
+    return keys.size();
+  }
+
+  uint64_t iterate()
+  {
+    KeyT key;
+    uint64_t sum = 0;
+
+    for (auto it = Tree.begin(); it != Tree.end(); ++it)
+    {
+      key = it->first;
+      sum += fold(key);
+    }
+
+    return sum;
+  }
+};
+
+template<typename KeyT>
+struct SetUnderTest
+{
+  set<KeyT> Tree;
+
+  static const char* name() { return "std::set"; }
+
+  void insert(const KeyT& key, uint64_t)
+  {
+    Tree.insert(key);
+  }
+
+  bool search(const KeyT& key, uint64_t& value)
+  {
+    value = 1;  // there is no value; count the hit
+    return Tree.find(key) != Tree.end();
+  }
+
+  size_t range(const KeyT& lower, const KeyT& upper, vector<KeyT>& keys)
+  {
+    keys.clear();
+    for (auto it = Tree.lower_bound(lower); it != Tree.end() && !(upper < *it); ++it)
+      keys.push_back(*it);
+    return keys.size();
+  }
+
+  uint64_t iterate()
+  {
+    KeyT key;
+    uint64_t sum = 0;
+
+    for (auto it = Tree.begin(); it != Tree.end(); ++it)
+    {
+      key = *it;
+      sum += fold(key);
+    }
+
+    return sum;
+  }
+};
+
+
+//
+// a workload: the keys in the order they are inserted, the order they
+// are searched for, and the sorted keys (for range bounds).
+//
+template<typename KeyT>
+struct Workload
+{
+  string Name;
+  vector<KeyT> Inserts;
+  vector<KeyT> Searches;
+  vector<KeyT> Sorted;
+};
+
+static const size_t MIN_OPS = 1000000;  // small sizes repeat up to this
+static const size_t RANGE_WIDTH = 100;  // keys per range_search
+
+static volatile uint64_t Sink;  // keeps the work from being optimized away
+
+static bool First = true;
+
+static void report(const char* structure, const string& workload, size_t size,
+                   const char* op, size_t ops, double ns, long long misses,
+                   bool haveMisses, double bytesPerEntry)
+{
+  printf("%s{ \"structure\": \"%s\", \"workload\": \"%s\", \"size\": %zu, "
+         "\"op\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.1f, ",
+         First ? "  " : ", ", structure, workload.c_str(), size, op, ops, ns / (double) ops);
+
+  if (haveMisses)
+    printf("\"cache_misses_per_op\": %.2f, ", (double) misses / (double) ops);
+  else
+    printf("\"cache_misses_per_op\": null, ");
+
+  if (bytesPerEntry >= 0)
+    printf("\"bytes_per_entry\": %.1f }\n", bytesPerEntry);
+  else
+    printf("\"bytes_per_entry\": null }\n");
+
+  fflush(stdout);
+  First = false;
+}
+
+//
+// measure: runs work() once, returning the nanoseconds it took and the
+// cache misses it caused.
+//
+template<typename Work>
+static double measure(CacheMisses& counter, long long& misses, Work work)
+{
+  counter.start();
+  auto start = chrono::steady_clock::now();
+
+  work();
+
+  auto stop = chrono::steady_clock::now();
+  misses = counter.stop();
+
+  return chrono::duration<double, nano>(stop - start).count();
+}
+
+template<typename Structure, typename KeyT>
+static void run(const Workload<KeyT>& load, CacheMisses& counter)
+{
+  size_t n = load.Inserts.size();
+  size_t reps = max((size_t) 1, MIN_OPS / n);
+  long long misses;
+  uint64_t check = 0;
+
+  //
+  // insert: reps structures built one after the other, torn down
+  // after the clock stops; the first one's heap is its footprint.
+  //
+  vector<unique_ptr<Structure>> built;
+  for (size_t r = 0; r < reps; ++r)
+    built.emplace_back(new Structure());
+
+  long long heapBefore = heapInUse();
+
+  double ns = measure(counter, misses, [&]()
+  {
+    for (size_t r = 0; r < reps; ++r)
+      for (size_t i = 0; i < n; ++i)
+        built[r]->insert(load.Inserts[i], i);
+  });
+
+  long long heapAfter = heapInUse();
+  double bytesPerEntry = (heapBefore < 0 || heapAfter < 0) ? -1.0
+                         : (double) (heapAfter - heapBefore) / (double) (n * reps);
+
+  report(Structure::name(), load.Name, n, "insert", n * reps, ns, misses,
+         counter.available(), bytesPerEntry);
+
+  built.resize(1);
+  Structure& s = *built[0];
+
+  //
+  // search: every search key, over and over up to MIN_OPS
+  //
+  size_t searches = max(load.Searches.size(), MIN_OPS);
+
+  ns = measure(counter, misses, [&]()
+  {
+    uint64_t value;
+    for (size_t i = 0, j = 0; i < searches; ++i, ++j)
+    {
+      if (j == load.Searches.size())
+        j = 0;
+      if (s.search(load.Searches[j], value))
+        check += value;
+    }
+  });
+
+  report(Structure::name(), load.Name, n, "search", searches, ns, misses,
+         counter.available(), bytesPerEntry);
+
+  //
+  // range_search: RANGE_WIDTH keys at a time, starting at random keys
+  //
+  size_t ranges = max((size_t) 1, MIN_OPS / RANGE_WIDTH);
+  vector<size_t> starts;
+  mt19937_64 rng(n);
+
+  for (size_t i = 0; i < ranges; ++i)
+    starts.push_back(rng() % n);
+
+  vector<KeyT> keys;
+  keys.reserve(RANGE_WIDTH);
+
+  ns = measure(counter, misses, [&]()
+  {
+    for (size_t start : starts)
+    {
+      size_t end = min(start + RANGE_WIDTH - 1, n - 1);
+      check += s.range(load.Sorted[start], load.Sorted[end], keys);
+    }
+  });
+
+  report(Structure::name(), load.Name, n, "range_search", ranges, ns, misses,
+         counter.available(), bytesPerEntry);
+
+  //
+  // iterate: whole inorder walks, reported per key visited
+  //
+  ns = measure(counter, misses, [&]()
+  {
+    for (size_t r = 0; r < reps; ++r)
+      check += s.iterate();
+  });
+
+  report(Structure::name(), load.Name, n, "iterate", n * reps, ns, misses,
+         counter.available(), bytesPerEntry);
+
+  Sink = check;
+}
+
+//
+// runBulk: batches of n / fraction new random keys into a tree of n
+// random keys, inserted with insert_bulk and with an insert loop, each
+// into its own copy of the tree; reported per key in the batch.
+//
+static void runBulk(size_t n, CacheMisses& counter)
+{
+  mt19937_64 rng(n);
+  vector<pair<uint64_t, uint64_t>> keys;
+
+  for (size_t i = 0; i < n; ++i)
+    keys.push_back(make_pair(rng() | 1, i));  // odd keys in the tree,
+  sort(keys.begin(), keys.end());
+
+  avlt<uint64_t, uint64_t> base(keys.begin(), keys.end());
+
+  for (size_t fraction : { 1000, 100, 10, 1 })
+  {
+    size_t k = max((size_t) 1, n / fraction);
+    size_t reps = max((size_t) 1, MIN_OPS / (n + k));
+    long long misses;
+
+    vector<pair<uint64_t, uint64_t>> batch;
+    for (size_t i = 0; i < k; ++i)
+      batch.push_back(make_pair(rng() & ~(uint64_t) 1, i));  // even ones in the batch
+
+    string name = "bulk-1/" + to_string(fraction);
+    double bulkNs = 0, loopNs = 0;
+    long long bulkMisses = 0, loopMisses = 0;
+    double bulkBytes = -1.0, loopBytes = -1.0;
+
+    //
+    // the first rep's heap growth, copy included, is the footprint of
+    // the tree with the batch in it:
+    //
+    auto perEntry = [](long long before, long long after, int entries)
+    {
+      return (before < 0 || after < 0) ? -1.0 : (double) (after - before) / (double) entries;
+    };
+
+    for (size_t r = 0; r < reps; ++r)
+    {
+      long long heapBefore = heapInUse();
+
+      avlt<uint64_t, uint64_t> bulk(base);
+
+      bulkNs += measure(counter, misses, [&]()
+      {
+        bulk.insert_bulk(batch.begin(), batch.end());
+      });
+      bulkMisses += misses;
+
+      long long heapBetween = heapInUse();
+
+      avlt<uint64_t, uint64_t> loop(base);
+
+      loopNs += measure(counter, misses, [&]()
+      {
+        for (auto& p : batch)
+          loop.insert(p.first, p.second);
+      });
+      loopMisses += misses;
+
+      long long heapAfter = heapInUse();
+
+      if (r == 0)
+      {
+        bulkBytes = perEntry(heapBefore, heapBetween, bulk.size());
+        loopBytes = perEntry(heapBetween, heapAfter, loop.size());
+      }
+
+      Sink = bulk.size() + loop.size();
+    }
+
+    report("avlt", name, n, "insert_bulk", k * reps, bulkNs, bulkMisses,
+           counter.available(), bulkBytes);
+    report("avlt", name, n, "insert", k * reps, loopNs, loopMisses,
+           counter.available(), loopBytes);
+  }
+}
+
+template<typename KeyT>
+static void runAll(const Workload<KeyT>& load, CacheMisses& counter)
+{
+  run<AvltUnderTest<KeyT>>(load, counter);
+  run<MapUnderTest<KeyT>>(load, counter);
+  run<SetUnderTest<KeyT>>(load, counter);
+}
+
+
+//
+// the workloads:
+//
+static Workload<uint64_t> sequential(size_t n)
+{
+  Workload<uint64_t> load;
+  load.Name = "sequential";
+
+  for (size_t i = 0; i < n; ++i)
+    load.Inserts.push_back(i);
+
+  load.Searches = load.Inserts;
+  load.Sorted = load.Inserts;
+  return load;
+}
+
+static Workload<uint64_t> randomKeys(size_t n, const string& name)
+{
+  Workload<uint64_t> load;
+  load.Name = name;
+
+  mt19937_64 rng(n);
+  for (size_t i = 0; i < n; ++i)
+    load.Inserts.push_back(rng());
+
+  load.Sorted = load.Inserts;
+  sort(load.Sorted.begin(), load.Sorted.end());
+
+  load.Searches = load.Inserts;
+  shuffle(load.Searches.begin(), load.Searches.end(), rng);
+  return load;
+}
+
+static Workload<uint64_t> zipf(size_t n)
+{
+  Workload<uint64_t> load = randomKeys(n, "zipf");
+
+  //
+  // hot ranks map to keys spread across the tree, not to its smallest
+  // keys, since the insert order is already random:
+  //
+  Zipf draw(n, 0.99);
+  mt19937_64 rng(n + 1);
+
+  for (size_t i = 0; i < n; ++i)
+    load.Searches[i] = load.Inserts[draw(rng)];
+
+  return load;
+}
+
+static Workload<string> strings(size_t n)
+{
+  Workload<string> load;
+  load.Name = "string";
+
+  mt19937_64 rng(n);
+  char key[32];
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    snprintf(key, sizeof(key), "user%019llu", (unsigned long long) (rng() >> 1));
+    load.Inserts.push_back(key);
+  }
+
+  load.Sorted = load.Inserts;
+  sort(load.Sorted.begin(), load.Sorted.end());
+
+  load.Searches = load.Inserts;
+  shuffle(load.Searches.begin(), load.Searches.end(), rng);
+  return load;
+}
+
+
+int main(int argc, char* argv[])
+{
+  size_t minSize = 1000, maxSize = 1000000;
+  string only;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    string option = argv[i];
+
+    if (option == "--min")
+      minSize = (size_t) atof(argv[i + 1]);
+    else if (option == "--max")
+      maxSize = (size_t) atof(argv[i + 1]);
+    else if (option == "--workload")
+      only = argv[i + 1];
+    else
+    {
+      cerr << "usage: " << argv[0] << " [--min N] [--max N] [--workload NAME]" << endl;
+      return 1;
+    }
+  }
+
+  CacheMisses counter;
+
+  printf("[\n");
+
+  for (size_t n = max(minSize, (size_t) 1); n <= maxSize; n *= 10)
+  {
+    if (only.empty() || only == "sequential")
+      runAll(sequential(n), counter);
+    if (only.empty() || only == "random")
+      runAll(randomKeys(n, "random"), counter);
+    if (only.empty() || only == "zipf")
+      runAll(zipf(n), counter);
+    if (only.empty() || only == "string")
+      runAll(strings(n), counter);
+    if (only.empty() || only == "bulk")
+      runBulk(n, counter);
+  }
+
+  printf("]\n");
+  return 0;
+}
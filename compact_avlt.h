@@ -0,0 +1,970 @@
+/*compact_avlt.h*/
+
+//
+// Threaded AVL tree with a compact, index-based node layout.
+//
+// The core of avlt's interface, with the same behavior, for workloads
+// that store hundreds of millions of small entries: search, insert,
+// erase, erase_range / erase_batch, assign_sorted, range_search /
+// range_for_each, [] / () / %, begin / next, the forward iterators with
+// find and lower_bound, and dump.  The later additions to avlt (order
+// statistics, aggregates, set operations, split / concat, bulk inserts,
+// save / load, comparators, stats) are not here.
+//
+// Instead of two 8-byte pointers, a bool and an int per node:
+//
+//   - nodes live in one contiguous array and refer to each other by
+//     32-bit index,
+//   - the thread flag is folded into the top bit of the Right index,
+//   - the height is packed into one byte (an AVL tree of 2^31 nodes is
+//     less than 45 levels high).
+//
+// For avlt<int, int> that is 20 bytes per node instead of 32; see
+// node_bytes() in both classes.  The price is a limit of 2^31 - 1 nodes;
+// an insert past it throws length_error and leaves the tree as it was.
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <stdexcept>
+#include <cstdint>
+
+using namespace std;
+
+template<typename KeyT, typename ValueT>
+class compact_avlt
+{
+private:
+  struct NODE
+  {
+    KeyT     Key;
+    ValueT   Value;
+    uint32_t Left;    // index of left child, or NIL
+    uint32_t Right;   // index of right child or thread, THREAD bit set => thread
+    uint8_t  Height;  // height of tree rooted at this node
+  };
+
+  static const uint32_t NIL = 0x7FFFFFFF;     // "nullptr"
+  static const uint32_t THREAD = 0x80000000;  // flag bit in Right
+  static const int MAX_HEIGHT = 64;
+
+  vector<NODE> Nodes;     // every node, live or free
+  uint32_t     Root;      // index of root node (NIL if empty)
+  int          Size;      // # of live nodes in the tree
+  uint32_t     FreeHead;  // erased nodes, linked through Left
+  uint32_t     ptr;       // cursor for begin() / next()
+
+  //
+  // helpers to read and write the packed Right field:
+  //
+  bool _isThreaded(uint32_t cur) const
+  {
+    return (Nodes[cur].Right & THREAD) != 0;
+  }
+
+  uint32_t _rightLink(uint32_t cur) const  // thread or child, NIL if none
+  {
+    return Nodes[cur].Right & ~THREAD;
+  }
+
+  uint32_t _getActualRight(uint32_t cur) const  // NIL if threaded
+  {
+    return _isThreaded(cur) ? NIL : Nodes[cur].Right;
+  }
+
+  void _setRight(uint32_t cur, uint32_t link, bool threaded)
+  {
+    Nodes[cur].Right = link | (threaded ? THREAD : 0);
+  }
+
+  int _height(uint32_t cur) const
+  {
+    return (cur == NIL) ? -1 : Nodes[cur].Height;
+  }
+
+  void _fixHeight(uint32_t cur)
+  {
+    Nodes[cur].Height = (uint8_t) (1 + max(_height(Nodes[cur].Left), _height(_getActualRight(cur))));
+  }
+
+  uint32_t _successor(uint32_t cur) const
+  {
+    if (_isThreaded(cur))
+      return _rightLink(cur);
+
+    cur = Nodes[cur].Right;
+    while (Nodes[cur].Left != NIL)
+      cur = Nodes[cur].Left;
+
+    return cur;
+  }
+
+  uint32_t _newNode(const KeyT& key, const ValueT& value)
+  {
+    uint32_t cur;
+
+    if (FreeHead != NIL)
+    {
+      cur = FreeHead;
+      FreeHead = Nodes[cur].Left;
+    }
+    else
+    {
+      if (Nodes.size() >= NIL)  // NIL itself is not a usable index
+        throw length_error("compact_avlt: more than 2^31 - 1 nodes");
+
+      cur = (uint32_t) Nodes.size();
+      Nodes.push_back(NODE());
+    }
+
+    NODE& node = Nodes[cur];
+    node.Key = key;
+    node.Value = value;
+    node.Left = NIL;
+    node.Right = NIL | THREAD;
+    node.Height = 0;
+
+    return cur;
+  }
+
+  void _freeNode(uint32_t cur)
+  {
+    Nodes[cur].Key = KeyT{};  // let go of anything the key/value hold
+    Nodes[cur].Value = ValueT{};
+    Nodes[cur].Left = FreeHead;
+    FreeHead = cur;
+  }
+
+  void _replaceChild(uint32_t parent, uint32_t old, uint32_t child, uint32_t succ)
+  {
+    if (parent == NIL)
+      Root = child;
+    else if (Nodes[parent].Left == old)
+      Nodes[parent].Left = child;
+    else if (child != NIL)
+      _setRight(parent, child, false);
+    else
+      _setRight(parent, succ, true);
+  }
+
+  //
+  // rotations, as in avlt: Parent may be NIL when N is the root.
+  //
+  void _rightRotate(uint32_t Parent, uint32_t N)
+  {
+    uint32_t L = Nodes[N].Left;
+    uint32_t B = _getActualRight(L);
+
+    Nodes[N].Left = B;
+    _setRight(L, N, false);
+
+    _replaceChild(Parent, N, L, NIL);
+
+    _fixHeight(N);
+    _fixHeight(L);
+  }
+
+  void _leftRotate(uint32_t Parent, uint32_t N)
+  {
+    uint32_t R = Nodes[N].Right;
+    uint32_t B = Nodes[R].Left;
+
+    Nodes[R].Left = N;
+    if (B == NIL)
+      _setRight(N, R, true);
+    else
+      _setRight(N, B, false);
+
+    _replaceChild(Parent, N, R, NIL);
+
+    _fixHeight(N);
+    _fixHeight(R);
+  }
+
+  //
+  // _rebalance:
+  //
+  // Walks back up path[0..depth-1], fixing heights and rotating.  After
+  // an insert one rotation is enough, so we may stop at the first node
+  // whose height doesn't change; after an erase we keep going.
+  //
+  void _rebalance(uint32_t* path, int depth, bool isInsert)
+  {
+    while (depth > 0)
+    {
+      uint32_t cur = path[--depth];
+      uint32_t parent = (depth > 0) ? path[depth - 1] : NIL;
+
+      int HL = _height(Nodes[cur].Left);
+      int HR = _height(_getActualRight(cur));
+      int HC = 1 + max(HL, HR);
+      int BF = HL - HR;
+
+      if (BF >= -1 && BF <= 1)
+      {
+        if (HC == Nodes[cur].Height)
+          break;
+
+        Nodes[cur].Height = (uint8_t) HC;
+        continue;
+      }
+
+      if (HR > HL)
+      {
+        uint32_t R = Nodes[cur].Right;
+
+        if (_height(_getActualRight(R)) >= _height(Nodes[R].Left))  // right right case
+          _leftRotate(parent, cur);
+        else  // right left case
+        {
+          _rightRotate(cur, R);
+          _leftRotate(parent, cur);
+        }
+      }
+      else
+      {
+        uint32_t L = Nodes[cur].Left;
+
+        if (_height(Nodes[L].Left) >= _height(_getActualRight(L)))  // left left case
+          _rightRotate(parent, cur);
+        else  // left right case
+        {
+          _leftRotate(cur, L);
+          _rightRotate(parent, cur);
+        }
+      }
+
+      if (isInsert)
+        break;
+    }//while
+  }
+
+  uint32_t _findNode(const KeyT& key) const
+  {
+    uint32_t cur = Root;
+
+    while (cur != NIL)
+    {
+      const NODE& node = Nodes[cur];
+
+      if (key == node.Key)
+        return cur;
+
+      cur = (key < node.Key) ? node.Left : _getActualRight(cur);
+    }
+
+    return NIL;
+  }
+
+  uint32_t _leftmost(uint32_t cur) const
+  {
+    if (cur != NIL)
+      while (Nodes[cur].Left != NIL)
+        cur = Nodes[cur].Left;
+
+    return cur;
+  }
+
+  uint32_t _lowerBound(const KeyT& key) const
+  {
+    uint32_t cur = Root;
+    uint32_t candidate = NIL;
+
+    while (cur != NIL)
+    {
+      if (Nodes[cur].Key < key)
+        cur = _getActualRight(cur);
+      else
+      {
+        candidate = cur;
+        cur = Nodes[cur].Left;
+      }
+    }
+
+    return candidate;
+  }
+
+  //
+  // _build:
+  //
+  // Links the nodes order[lo..hi) into a perfectly balanced subtree and
+  // returns its root; "after" is the inorder successor of the subtree,
+  // where its largest node's thread points.
+  //
+  uint32_t _build(const vector<uint32_t>& order, size_t lo, size_t hi, uint32_t after)
+  {
+    if (lo >= hi)
+      return NIL;
+
+    size_t mid = lo + (hi - lo) / 2;
+    uint32_t cur = order[mid];
+
+    Nodes[cur].Left = _build(order, lo, mid, cur);
+
+    uint32_t right = _build(order, mid + 1, hi, after);
+    if (right == NIL)
+      _setRight(cur, after, true);
+    else
+      _setRight(cur, right, false);
+
+    _fixHeight(cur);
+
+    return cur;
+  }
+
+  //
+  // _rebuildIsCheaper / _rebuildWithout:
+  //
+  // As in avlt: removing k keys one at a time costs k lgN, a rebuild N.
+  // _rebuildWithout frees every node for which drop(index) is true and
+  // relinks the survivors, in place, into a perfectly balanced tree.
+  //
+  bool _rebuildIsCheaper(size_t k) const
+  {
+    size_t lgN = 1;
+    while (((size_t) 1 << lgN) <= (size_t) Size)
+      lgN++;
+
+    return k * lgN >= (size_t) Size;
+  }
+
+  template<typename Predicate>
+  int _rebuildWithout(Predicate drop)
+  {
+    vector<uint32_t> keep;
+    keep.reserve(Size);
+
+    bool cursorLost = false;
+
+    for (uint32_t cur = _leftmost(Root); cur != NIL; )
+    {
+      uint32_t next = _successor(cur);
+
+      if (drop(cur))
+      {
+        if (cur == ptr)
+          cursorLost = true;
+        _freeNode(cur);
+      }
+      else
+      {
+        if (cursorLost)  // the begin()/next() cursor moves on to here
+        {
+          ptr = cur;
+          cursorLost = false;
+        }
+        keep.push_back(cur);
+      }
+
+      cur = next;
+    }
+
+    if (cursorLost)
+      ptr = NIL;
+
+    int removed = Size - (int) keep.size();
+
+    Root = _build(keep, 0, keep.size(), NIL);
+    Size = (int) keep.size();
+
+    return removed;
+  }
+
+  void _printInOrder(uint32_t cur, ostream& output) const
+  {
+    if (cur == NIL)
+      return;
+
+    const NODE& node = Nodes[cur];
+
+    _printInOrder(node.Left, output);
+
+    if (_isThreaded(cur) && _rightLink(cur) != NIL)
+      output << "(" << node.Key << "," << node.Value << "," << (int) node.Height << "," << Nodes[_rightLink(cur)].Key << ")" << endl;
+    else
+      output << "(" << node.Key << "," << node.Value << "," << (int) node.Height << ")" << endl;
+
+    _printInOrder(_getActualRight(cur), output);
+  }
+
+  //
+  // _iterator:
+  //
+  // Forward iterator over the keys in order, as in avlt.  It holds the
+  // tree and a node index, so growing the node array doesn't invalidate
+  // it; erasing the node it is on does.
+  //
+  template<bool Const>
+  class _iterator
+  {
+  private:
+    typedef typename std::conditional<Const, const compact_avlt, compact_avlt>::type TREE;
+
+    TREE*    tree;
+    uint32_t cur;
+
+    friend class compact_avlt;
+    friend class _iterator<!Const>;
+
+  public:
+    typedef std::forward_iterator_tag  iterator_category;
+    typedef KeyT                       value_type;
+    typedef std::ptrdiff_t             difference_type;
+    typedef const KeyT*                pointer;
+    typedef const KeyT&                reference;
+
+    typedef typename std::conditional<Const, const ValueT&, ValueT&>::type  value_reference;
+
+    _iterator(TREE* t = nullptr, uint32_t node = NIL)
+      : tree(t), cur(node)
+    { }
+
+    //
+    // iterator converts to const_iterator, not the other way around:
+    //
+    template<bool C, typename = typename std::enable_if<Const && !C>::type>
+    _iterator(const _iterator<C>& other)
+      : tree(other.tree), cur(other.cur)
+    { }
+
+    reference operator*() const  { return tree->Nodes[cur].Key; }
+    pointer operator->() const   { return &tree->Nodes[cur].Key; }
+
+    const KeyT& key() const      { return tree->Nodes[cur].Key; }
+    value_reference value() const { return tree->Nodes[cur].Value; }
+
+    _iterator& operator++()
+    {
+      cur = tree->_successor(cur);
+      return *this;
+    }
+
+    _iterator operator++(int)
+    {
+      _iterator before = *this;
+      cur = tree->_successor(cur);
+      return before;
+    }
+
+    template<bool C>
+    bool operator==(const _iterator<C>& other) const { return cur == other.cur; }
+
+    template<bool C>
+    bool operator!=(const _iterator<C>& other) const { return cur != other.cur; }
+  };
+
+public:
+  typedef _iterator<false>  iterator;
+  typedef _iterator<true>   const_iterator;
+
+  //
+  // default constructor:
+  //
+  // Creates an empty tree.  Copying and assignment are the defaults:
+  // with indices instead of pointers, copying the array copies the tree.
+  //
+  compact_avlt()
+    : Root(NIL), Size(0), FreeHead(NIL), ptr(NIL)
+  { }
+
+  //
+  // constructor from a sorted range:
+  //
+  // Same contract as in avlt; see assign_sorted.
+  //
+  template<typename ForwardIt>
+  compact_avlt(ForwardIt first, ForwardIt last)
+    : Root(NIL), Size(0), FreeHead(NIL), ptr(NIL)
+  {
+    assign_sorted(first, last);
+  }
+
+  //
+  // node_bytes:
+  //
+  // Returns the # of bytes each entry takes in the node array.
+  //
+  static size_t node_bytes()
+  {
+    return sizeof(NODE);
+  }
+
+  //
+  // reserve:
+  //
+  // Makes room for n entries up front, so the node array doesn't have
+  // to grow (and briefly double its memory) while inserting.
+  //
+  void reserve(int n)
+  {
+    Nodes.reserve(n);
+  }
+
+  //
+  // clear:
+  //
+  // Clears the contents of the tree, resetting the tree to empty.
+  //
+  void clear()
+  {
+    Nodes.clear();
+    Root = NIL;
+    Size = 0;
+    FreeHead = NIL;
+    ptr = NIL;
+  }
+
+  //
+  // size / height:
+  //
+  // Time complexity:  O(1)
+  //
+  int size() const
+  {
+    return Size;
+  }
+
+  int height() const
+  {
+    return _height(Root);
+  }
+
+  //
+  // search:
+  //
+  // Same contract as avlt::search.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    uint32_t cur = _findNode(key);
+
+    if (cur == NIL)
+      return false;
+
+    value = Nodes[cur].Value;
+    return true;
+  }
+
+  //
+  // range_for_each / range_search:
+  //
+  // Same contracts as in avlt: one descent, then follow the threads.
+  //
+  // Time complexity:  O(lgN + M)
+  //
+  template<typename Visitor>
+  void range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    uint32_t cur = Root;
+    uint32_t first = NIL;
+
+    while (cur != NIL)
+    {
+      if (Nodes[cur].Key < lower)
+        cur = _getActualRight(cur);
+      else
+      {
+        first = cur;
+        cur = Nodes[cur].Left;
+      }
+    }
+
+    for (cur = first; cur != NIL && !(upper < Nodes[cur].Key); cur = _successor(cur))
+      visit(Nodes[cur].Key, Nodes[cur].Value);
+  }
+
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_search(lower, upper, back_inserter(keys));
+
+    return keys;
+  }
+
+  template<typename OutputIt>
+  OutputIt range_search(const KeyT& lower, const KeyT& upper, OutputIt out) const
+  {
+    range_for_each(lower, upper,
+      [&out](const KeyT& key, const ValueT&) { *out++ = key; });
+
+    return out;
+  }
+
+  //
+  // insert
+  //
+  // Same contract as avlt::insert.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    uint32_t path[MAX_HEIGHT];
+    int      depth = 0;
+    uint32_t prev = NIL;
+    uint32_t cur = Root;
+
+    while (cur != NIL)
+    {
+      if (key == Nodes[cur].Key)
+        return;
+
+      path[depth++] = cur;
+      prev = cur;
+      cur = (key < Nodes[cur].Key) ? Nodes[cur].Left : _getActualRight(cur);
+    }
+
+    uint32_t newNode = _newNode(key, value);
+
+    if (prev == NIL)
+      Root = newNode;
+    else if (key < Nodes[prev].Key)
+    {
+      Nodes[prev].Left = newNode;
+      _setRight(newNode, prev, true);
+    }
+    else
+    {
+      _setRight(newNode, _rightLink(prev), true);
+      _setRight(prev, newNode, false);
+    }
+
+    Size++;
+
+    _rebalance(path, depth, true);
+  }
+
+  //
+  // erase
+  //
+  // Same contract as avlt::erase; the freed slot is reused by the next
+  // insert.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool erase(const KeyT& key)
+  {
+    uint32_t path[MAX_HEIGHT];
+    int      depth = 0;
+    uint32_t cur = Root;
+
+    while (cur != NIL && !(key == Nodes[cur].Key))
+    {
+      path[depth++] = cur;
+      cur = (key < Nodes[cur].Key) ? Nodes[cur].Left : _getActualRight(cur);
+    }
+
+    if (cur == NIL)
+      return false;
+
+    uint32_t z = cur;
+    uint32_t parent = (depth > 0) ? path[depth - 1] : NIL;
+    uint32_t succ = _successor(z);
+
+    uint32_t pred = Nodes[z].Left;
+    if (pred != NIL)
+      while (!_isThreaded(pred))
+        pred = Nodes[pred].Right;
+
+    if (_isThreaded(z))
+    {
+      if (pred != NIL)
+        _setRight(pred, succ, true);
+
+      _replaceChild(parent, z, Nodes[z].Left, succ);
+    }
+    else if (Nodes[z].Left == NIL)
+    {
+      _replaceChild(parent, z, Nodes[z].Right, succ);
+    }
+    else
+    {
+      path[depth++] = succ;  // succ takes z's place on the path
+
+      uint32_t sParent = z;
+      for (uint32_t walk = Nodes[z].Right; walk != succ; walk = Nodes[walk].Left)
+      {
+        path[depth++] = walk;
+        sParent = walk;
+      }
+
+      if (sParent != z)
+      {
+        Nodes[sParent].Left = _getActualRight(succ);
+        _setRight(succ, Nodes[z].Right, false);
+      }
+
+      Nodes[succ].Left = Nodes[z].Left;
+      Nodes[succ].Height = Nodes[z].Height;
+      _setRight(pred, succ, true);
+
+      _replaceChild(parent, z, succ, NIL);
+    }
+
+    if (ptr == z)
+      ptr = succ;
+
+    _freeNode(z);
+    Size--;
+
+    _rebalance(path, depth, false);
+
+    return true;
+  }
+
+  //
+  // erase_range / erase_batch
+  //
+  // Same contracts as in avlt: a few keys are erased one at a time, and
+  // enough of them that a linear rebuild is cheaper are dropped in one
+  // inorder pass that relinks the survivors.
+  //
+  // Time complexity:  O(lgN + min(k lgN, N)) for k keys
+  //
+  int erase_range(const KeyT& lower, const KeyT& upper)
+  {
+    //
+    // count the keys in range along the threads, only as far as it takes
+    // to tell whether a rebuild is cheaper:
+    //
+    size_t k = 0;
+    bool rebuild = false;
+
+    for (uint32_t cur = _lowerBound(lower); cur != NIL && !(upper < Nodes[cur].Key); cur = _successor(cur))
+    {
+      if (_rebuildIsCheaper(++k))
+      {
+        rebuild = true;
+        break;
+      }
+    }
+
+    if (rebuild)
+    {
+      return _rebuildWithout([&](uint32_t cur)
+        { return !(Nodes[cur].Key < lower) && !(upper < Nodes[cur].Key); });
+    }
+
+    for (size_t i = 0; i < k; ++i)
+    {
+      KeyT key = Nodes[_lowerBound(lower)].Key;
+      erase(key);
+    }
+
+    return (int) k;
+  }
+
+  int erase_batch(const vector<KeyT>& keys)
+  {
+    if (keys.empty() || Root == NIL)
+      return 0;
+
+    if (!_rebuildIsCheaper(keys.size()))
+    {
+      int removed = 0;
+
+      for (const KeyT& key : keys)
+        if (erase(key))
+          removed++;
+
+      return removed;
+    }
+
+    size_t i = 0;
+
+    return _rebuildWithout([&](uint32_t cur)
+    {
+      while (i < keys.size() && keys[i] < Nodes[cur].Key)  // skip keys not in tree
+        i++;
+
+      return i < keys.size() && !(Nodes[cur].Key < keys[i]);
+    });
+  }
+
+  //
+  // assign_sorted
+  //
+  // Same contract as in avlt: replaces the contents with the (key, value)
+  // pairs in [first, last), sorted by key, the first of a repeated key
+  // winning; a perfectly balanced tree is built in one pass, into a node
+  // array of exactly the right size.  Input that turns out not to be
+  // sorted has the rest inserted one key at a time.  More than 2^31 - 1
+  // distinct keys throw length_error and leave the tree empty.
+  //
+  // Time complexity:  O(N) for sorted input
+  //
+  template<typename ForwardIt>
+  void assign_sorted(ForwardIt first, ForwardIt last)
+  {
+    clear();
+    Nodes.reserve((size_t) std::distance(first, last));
+
+    for (; first != last; ++first)
+    {
+      if (!Nodes.empty())
+      {
+        const KeyT& prev = Nodes.back().Key;
+
+        if (first->first < prev)  // not sorted after all
+          break;
+        if (!(prev < first->first))  // duplicate, keep the first one
+          continue;
+      }
+
+      try
+      {
+        _newNode(first->first, first->second);
+      }
+      catch (...)
+      {
+        clear();
+        throw;
+      }
+    }
+
+    vector<uint32_t> order(Nodes.size());
+    for (size_t i = 0; i < order.size(); ++i)
+      order[i] = (uint32_t) i;
+
+    Root = _build(order, 0, order.size(), NIL);
+    Size = (int) Nodes.size();
+
+    for (; first != last; ++first)
+      insert(first->first, first->second);
+  }
+
+  //
+  // [] / () / %
+  //
+  // Same contracts as in avlt.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    uint32_t cur = _findNode(key);
+
+    return (cur == NIL) ? ValueT{} : Nodes[cur].Value;
+  }
+
+  KeyT operator()(const KeyT& key) const
+  {
+    uint32_t cur = _findNode(key);
+
+    if (cur == NIL || _rightLink(cur) == NIL)
+      return KeyT{};
+
+    return Nodes[_rightLink(cur)].Key;
+  }
+
+  int operator%(const KeyT& key) const
+  {
+    uint32_t cur = _findNode(key);
+
+    return (cur == NIL) ? -1 : Nodes[cur].Height;
+  }
+
+  //
+  // next
+  //
+  // Same contract as in avlt: after begin(), returns the keys in order.
+  //
+  bool next(KeyT& key)
+  {
+    if (ptr == NIL)
+      return false;
+
+    key = Nodes[ptr].Key;
+    ptr = _successor(ptr);
+
+    return true;
+  }
+
+  //
+  // begin / end / cbegin / cend / find / lower_bound
+  //
+  // Iterators over the keys in order, as in avlt.  begin() on a
+  // non-const tree also resets the begin()/next() cursor; the const
+  // versions leave it alone, so several threads may scan a const tree
+  // at once.
+  //
+  // Time complexity:  O(lgN) for begin, find and lower_bound, O(1) for end
+  //
+  iterator begin()
+  {
+    ptr = _leftmost(Root);
+
+    return iterator(this, ptr);
+  }
+
+  const_iterator begin() const
+  {
+    return const_iterator(this, _leftmost(Root));
+  }
+
+  const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+  iterator end()
+  {
+    return iterator(this, NIL);
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(this, NIL);
+  }
+
+  const_iterator cend() const
+  {
+    return end();
+  }
+
+  iterator find(const KeyT& key)
+  {
+    return iterator(this, _findNode(key));
+  }
+
+  const_iterator find(const KeyT& key) const
+  {
+    return const_iterator(this, _findNode(key));
+  }
+
+  iterator lower_bound(const KeyT& key)
+  {
+    return iterator(this, _lowerBound(key));
+  }
+
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _lowerBound(key));
+  }
+
+  //
+  // dump
+  //
+  // Same format as avlt::dump.
+  //
+  void dump(ostream& output) const
+  {
+    output << "**************************************************" << endl;
+    output << "***************** COMPACT AVLT *******************" << endl;
+
+    output << "** size: " << this->size() << endl;
+    output << "** height: " << this->height() << endl;
+
+    _printInOrder(Root, output);
+
+    output << "**************************************************" << endl;
+  }
+};
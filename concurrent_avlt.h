@@ -0,0 +1,539 @@
+/*concurrent_avlt.h*/
+
+//
+// Single-writer / many-reader AVL tree with lock-free reads.
+//
+// Readers never take a lock: they pin the current epoch, load the root
+// and walk immutable nodes.  The writer never changes a node that has
+// been published.  Instead each insert copies the nodes on its search
+// path (plus any it rotates), links the copies into a new version, and
+// publishes that version with one atomic store of the root.  The nodes
+// it replaced are retired, and freed only once every reader that might
+// still be looking at them has moved on to a later epoch.
+//
+// Unlike avlt, this tree is not threaded: a thread would point at nodes
+// that the next writer replaces, so a single insert would have to copy
+// the whole tree.  Range scans use a small explicit stack instead.
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+using namespace std;
+
+template<typename KeyT, typename ValueT>
+class concurrent_avlt
+{
+private:
+  struct NODE
+  {
+    KeyT     Key;
+    ValueT   Value;
+    NODE*    Left;
+    NODE*    Right;
+    int      Height;  // height of tree rooted at this node
+    uint64_t Stamp;   // epoch of the write that made it; only writers look
+
+    NODE(const KeyT& key, const ValueT& value, NODE* left, NODE* right, int height, uint64_t stamp)
+      : Key(key), Value(value), Left(left), Right(right), Height(height), Stamp(stamp)
+    { }
+  };
+
+  //
+  // one reader slot per cache line, so that readers on different cores
+  // don't invalidate each other when they pin and unpin:
+  //
+  struct alignas(64) SLOT
+  {
+    std::atomic<uint64_t> Epoch;  // 0 => not reading
+  };
+
+  static const int MAX_SLOTS = 128;
+  static const int MAX_HEIGHT = 64;
+
+  //
+  // a batch of nodes replaced by one write, freed once no reader can
+  // still see the epoch it was retired in:
+  //
+  struct RETIRED
+  {
+    uint64_t      Epoch;
+    vector<NODE*> Nodes;
+  };
+
+  std::atomic<NODE*>    Root;    // current published version
+  std::atomic<int>      Size;    // # of keys in the current version
+  std::atomic<uint64_t> Epoch;   // global epoch, starts at 1
+  mutable SLOT          Slots[MAX_SLOTS];  // pinned by readers, even on a const tree
+
+  std::mutex      WriteLock;  // serializes writers
+  vector<RETIRED> Retired;    // only touched under WriteLock
+
+  //
+  // _pin / _unpin:
+  //
+  // Announces that this reader may hold pointers into the current
+  // version.  Readers hash their thread id to a starting slot, so in
+  // the common case each core claims its own cache line.
+  //
+  int _pin() const
+  {
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    for (size_t i = 0; ; ++i)
+    {
+      int s = (int) ((start + i) % MAX_SLOTS);
+      uint64_t idle = 0;
+      uint64_t now = Epoch.load();
+
+      if (Slots[s].Epoch.compare_exchange_strong(idle, now))
+        return s;
+
+      if (i % MAX_SLOTS == MAX_SLOTS - 1)  // every slot busy, give way
+        std::this_thread::yield();
+    }
+  }
+
+  void _unpin(int s) const
+  {
+    Slots[s].Epoch.store(0);
+  }
+
+  //
+  // _reclaim:
+  //
+  // Frees every retired batch whose epoch is older than the oldest
+  // epoch still pinned by a reader.  Called by the writer.
+  //
+  void _reclaim()
+  {
+    uint64_t oldest = UINT64_MAX;
+
+    for (int s = 0; s < MAX_SLOTS; ++s)
+    {
+      uint64_t e = Slots[s].Epoch.load();
+      if (e != 0 && e < oldest)
+        oldest = e;
+    }
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < Retired.size(); ++i)
+    {
+      if (Retired[i].Epoch < oldest)
+      {
+        for (NODE* n : Retired[i].Nodes)
+          delete n;
+      }
+      else
+      {
+        if (kept != i)
+          Retired[kept] = std::move(Retired[i]);
+        kept++;
+      }
+    }
+
+    Retired.resize(kept);
+  }
+
+  static int _height(NODE* cur)
+  {
+    return (cur == nullptr) ? -1 : cur->Height;
+  }
+
+  static void _fixHeight(NODE* cur)
+  {
+    cur->Height = 1 + max(_height(cur->Left), _height(cur->Right));
+  }
+
+  //
+  // _rotateLeft / _rotateRight:
+  //
+  // Rotations on unpublished copies.  Any node that moves and is still
+  // shared with the published version is copied first; the originals
+  // are added to "retired".  Writes are serialized and the epoch only
+  // moves on when one is published, so the nodes this write made are
+  // the ones stamped with the current epoch.
+  //
+  static NODE* _own(NODE* cur, uint64_t stamp, vector<NODE*>& retired)
+  {
+    if (cur->Stamp == stamp)
+      return cur;
+
+    NODE* copy = new NODE(cur->Key, cur->Value, cur->Left, cur->Right, cur->Height, stamp);
+    retired.push_back(cur);
+
+    return copy;
+  }
+
+  static NODE* _rotateLeft(NODE* N, uint64_t stamp, vector<NODE*>& retired)
+  {
+    NODE* R = _own(N->Right, stamp, retired);
+
+    N->Right = R->Left;
+    R->Left = N;
+
+    _fixHeight(N);
+    _fixHeight(R);
+
+    return R;
+  }
+
+  static NODE* _rotateRight(NODE* N, uint64_t stamp, vector<NODE*>& retired)
+  {
+    NODE* L = _own(N->Left, stamp, retired);
+
+    N->Left = L->Right;
+    L->Right = N;
+
+    _fixHeight(N);
+    _fixHeight(L);
+
+    return L;
+  }
+
+  //
+  // _balance:
+  //
+  // Restores the AVL property at the (unpublished) node cur and returns
+  // the root of the subtree.
+  //
+  static NODE* _balance(NODE* cur, uint64_t stamp, vector<NODE*>& retired)
+  {
+    _fixHeight(cur);
+
+    int BF = _height(cur->Left) - _height(cur->Right);
+
+    if (BF > 1)
+    {
+      if (_height(cur->Left->Left) < _height(cur->Left->Right))  // left right case
+      {
+        cur->Left = _own(cur->Left, stamp, retired);
+        cur->Left = _rotateLeft(cur->Left, stamp, retired);
+      }
+      return _rotateRight(cur, stamp, retired);
+    }
+
+    if (BF < -1)
+    {
+      if (_height(cur->Right->Right) < _height(cur->Right->Left))  // right left case
+      {
+        cur->Right = _own(cur->Right, stamp, retired);
+        cur->Right = _rotateRight(cur->Right, stamp, retired);
+      }
+      return _rotateLeft(cur, stamp, retired);
+    }
+
+    return cur;
+  }
+
+  void _destroy(NODE* cur)
+  {
+    if (cur == nullptr)
+      return;
+
+    _destroy(cur->Left);
+    _destroy(cur->Right);
+    delete cur;
+  }
+
+public:
+  //
+  // reader:
+  //
+  // A pinned, consistent snapshot of the tree.  While a reader object is
+  // alive the version it loaded cannot be reclaimed, so any number of
+  // lookups and scans through it see exactly the same keys.  Readers are
+  // cheap to create and are meant to be short-lived: the writer cannot
+  // reclaim memory retired after the reader was created until it ends.
+  //
+  class reader
+  {
+  private:
+    const concurrent_avlt* Tree;
+    int              Slot;
+    NODE*            Root;
+
+    friend class concurrent_avlt;
+
+    explicit reader(const concurrent_avlt* tree)
+      : Tree(tree), Slot(tree->_pin()), Root(tree->Root.load())
+    { }
+
+  public:
+    reader(const reader&) = delete;
+    reader& operator=(const reader&) = delete;
+
+    reader(reader&& other)
+      : Tree(other.Tree), Slot(other.Slot), Root(other.Root)
+    {
+      other.Tree = nullptr;
+    }
+
+    ~reader()
+    {
+      if (Tree != nullptr)
+        Tree->_unpin(Slot);
+    }
+
+    //
+    // search: same contract as avlt::search.
+    //
+    bool search(const KeyT& key, ValueT& value) const
+    {
+      NODE* cur = Root;
+
+      while (cur != nullptr)
+      {
+        if (key == cur->Key)
+        {
+          value = cur->Value;
+          return true;
+        }
+
+        cur = (key < cur->Key) ? cur->Left : cur->Right;
+      }
+
+      return false;
+    }
+
+    //
+    // range_for_each: calls visit(key, value) for every key in
+    // [lower..upper], in order.  O(lgN + M) time, O(lgN) space.
+    //
+    template<typename Visitor>
+    void range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+    {
+      NODE* path[MAX_HEIGHT];
+      int   depth = 0;
+      NODE* cur = Root;
+
+      for (;;)
+      {
+        while (cur != nullptr)  // push the nodes that might be >= lower
+        {
+          if (cur->Key < lower)
+            cur = cur->Right;
+          else
+          {
+            path[depth++] = cur;
+            cur = cur->Left;
+          }
+        }
+
+        if (depth == 0)
+          return;
+
+        cur = path[--depth];
+        if (upper < cur->Key)
+          return;
+
+        visit(cur->Key, cur->Value);
+        cur = cur->Right;
+      }
+    }
+  };
+
+  //
+  // default constructor:
+  //
+  // Creates an empty tree.
+  //
+  concurrent_avlt()
+    : Root(nullptr), Size(0), Epoch(1)
+  {
+    for (int s = 0; s < MAX_SLOTS; ++s)
+      Slots[s].Epoch.store(0);
+  }
+
+  concurrent_avlt(const concurrent_avlt&) = delete;
+  concurrent_avlt& operator=(const concurrent_avlt&) = delete;
+
+  //
+  // destructor:
+  //
+  // No reader may be active when the tree is destroyed.
+  //
+  virtual ~concurrent_avlt()
+  {
+    _destroy(Root.load());
+
+    for (RETIRED& batch : Retired)
+      for (NODE* n : batch.Nodes)
+        delete n;
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of keys in the current version.
+  //
+  // Time complexity:  O(1)
+  //
+  int size() const
+  {
+    return Size.load();
+  }
+
+  //
+  // height:
+  //
+  // Returns the height of the current version, -1 if empty.
+  //
+  int height() const
+  {
+    return _height(read().Root);
+  }
+
+  //
+  // read:
+  //
+  // Returns a pinned snapshot for a series of consistent lookups.
+  //
+  // Example usage:
+  //    auto r = tree.read();
+  //    if (r.search(key, value)) ...
+  //
+  reader read() const
+  {
+    return reader(this);
+  }
+
+  //
+  // search:
+  //
+  // Lock-free lookup; returns true and the value if the key is found.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    return read().search(key, value);
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key, or ValueT{} if not found.
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    ValueT value{};
+
+    read().search(key, value);
+
+    return value;
+  }
+
+  //
+  // range_search
+  //
+  // Returns the keys in [lower..upper] from one consistent version.
+  //
+  // Time complexity:  O(lgN + M)
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    read().range_for_each(lower, upper,
+      [&keys](const KeyT& key, const ValueT&) { keys.push_back(key); });
+
+    return keys;
+  }
+
+  //
+  // insert
+  //
+  // Inserts the key; if it is already present the tree is unchanged.
+  // Writers are serialized by a mutex, and never block readers: the new
+  // version becomes visible to them all at once when the root is
+  // published.
+  //
+  // Time complexity:  O(lgN) worst-case, plus O(lgN) new nodes
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    std::lock_guard<std::mutex> guard(WriteLock);
+
+    NODE* path[MAX_HEIGHT];
+    bool  wentLeft[MAX_HEIGHT];
+    int   depth = 0;
+
+    NODE* cur = Root.load();
+
+    while (cur != nullptr)
+    {
+      if (key == cur->Key)  // already in tree
+        return;
+
+      path[depth] = cur;
+      wentLeft[depth] = key < cur->Key;
+      cur = wentLeft[depth] ? cur->Left : cur->Right;
+      depth++;
+    }
+
+    uint64_t stamp = Epoch.load();
+    vector<NODE*> retired;
+
+    NODE* child = new NODE(key, value, nullptr, nullptr, 0, stamp);
+
+    //
+    // copy the path bottom-up, linking each copy to the new child and
+    // rebalancing the copies as we go:
+    //
+    for (int i = depth - 1; i >= 0; --i)
+    {
+      NODE* copy = _own(path[i], stamp, retired);
+
+      if (wentLeft[i])
+        copy->Left = child;
+      else
+        copy->Right = child;
+
+      child = _balance(copy, stamp, retired);
+    }
+
+    Root.store(child);  // publish
+    Size.fetch_add(1);
+
+    //
+    // retire the replaced nodes in the epoch that is ending now; readers
+    // that pin from here on can only see the new version:
+    //
+    RETIRED batch;
+    batch.Epoch = Epoch.fetch_add(1);
+    batch.Nodes.swap(retired);
+    Retired.push_back(std::move(batch));
+
+    _reclaim();
+  }
+
+  //
+  // retired:
+  //
+  // Returns the # of replaced nodes still waiting for readers to move
+  // on before they can be freed.
+  //
+  size_t retired()
+  {
+    std::lock_guard<std::mutex> guard(WriteLock);
+
+    _reclaim();
+
+    size_t count = 0;
+    for (const RETIRED& batch : Retired)
+      count += batch.Nodes.size();
+
+    return count;
+  }
+};
@@ -0,0 +1,525 @@
+/*durable_avlt.h*/
+
+//
+// Crash-safe threaded AVL tree: an avlt backed by a write-ahead log and
+// periodic checkpoints, kept together in one directory.
+//
+// Every change to the tree is appended to the log as a small record
+// (op, key, value and a CRC32 over them).  Records are group committed:
+// they collect in memory and go to the log with one write (and one
+// fsync) per GroupSize records, so small inserts run close to the speed
+// of the in-memory tree.  A crash loses at most the changes made since
+// the last group was written; sync() forces one out at any time.
+//
+// Every CheckpointEvery records, the whole tree is saved as a binary
+// snapshot (see avlt::save), atomically replacing the previous one, and
+// the log starts over.  Recovery (open) loads the snapshot and replays
+// the log, stopping at the first torn or corrupt record.  Replaying a
+// record the snapshot already reflects changes nothing, so a crash in
+// the middle of a checkpoint is harmless.
+//
+// Keys and values must be trivially copyable.  All operations lock the
+// tree, so a durable_avlt may be shared between threads.  POSIX only.
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "avlt.h"
+
+using namespace std;
+
+//
+// durable_options:
+//
+// Tuning for durable_avlt; the defaults favor throughput.
+//
+struct durable_options
+{
+  size_t GroupSize;        // records per log write; 1 => write every change
+  bool   Fsync;            // fsync each write, or leave flushing to the OS
+  size_t CheckpointEvery;  // records between automatic checkpoints, 0 => never
+
+  durable_options()
+    : GroupSize(1024), Fsync(true), CheckpointEvery(1 << 20)
+  { }
+};
+
+//
+// avlt_crc32: the standard (zlib) CRC-32 of n bytes.
+//
+inline uint32_t avlt_crc32(const void* data, size_t n)
+{
+  static uint32_t table[256];
+  static once_flag built;
+
+  call_once(built, []()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+      for (int bit = 0; bit < 8; ++bit)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+  });
+
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  uint32_t crc = 0xFFFFFFFFu;
+
+  while (n-- > 0)
+    crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+  return crc ^ 0xFFFFFFFFu;
+}
+
+template<typename KeyT, typename ValueT>
+class durable_avlt
+{
+private:
+  static_assert(is_trivially_copyable<KeyT>::value && is_trivially_copyable<ValueT>::value,
+                "durable_avlt needs trivially copyable keys and values");
+
+  //
+  // log layout: a header, then fixed-size records
+  //
+  //   crc32 (of the rest) | op | key | value
+  //
+  struct LOGHEADER
+  {
+    char     Magic[8];    // "AVLTWAL1"
+    uint32_t KeyBytes;    // sizeof(KeyT)
+    uint32_t ValueBytes;  // sizeof(ValueT)
+  };
+
+  enum OP : unsigned char { OP_INSERT = 1, OP_ASSIGN = 2, OP_ERASE = 3 };
+
+  static const size_t RECORD = 4 + 1 + sizeof(KeyT) + sizeof(ValueT);
+
+  avlt<KeyT, ValueT> Tree;
+  mutable std::mutex Lock;
+  durable_options    Options;
+  string             Dir;
+  int                LogFd;       // -1 when not open
+  bool               LogFailed;   // a failed write couldn't be cut back off the log
+  vector<char>       Pending;     // records not yet written to the log
+  size_t             LogRecords;  // records in the log, written or pending
+
+  string _checkpointPath() const { return Dir + "/checkpoint.avlt"; }
+  string _logPath() const { return Dir + "/log.wal"; }
+
+  static LOGHEADER _logHeader()
+  {
+    LOGHEADER header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, "AVLTWAL1", sizeof(header.Magic));
+    header.KeyBytes = sizeof(KeyT);
+    header.ValueBytes = sizeof(ValueT);
+
+    return header;
+  }
+
+  //
+  // _writeAll / _syncPath: write(2) until done, and fsync(2) a file or
+  // directory by name.
+  //
+  static bool _writeAll(int fd, const char* data, size_t n)
+  {
+    while (n > 0)
+    {
+      ssize_t written = ::write(fd, data, n);
+      if (written < 0)
+        return false;
+      data += written;
+      n -= (size_t) written;
+    }
+
+    return true;
+  }
+
+  static bool _syncPath(const string& path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+
+    return ok;
+  }
+
+  //
+  // _flush: writes the pending group to the log; caller holds Lock.
+  //
+  // A write that fails partway leaves part of a record at the end of
+  // the log, and a replay stops there, so the log is cut back to where
+  // the group started and the group stays pending for the next try.  If
+  // even that fails the log is marked failed and refuses every write
+  // until it is opened again, rather than have records land after the
+  // torn one where no replay would reach them.
+  //
+  bool _flush()
+  {
+    if (Pending.empty())
+      return true;
+    if (LogFailed)
+      return false;
+
+    off_t start = lseek(LogFd, 0, SEEK_END);
+    if (start < 0)
+      return false;
+
+    if (_writeAll(LogFd, Pending.data(), Pending.size()) &&
+        (!Options.Fsync || fdatasync(LogFd) == 0))
+    {
+      Pending.clear();
+      return true;
+    }
+
+    if (ftruncate(LogFd, start) != 0)
+      LogFailed = true;
+
+    return false;
+  }
+
+  //
+  // _log: appends a record of a change already made to the tree, and
+  // writes the group / checkpoints when it is time to; caller holds
+  // Lock.  Throws runtime_error if the log cannot be written.
+  //
+  void _log(OP op, const KeyT& key, const ValueT& value)
+  {
+    size_t at = Pending.size();
+    Pending.resize(at + RECORD);
+
+    char* record = &Pending[at];
+    record[4] = (char) op;
+    memcpy(record + 5, &key, sizeof(KeyT));
+    memcpy(record + 5 + sizeof(KeyT), &value, sizeof(ValueT));
+
+    uint32_t crc = avlt_crc32(record + 4, RECORD - 4);
+    memcpy(record, &crc, 4);
+
+    LogRecords++;
+
+    if (Pending.size() >= Options.GroupSize * RECORD && !_flush())
+      throw runtime_error("durable_avlt: cannot write the log in " + Dir);
+
+    if (Options.CheckpointEvery > 0 && LogRecords >= Options.CheckpointEvery && !_checkpoint())
+      throw runtime_error("durable_avlt: cannot checkpoint " + Dir);
+  }
+
+  //
+  // _checkpoint: saves the tree and starts the log over; caller holds
+  // Lock.  The snapshot is written to a temporary file and renamed over
+  // the old one, so there is always one complete snapshot on disk; the
+  // directory is fsync'd after the rename so the new name is, too.
+  //
+  bool _checkpoint()
+  {
+    if (!_flush())
+      return false;
+
+    string temp = _checkpointPath() + ".tmp";
+
+    if (!Tree.save(temp) || !_syncPath(temp) ||
+        rename(temp.c_str(), _checkpointPath().c_str()) != 0 ||
+        !_syncPath(Dir))
+      return false;
+
+    //
+    // a crash before this point replays the old log over the new
+    // snapshot, which changes nothing:
+    //
+    if (ftruncate(LogFd, sizeof(LOGHEADER)) != 0 || fsync(LogFd) != 0)
+      return false;
+
+    LogRecords = 0;
+    return true;
+  }
+
+  //
+  // _replay: applies the valid records in the log to the tree, and cuts
+  // off anything after the last one (a torn or corrupt tail).
+  //
+  bool _replay()
+  {
+    struct stat info;
+    if (fstat(LogFd, &info) != 0)
+      return false;
+
+    LOGHEADER expected = _logHeader();
+
+    if ((size_t) info.st_size < sizeof(LOGHEADER))  // new (or torn) log
+    {
+      return ftruncate(LogFd, 0) == 0 &&
+             _writeAll(LogFd, reinterpret_cast<const char*>(&expected), sizeof(expected)) &&
+             fsync(LogFd) == 0;
+    }
+
+    vector<char> data((size_t) info.st_size);
+    if (pread(LogFd, data.data(), data.size(), 0) != (ssize_t) data.size())
+      return false;
+
+    if (memcmp(data.data(), &expected, sizeof(expected)) != 0)  // not our log
+      return false;
+
+    size_t at = sizeof(LOGHEADER);
+
+    for (; at + RECORD <= data.size(); at += RECORD)
+    {
+      const char* record = &data[at];
+
+      uint32_t crc;
+      memcpy(&crc, record, 4);
+      if (crc != avlt_crc32(record + 4, RECORD - 4))
+        break;
+
+      KeyT key;
+      ValueT value;
+      memcpy(&key, record + 5, sizeof(KeyT));
+      memcpy(&value, record + 5 + sizeof(KeyT), sizeof(ValueT));
+
+      switch (record[4])
+      {
+        case OP_INSERT: Tree.insert(key, value); break;
+        case OP_ASSIGN: Tree.insert_or_assign(key, value); break;
+        case OP_ERASE:  Tree.erase(key); break;
+      }
+
+      LogRecords++;
+    }//for
+
+    if (at != data.size() && (ftruncate(LogFd, (off_t) at) != 0 || fsync(LogFd) != 0))
+      return false;
+
+    return true;
+  }
+
+public:
+  //
+  // default constructor:
+  //
+  // Creates a closed tree; see open().
+  //
+  durable_avlt(const durable_options& options = durable_options())
+    : Options(options), LogFd(-1), LogFailed(false), LogRecords(0)
+  {
+    if (Options.GroupSize == 0)
+      Options.GroupSize = 1;
+  }
+
+  durable_avlt(const durable_avlt&) = delete;
+  durable_avlt& operator=(const durable_avlt&) = delete;
+
+  virtual ~durable_avlt()
+  {
+    close();
+  }
+
+  //
+  // open
+  //
+  // Opens (or creates) the tree kept in the existing directory "dir":
+  // loads the latest checkpoint, if any, and replays the log on top of
+  // it.  Returns false if the files cannot be read or were written for
+  // other key / value types.
+  //
+  // Time complexity:  O(N + L) for N keys and L log records
+  //
+  bool open(const string& dir)
+  {
+    close();
+
+    lock_guard<std::mutex> guard(Lock);
+
+    Dir = dir;
+    Tree.clear();
+    LogRecords = 0;
+    LogFailed = false;
+
+    if (access(_checkpointPath().c_str(), F_OK) == 0 && !Tree.load(_checkpointPath()))
+      return false;
+
+    bool created = access(_logPath().c_str(), F_OK) != 0;
+
+    LogFd = ::open(_logPath().c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (LogFd < 0)
+      return false;
+
+    //
+    // a new log's directory entry is made durable too, or a crash could
+    // lose the file along with every record fsync'd into it:
+    //
+    if (!_replay() || (created && !_syncPath(Dir)))
+    {
+      ::close(LogFd);
+      LogFd = -1;
+      Tree.clear();
+      return false;
+    }
+
+    return true;
+  }
+
+  //
+  // close
+  //
+  // Writes out anything pending and closes the log; the tree is empty
+  // afterwards.
+  //
+  void close()
+  {
+    lock_guard<std::mutex> guard(Lock);
+
+    if (LogFd >= 0)
+    {
+      _flush();
+      ::close(LogFd);
+    }
+
+    LogFd = -1;
+    LogFailed = false;
+    Pending.clear();
+    LogRecords = 0;
+    Tree.clear();
+  }
+
+  bool is_open() const
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return LogFd >= 0;
+  }
+
+  //
+  // sync
+  //
+  // Writes (and fsyncs, if enabled) every change made so far; when it
+  // returns true, they all survive a crash.
+  //
+  bool sync()
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return LogFd >= 0 && _flush() && (Options.Fsync || fdatasync(LogFd) == 0);
+  }
+
+  //
+  // checkpoint
+  //
+  // Saves a snapshot of the tree now and starts the log over, which
+  // makes the next recovery faster.  Returns true on success.
+  //
+  // Time complexity:  O(N)
+  //
+  bool checkpoint()
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return LogFd >= 0 && _checkpoint();
+  }
+
+  //
+  // log_records
+  //
+  // Returns the # of records a recovery would replay right now.
+  //
+  size_t log_records() const
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return LogRecords;
+  }
+
+  //
+  // insert
+  //
+  // Inserts the key if it is not in the tree, as avlt::insert, and logs
+  // the change.  Throws runtime_error if the log cannot be written.
+  //
+  // Time complexity:  O(lgN) amortized
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    lock_guard<std::mutex> guard(Lock);
+
+    if (Tree.try_emplace(key, value).second)
+      _log(OP_INSERT, key, value);
+  }
+
+  //
+  // insert_or_assign
+  //
+  // Inserts the key, or overwrites its value, and logs the change.
+  //
+  // Time complexity:  O(lgN) amortized
+  //
+  void insert_or_assign(const KeyT& key, const ValueT& value)
+  {
+    lock_guard<std::mutex> guard(Lock);
+
+    Tree.insert_or_assign(key, value);
+    _log(OP_ASSIGN, key, value);
+  }
+
+  //
+  // erase
+  //
+  // Removes the key, returning true if it was there, and logs the
+  // change.
+  //
+  // Time complexity:  O(lgN) amortized
+  //
+  bool erase(const KeyT& key)
+  {
+    lock_guard<std::mutex> guard(Lock);
+
+    if (!Tree.erase(key))
+      return false;
+
+    _log(OP_ERASE, key, ValueT{ });
+    return true;
+  }
+
+  //
+  // search / [] / size / range_for_each
+  //
+  // As for avlt, under the lock.
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return Tree.search(key, value);
+  }
+
+  ValueT operator[](const KeyT& key) const
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return Tree[key];
+  }
+
+  int size() const
+  {
+    lock_guard<std::mutex> guard(Lock);
+    return Tree.size();
+  }
+
+  template<typename Visit>
+  void range_for_each(const KeyT& lower, const KeyT& upper, Visit visit) const
+  {
+    lock_guard<std::mutex> guard(Lock);
+    Tree.range_for_each(lower, upper, visit);
+  }
+};
@@ -0,0 +1,242 @@
+/*frozen_avlt.h*/
+
+//
+// Immutable, cache-friendly snapshot of a threaded AVL tree.
+//
+// avlt::freeze() copies the keys into one contiguous array in Eytzinger
+// (breadth-first) order: the root is at index 1, and the children of k
+// are at 2k and 2k+1.  The top levels of the tree share a handful of
+// cache lines, a search needs no pointers at all, and the descent is
+// branch-free.  While we compare at one level, the cache line holding
+// the node several levels further down is already being prefetched.
+// Values sit in a parallel array, so they stay out of the way of the
+// keys during the search.
+//
+// The snapshot never changes, so any number of threads may read it at
+// once without locking.
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+using namespace std;
+
+template<typename KeyT, typename ValueT>
+class frozen_avlt
+{
+private:
+  vector<KeyT>   Keys;    // Keys[1..N] in Eytzinger order, Keys[0] unused
+  vector<ValueT> Values;  // Values[k] belongs to Keys[k]
+  size_t         N;
+
+  //
+  // how many levels ahead to prefetch: one cache line holds AHEAD
+  // consecutive keys, which are the descendants of k at 4 levels down
+  // for 4-byte keys, 3 levels down for 8-byte keys, and so on.
+  //
+  static const size_t AHEAD = (sizeof(KeyT) <= 4) ? 16 :
+                              (sizeof(KeyT) <= 8) ? 8 :
+                              (sizeof(KeyT) <= 16) ? 4 :
+                              (sizeof(KeyT) <= 32) ? 2 : 1;
+
+  //
+  // _up: strips the trailing 1 bits of k plus one more, i.e. climbs
+  // back to the last ancestor where the descent went left.
+  //
+  static size_t _up(size_t k)
+  {
+#if defined(__GNUC__)
+    return k >> __builtin_ffsll((long long) ~k);
+#else
+    while (k & 1)
+      k >>= 1;
+    return k >> 1;
+#endif
+  }
+
+  //
+  // _fill: in-order walk of the implicit tree, placing the sorted
+  // entries as they come.
+  //
+  template<typename Source>
+  void _fill(size_t k, Source& next)
+  {
+    if (k > N)
+      return;
+
+    _fill(2 * k, next);
+    next(Keys[k], Values[k]);
+    _fill(2 * k + 1, next);
+  }
+
+  //
+  // _lowerBound: index of the smallest key >= key, 0 if none.
+  //
+  size_t _lowerBound(const KeyT& key) const
+  {
+    const KeyT* keys = Keys.data();
+    size_t k = 1;
+
+    while (k <= N)
+    {
+#if defined(__GNUC__)
+      if (AHEAD > 1 && k * AHEAD <= N)
+        __builtin_prefetch(keys + k * AHEAD);
+#endif
+      k = 2 * k + (keys[k] < key);
+    }
+
+    return _up(k);
+  }
+
+  size_t _find(const KeyT& key) const
+  {
+    size_t k = _lowerBound(key);
+
+    if (k != 0 && !(key < Keys[k]))
+      return k;
+
+    return 0;
+  }
+
+  size_t _successor(size_t k) const
+  {
+    if (2 * k + 1 <= N)  // leftmost node of the right subtree
+    {
+      k = 2 * k + 1;
+      while (2 * k <= N)
+        k = 2 * k;
+      return k;
+    }
+
+    return _up(k);
+  }
+
+public:
+  //
+  // default constructor:
+  //
+  // An empty snapshot.
+  //
+  frozen_avlt()
+    : Keys(1), Values(1), N(0)
+  { }
+
+  //
+  // constructor:
+  //
+  // Builds the snapshot from n entries delivered in sorted order by
+  // next(key, value), which assigns the next entry to its arguments.
+  // This is what avlt::freeze() uses.
+  //
+  template<typename Source>
+  frozen_avlt(size_t n, Source next)
+    : Keys(n + 1), Values(n + 1), N(n)
+  {
+    _fill(1, next);
+  }
+
+  //
+  // constructor:
+  //
+  // Builds the snapshot from a range of (key, value) pairs sorted by
+  // key, with no duplicates.
+  //
+  template<typename ForwardIt>
+  frozen_avlt(ForwardIt first, ForwardIt last)
+    : frozen_avlt((size_t) std::distance(first, last), [&first](KeyT& key, ValueT& value)
+      {
+        key = first->first;
+        value = first->second;
+        ++first;
+      })
+  { }
+
+  //
+  // size:
+  //
+  // Returns the # of keys in the snapshot.
+  //
+  int size() const
+  {
+    return (int) N;
+  }
+
+  //
+  // search:
+  //
+  // Same contract as avlt::search.
+  //
+  // Time complexity:  O(lgN), branch-free descent
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    size_t k = _find(key);
+
+    if (k == 0)
+      return false;
+
+    value = Values[k];
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key, or ValueT{} if not found.
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    size_t k = _find(key);
+
+    return (k == 0) ? ValueT{} : Values[k];
+  }
+
+  //
+  // ()
+  //
+  // Same contract as avlt::operator(), on the snapshot's own shape:
+  // the key of the right child if there is one, otherwise the next
+  // inorder key (where avlt's thread would point).  KeyT{} if the key
+  // is not present or nothing follows it.
+  //
+  KeyT operator()(const KeyT& key) const
+  {
+    size_t k = _find(key);
+
+    if (k == 0)
+      return KeyT{};
+
+    k = (2 * k + 1 <= N) ? 2 * k + 1 : _up(k);
+
+    return (k == 0) ? KeyT{} : Keys[k];
+  }
+
+  //
+  // range_for_each / range_search
+  //
+  // Same contracts as in avlt.
+  //
+  // Time complexity:  O(lgN + M)
+  //
+  template<typename Visitor>
+  void range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    for (size_t k = _lowerBound(lower); k != 0 && !(upper < Keys[k]); k = _successor(k))
+      visit(Keys[k], Values[k]);
+  }
+
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper,
+      [&keys](const KeyT& key, const ValueT&) { keys.push_back(key); });
+
+    return keys;
+  }
+};
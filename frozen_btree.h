@@ -0,0 +1,374 @@
+/*frozen_btree.h*/
+
+//
+// Immutable, block-laid-out snapshot of a threaded AVL tree, for
+// arithmetic keys.
+//
+// The sorted keys are stored as a static B-tree: blocks of B keys (one
+// 64-byte cache line each, so 16 ints or 8 int64s), where block k has
+// children k*(B+1)+1 .. k*(B+1)+B+1.  A lookup touches one cache line
+// per level, and within a block it compares the probe against all B
+// keys at once; the # of keys smaller than the probe is the child to
+// descend into, so there is no branch to mispredict.
+//
+// The block compare is picked at compile time:
+//
+//   int32_t:  AVX2 (2 x 8 lanes) or SSE2 (4 x 4 lanes)
+//   int64_t:  AVX2 (2 x 4 lanes) or SSE4.2 (4 x 2 lanes)
+//   other arithmetic types, or with AVLT_NO_SIMD defined:  a scalar
+//   loop the compiler is free to vectorize
+//
+// Build with -mavx2 (or -march=native) to get the AVX2 kernels.
+//
+// Example usage:
+//    frozen_btree<int, int> snapshot(tree);  // tree is an avlt<int, int>
+//    if (snapshot.search(key, value)) ...
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+#if !defined(AVLT_NO_SIMD) && (defined(__SSE2__) || defined(__AVX2__))
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+template<typename KeyT, typename ValueT>
+class frozen_btree
+{
+  static_assert(std::is_arithmetic<KeyT>::value, "frozen_btree needs an arithmetic key type");
+
+private:
+  static const size_t B = (sizeof(KeyT) >= 64) ? 1 : 64 / sizeof(KeyT);  // keys per block
+
+  vector<KeyT>   Storage;  // blocks, starting at a 64-byte boundary
+  size_t         Offset;   // index in Storage where block 0 starts
+  vector<ValueT> Values;   // Values[i] belongs to key slot i
+  size_t         N;        // # of real keys
+  size_t         Blocks;   // # of blocks
+  size_t         MaxSlot;  // slot of the largest real key
+
+#ifdef AVLT_TEST_HOOKS
+  template<typename Tree> friend struct avlt_inspect;
+#endif
+
+  const KeyT* _keys() const
+  {
+    return Storage.data() + Offset;
+  }
+
+  static size_t _child(size_t k, size_t i)
+  {
+    return k * (B + 1) + i + 1;
+  }
+
+  //
+  // _rank: the # of keys in the block that are < key.
+  //
+  template<typename K>
+  static size_t _rank(const K* block, K key)
+  {
+    size_t count = 0;
+
+    for (size_t i = 0; i < B; ++i)
+      count += (block[i] < key);
+
+    return count;
+  }
+
+#if !defined(AVLT_NO_SIMD) && defined(__AVX2__)
+  static size_t _rank(const int32_t* block, int32_t key)
+  {
+    __m256i x = _mm256_set1_epi32(key);
+    __m256i a = _mm256_loadu_si256((const __m256i*) block);
+    __m256i b = _mm256_loadu_si256((const __m256i*) (block + 8));
+
+    unsigned mask = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, a)))
+                  | (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, b))) << 8;
+
+    return (size_t) __builtin_popcount(mask);
+  }
+
+  static size_t _rank(const int64_t* block, int64_t key)
+  {
+    __m256i x = _mm256_set1_epi64x(key);
+    __m256i a = _mm256_loadu_si256((const __m256i*) block);
+    __m256i b = _mm256_loadu_si256((const __m256i*) (block + 4));
+
+    unsigned mask = (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, a)))
+                  | (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, b))) << 4;
+
+    return (size_t) __builtin_popcount(mask);
+  }
+#elif !defined(AVLT_NO_SIMD) && defined(__SSE2__)
+  static size_t _rank(const int32_t* block, int32_t key)
+  {
+    //
+    // each compare gives -1 per smaller key; add them up lane-wise and
+    // then across the register:
+    //
+    __m128i x = _mm_set1_epi32(key);
+    __m128i sum = _mm_setzero_si128();
+
+    for (int i = 0; i < 4; ++i)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*) (block + 4 * i));
+      sum = _mm_add_epi32(sum, _mm_cmpgt_epi32(x, a));
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return (size_t) -_mm_cvtsi128_si32(sum);
+  }
+
+#if defined(__SSE4_2__)
+  static size_t _rank(const int64_t* block, int64_t key)
+  {
+    __m128i x = _mm_set1_epi64x(key);
+    unsigned mask = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*) (block + 2 * i));
+      mask |= (unsigned) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(x, a))) << (2 * i);
+    }
+
+    return (size_t) __builtin_popcount(mask);
+  }
+#endif
+#endif
+
+  //
+  // _fill: in-order walk of the implicit B-tree, placing the sorted
+  // entries as they come; slots past the last entry get the largest
+  // possible key, so they compare as "not smaller" than any probe.
+  //
+  template<typename Source>
+  void _fill(size_t k, size_t& placed, Source& next)
+  {
+    if (k >= Blocks)
+      return;
+
+    KeyT* keys = Storage.data() + Offset;
+
+    for (size_t i = 0; i < B; ++i)
+    {
+      _fill(_child(k, i), placed, next);
+
+      size_t slot = k * B + i;
+      if (placed < N)
+      {
+        next(keys[slot], Values[slot]);
+        MaxSlot = slot;
+        placed++;
+      }
+      else
+        keys[slot] = std::numeric_limits<KeyT>::max();
+    }
+
+    _fill(_child(k, B), placed, next);
+  }
+
+  //
+  // _place: allocates Storage for the blocks and points Offset at the
+  // first 64-byte boundary in it.  The boundary depends on where the
+  // buffer lands, so every new buffer needs its own Offset.
+  //
+  void _place()
+  {
+    Storage.assign(Blocks * B + 64 / sizeof(KeyT), KeyT{});
+
+    size_t misalign = (size_t) ((uintptr_t) Storage.data() % 64);
+    Offset = (misalign == 0) ? 0 : (64 - misalign) / sizeof(KeyT);
+  }
+
+  template<typename Source>
+  void _build(size_t n, Source& next)
+  {
+    N = n;
+    Blocks = (n + B - 1) / B;
+    MaxSlot = 0;
+
+    _place();
+    Values.assign(Blocks * B, ValueT{});
+
+    size_t placed = 0;
+    _fill(0, placed, next);
+  }
+
+  //
+  // _find: the slot holding key, or Blocks * B if not found.
+  //
+  size_t _find(KeyT key) const
+  {
+    const KeyT* keys = _keys();
+    size_t none = Blocks * B;
+    size_t found = none;
+    size_t k = 0;
+
+    while (k < Blocks)
+    {
+      size_t i = _rank(keys + k * B, key);
+
+      if (i < B)  // keys[k*B + i] is the first key >= key in this block
+        found = k * B + i;
+
+      k = _child(k, i);
+    }
+
+    if (found == none || key < keys[found])
+      return none;
+
+    if (found != MaxSlot && keys[found] == std::numeric_limits<KeyT>::max())
+      return none;  // landed on padding
+
+    return found;
+  }
+
+public:
+  //
+  // default constructor:
+  //
+  // An empty snapshot.
+  //
+  frozen_btree()
+    : Offset(0), N(0), Blocks(0), MaxSlot(0)
+  { }
+
+  //
+  // constructor:
+  //
+  // Builds the snapshot from a tree (an avlt, or anything with cbegin()
+  // / cend() iterators that have key() and value(), and size()).
+  //
+  template<typename Tree>
+  explicit frozen_btree(const Tree& tree)
+  {
+    auto it = tree.cbegin();
+    auto next = [&it](KeyT& key, ValueT& value)
+    {
+      key = it.key();
+      value = it.value();
+      ++it;
+    };
+
+    _build((size_t) tree.size(), next);
+  }
+
+  //
+  // constructor:
+  //
+  // Builds the snapshot from a range of (key, value) pairs sorted by
+  // key, with no duplicates.
+  //
+  template<typename ForwardIt>
+  frozen_btree(ForwardIt first, ForwardIt last)
+  {
+    auto next = [&first](KeyT& key, ValueT& value)
+    {
+      key = first->first;
+      value = first->second;
+      ++first;
+    };
+
+    _build((size_t) std::distance(first, last), next);
+  }
+
+  //
+  // copy constructor
+  //
+  // The blocks are copied into a buffer of their own, re-placed at a
+  // 64-byte boundary of that buffer.
+  //
+  // Time complexity:  O(N)
+  //
+  frozen_btree(const frozen_btree& other)
+    : Values(other.Values), N(other.N), Blocks(other.Blocks), MaxSlot(other.MaxSlot)
+  {
+    _place();
+
+    const KeyT* keys = other._keys();
+    std::copy(keys, keys + Blocks * B, Storage.data() + Offset);
+  }
+
+  //
+  // move constructor
+  //
+  // Takes over the buffer of "other", which keeps its alignment.
+  //
+  // Time complexity:  O(1)
+  //
+  frozen_btree(frozen_btree&& other) noexcept = default;
+
+  //
+  // operator=
+  //
+  // Replaces "this" snapshot with a copy of "other"; a throwing copy
+  // leaves "this" unchanged.
+  //
+  frozen_btree& operator=(const frozen_btree& other)
+  {
+    if (this != &other)
+    {
+      frozen_btree copy(other);
+      *this = std::move(copy);
+    }
+
+    return *this;
+  }
+
+  //
+  // move assignment
+  //
+  frozen_btree& operator=(frozen_btree&& other) noexcept = default;
+
+  //
+  // size:
+  //
+  // Returns the # of keys in the snapshot.
+  //
+  int size() const
+  {
+    return (int) N;
+  }
+
+  //
+  // search:
+  //
+  // Same contract as avlt::search.
+  //
+  // Time complexity:  O(lgN / lgB) block compares
+  //
+  bool search(KeyT key, ValueT& value) const
+  {
+    size_t slot = _find(key);
+
+    if (slot == Blocks * B)
+      return false;
+
+    value = Values[slot];
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key, or ValueT{} if not found.
+  //
+  ValueT operator[](KeyT key) const
+  {
+    size_t slot = _find(key);
+
+    return (slot == Blocks * B) ? ValueT{} : Values[slot];
+  }
+};
@@ -0,0 +1,225 @@
+/*mapped_avlt.h*/
+
+//
+// Read-only view of a snapshot file written by avlt::save().
+//
+// Rather than rebuilding a tree, the file is mapped into memory with
+// mmap and searched in place: the keys are stored in order, so a
+// lookup is a binary search over the mapped key array, and only the
+// pages it touches are ever read from disk.  Opening a snapshot of any
+// size costs O(1), which makes this the fast way back up after a
+// restart when the data is only queried.
+//
+// The view never changes, so any number of threads may read it at
+// once without locking.  POSIX only.
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "avlt_file.h"
+
+using namespace std;
+
+template<typename KeyT, typename ValueT>
+class mapped_avlt
+{
+private:
+  void*         Base;    // start of the mapping (nullptr if not open)
+  size_t        Bytes;   // length of the mapping
+  const KeyT*   Keys;    // Keys[0..N-1] in order
+  const ValueT* Values;  // Values[i] belongs to Keys[i]
+  size_t        N;
+
+  //
+  // _lowerBound: index of the first key >= key, N if none.
+  //
+  size_t _lowerBound(const KeyT& key) const
+  {
+    return (size_t) (std::lower_bound(Keys, Keys + N, key) - Keys);
+  }
+
+public:
+  static_assert(is_trivially_copyable<KeyT>::value && is_trivially_copyable<ValueT>::value,
+                "mapped_avlt needs trivially copyable keys and values");
+
+  //
+  // default constructor:
+  //
+  // Creates a closed view; see open().
+  //
+  mapped_avlt()
+    : Base(nullptr), Bytes(0), Keys(nullptr), Values(nullptr), N(0)
+  { }
+
+  mapped_avlt(const mapped_avlt&) = delete;
+  mapped_avlt& operator=(const mapped_avlt&) = delete;
+
+  virtual ~mapped_avlt()
+  {
+    close();
+  }
+
+  //
+  // open
+  //
+  // Maps the snapshot file at "path", closing any file already open.
+  // Returns false if the file cannot be mapped or was not written for
+  // these key / value types.
+  //
+  // Time complexity:  O(1)
+  //
+  bool open(const string& path)
+  {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(avlt_file_header))
+    {
+      ::close(fd);
+      return false;
+    }
+
+    size_t bytes = (size_t) info.st_size;
+    void* base = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file alive
+
+    if (base == MAP_FAILED)
+      return false;
+
+    const avlt_file_header* header = static_cast<const avlt_file_header*>(base);
+
+    if (!avlt_file_check<KeyT, ValueT>(*header, bytes))
+    {
+      munmap(base, bytes);
+      return false;
+    }
+
+    const char* at = static_cast<const char*>(base);
+
+    Base = base;
+    Bytes = bytes;
+    N = (size_t) header->Count;
+    Keys = reinterpret_cast<const KeyT*>(at + header->KeysAt);
+    Values = reinterpret_cast<const ValueT*>(at + header->ValuesAt);
+
+    return true;
+  }
+
+  //
+  // close
+  //
+  // Unmaps the file; the view is empty afterwards.
+  //
+  void close()
+  {
+    if (Base != nullptr)
+      munmap(Base, Bytes);
+
+    Base = nullptr;
+    Bytes = 0;
+    Keys = nullptr;
+    Values = nullptr;
+    N = 0;
+  }
+
+  bool is_open() const
+  {
+    return Base != nullptr;
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of keys in the snapshot, 0 if not open.
+  //
+  // Time complexity:  O(1)
+  //
+  size_t size() const
+  {
+    return N;
+  }
+
+  //
+  // search:
+  //
+  // Searches for the given key, returning true if found and false if
+  // not.  If the key is found, the corresponding value is returned via
+  // the reference parameter.
+  //
+  // Time complexity:  O(lgN)
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    size_t i = _lowerBound(key);
+
+    if (i == N || key < Keys[i])
+      return false;
+
+    value = Values[i];
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key; if the key is not found,
+  // the default value ValueT{} is returned.
+  //
+  // Time complexity:  O(lgN)
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    ValueT value{ };
+
+    search(key, value);
+    return value;
+  }
+
+  //
+  // range_for_each
+  //
+  // Calls visit(key, value) for every key in [lower..upper], inclusive,
+  // in order.
+  //
+  // Time complexity:  O(lgN + M), where M is the # of keys in the range
+  //
+  template<typename Visit>
+  void range_for_each(const KeyT& lower, const KeyT& upper, Visit visit) const
+  {
+    for (size_t i = _lowerBound(lower); i < N && !(upper < Keys[i]); ++i)
+      visit(Keys[i], Values[i]);
+  }
+
+  //
+  // range_search
+  //
+  // Returns the keys in [lower..upper], inclusive, in order.
+  //
+  // Time complexity:  O(lgN + M), where M is the # of keys in the range
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper, [&keys](const KeyT& key, const ValueT&)
+      { keys.push_back(key); });
+
+    return keys;
+  }
+};
@@ -0,0 +1,571 @@
+/*sharded_avlt.h*/
+
+//
+// Key-range sharded threaded AVL tree.
+//
+// The key space is cut into N ranges by N-1 split keys, and each range
+// is an independent avlt with its own lock.  Point operations lock only
+// the shard owning the key, so writers working on different ranges
+// never contend, and rotations in one shard never touch another
+// shard's cache lines.  Ordered iteration and range_search visit the
+// shards in key order.
+//
+// When the data drifts and one shard grows much larger than the others,
+// rebalance() moves the split keys so that every shard holds about the
+// same number of keys.
+//
+// Point operations find their shard through a plain atomic pointer to
+// the split keys; no reference count or global lock is touched.  As in
+// concurrent_avlt, an operation pins an epoch in a reader slot of its
+// own while it holds that pointer, and rebalance() frees a replaced
+// array once no pinned epoch can still see it.
+//
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <new>
+#include <thread>
+#include <functional>
+#include <cstdint>
+
+#include "avlt.h"
+
+using namespace std;
+
+template<typename KeyT, typename ValueT>
+class sharded_avlt
+{
+private:
+  //
+  // each shard on cache lines of its own, so that locking one doesn't
+  // disturb a writer working in the next:
+  //
+  struct alignas(64) SHARD
+  {
+    std::mutex         Lock;
+    avlt<KeyT, ValueT> Tree;
+  };
+
+  //
+  // LINES:
+  //
+  // n default-constructed T's, the first starting on a cache line.
+  // Before C++17 new[] need not honor alignas(64), so we place them in
+  // a buffer of our own.
+  //
+  template<typename T>
+  class LINES
+  {
+    unique_ptr<char[]> Raw;
+    T*                 Items;
+    int                N;
+
+  public:
+    explicit LINES(int n)
+      : Raw(new char[n * sizeof(T) + 63]), Items(nullptr), N(0)
+    {
+      Items = reinterpret_cast<T*>(((uintptr_t) Raw.get() + 63) & ~(uintptr_t) 63);
+
+      try
+      {
+        for (; N < n; ++N)
+          new (Items + N) T();
+      }
+      catch (...)  // Raw is freed on the way out
+      {
+        while (N > 0)
+          Items[--N].~T();
+        throw;
+      }
+    }
+
+    ~LINES()
+    {
+      while (N > 0)
+        Items[--N].~T();
+    }
+
+    LINES(const LINES&) = delete;
+    LINES& operator=(const LINES&) = delete;
+
+    T& operator[](int i) const
+    {
+      return Items[i];
+    }
+  };
+
+  typedef vector<KeyT> BOUNDS;
+
+  //
+  // one reader slot per cache line, so that operations on different
+  // cores don't invalidate each other when they pin and unpin:
+  //
+  struct alignas(64) SLOT
+  {
+    std::atomic<uint64_t> Epoch;  // 0 => not pinned
+
+    SLOT() : Epoch(0) { }
+  };
+
+  static const int MAX_SLOTS = 128;
+
+  //
+  // a bounds array replaced by rebalance(), freed once no operation can
+  // still see the epoch it was retired in:
+  //
+  struct RETIRED
+  {
+    uint64_t                 Epoch;
+    unique_ptr<const BOUNDS> Keys;
+  };
+
+  int                        Count;    // # of shards
+  LINES<SHARD>               Shards;
+  std::atomic<const BOUNDS*> Bounds;   // split keys; shard i holds [Bounds[i-1], Bounds[i])
+  unique_ptr<const BOUNDS>   Current;  // owns *Bounds
+  std::atomic<uint64_t>      Epoch;    // global epoch, starts at 1
+  LINES<SLOT>                Slots;    // pinned by operations, even on a const container
+  vector<RETIRED>            Retired;  // only touched with every shard locked
+
+  static int _shardOf(const BOUNDS& bounds, const KeyT& key)
+  {
+    return (int) (std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin());
+  }
+
+  //
+  // _pin / _unpin:
+  //
+  // Announces that this operation may hold a pointer to the current
+  // bounds array.  Threads hash their id to a starting slot, so in the
+  // common case each core claims its own cache line.
+  //
+  int _pin() const
+  {
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    for (size_t i = 0; ; ++i)
+    {
+      int s = (int) ((start + i) % MAX_SLOTS);
+      uint64_t idle = 0;
+      uint64_t now = Epoch.load();
+
+      if (Slots[s].Epoch.compare_exchange_strong(idle, now))
+        return s;
+
+      if (i % MAX_SLOTS == MAX_SLOTS - 1)  // every slot busy, give way
+        std::this_thread::yield();
+    }
+  }
+
+  void _unpin(int s) const
+  {
+    Slots[s].Epoch.store(0);
+  }
+
+  //
+  // PIN: holds a slot from construction until unpin() or scope exit.
+  //
+  struct PIN
+  {
+    const sharded_avlt* Owner;
+    int                 Slot;
+
+    explicit PIN(const sharded_avlt* owner)
+      : Owner(owner), Slot(owner->_pin())
+    { }
+
+    ~PIN()
+    {
+      unpin();
+    }
+
+    void unpin()
+    {
+      if (Slot >= 0)
+        Owner->_unpin(Slot);
+      Slot = -1;
+    }
+  };
+
+  //
+  // _reclaim:
+  //
+  // Frees every retired bounds array whose epoch is older than the
+  // oldest epoch still pinned.  Called with every shard locked.
+  //
+  void _reclaim()
+  {
+    uint64_t oldest = UINT64_MAX;
+
+    for (int s = 0; s < MAX_SLOTS; ++s)
+    {
+      uint64_t e = Slots[s].Epoch.load();
+      if (e != 0 && e < oldest)
+        oldest = e;
+    }
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < Retired.size(); ++i)
+    {
+      if (Retired[i].Epoch >= oldest)
+      {
+        if (kept != i)
+          Retired[kept] = std::move(Retired[i]);
+        kept++;
+      }
+    }
+
+    Retired.resize(kept);  // drops the rest
+  }
+
+  //
+  // _lockFor:
+  //
+  // Locks and returns the shard that owns the key.  rebalance() may move
+  // the split keys between our lookup and our lock, in which case we
+  // simply try again.  Bounds only changes with every shard locked, so
+  // once we hold a lock an unchanged pointer means our shard is right;
+  // we stay pinned until that check, so the array can't have been
+  // freed and its address reused.
+  //
+  SHARD& _lockFor(const KeyT& key, std::unique_lock<std::mutex>& guard) const
+  {
+    for (;;)
+    {
+      PIN pin(this);
+      const BOUNDS* bounds = Bounds.load();
+      SHARD& shard = Shards[_shardOf(*bounds, key)];
+
+      guard = std::unique_lock<std::mutex>(shard.Lock);
+
+      bool current = (Bounds.load() == bounds);
+      pin.unpin();
+
+      if (current)
+        return shard;
+
+      guard.unlock();
+    }
+  }
+
+  //
+  // _lockRange:
+  //
+  // Locks shards first..last in order, released when the returned
+  // guards go out of scope (including by exception).
+  //
+  vector<std::unique_lock<std::mutex>> _lockRange(int first, int last) const
+  {
+    vector<std::unique_lock<std::mutex>> guards;
+
+    guards.reserve(last - first + 1);
+    for (int i = first; i <= last; ++i)
+      guards.push_back(std::unique_lock<std::mutex>(Shards[i].Lock));
+
+    return guards;
+  }
+
+  vector<std::unique_lock<std::mutex>> _lockAll() const
+  {
+    return _lockRange(0, Count - 1);
+  }
+
+public:
+  //
+  // constructor:
+  //
+  // Creates "shards" empty shards.  Until the first rebalance() every
+  // key goes to the first shard, unless split keys are given: with
+  // splitters s[0] < s[1] < ... shard i holds [s[i-1], s[i]).
+  //
+  explicit sharded_avlt(int shards, const vector<KeyT>& splitters = vector<KeyT>())
+    : Count(max(shards, 1)), Shards(max(shards, 1)), Bounds(nullptr), Epoch(1), Slots(MAX_SLOTS)
+  {
+    BOUNDS bounds(splitters);
+
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    if ((int) bounds.size() > Count - 1)
+      bounds.resize(Count - 1);
+
+    Current.reset(new BOUNDS(bounds));
+    Bounds.store(Current.get());
+  }
+
+  sharded_avlt(const sharded_avlt&) = delete;
+  sharded_avlt& operator=(const sharded_avlt&) = delete;
+
+  //
+  // shards:
+  //
+  // Returns the # of shards.
+  //
+  int shards() const
+  {
+    return Count;
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of keys across all shards.  Each shard is counted
+  // under its own lock, so with concurrent writers this is a moment in
+  // time per shard rather than for the whole container.
+  //
+  int size() const
+  {
+    int total = 0;
+
+    for (int i = 0; i < Count; ++i)
+    {
+      std::lock_guard<std::mutex> guard(Shards[i].Lock);
+      total += Shards[i].Tree.size();
+    }
+
+    return total;
+  }
+
+  //
+  // shard_sizes:
+  //
+  // Returns the # of keys in each shard, in key order.
+  //
+  vector<int> shard_sizes() const
+  {
+    vector<int> sizes;
+
+    for (int i = 0; i < Count; ++i)
+    {
+      std::lock_guard<std::mutex> guard(Shards[i].Lock);
+      sizes.push_back(Shards[i].Tree.size());
+    }
+
+    return sizes;
+  }
+
+  //
+  // insert / erase / search / []
+  //
+  // Same contracts as avlt; each locks only the owning shard.
+  //
+  // Time complexity:  O(lg S + lgN) for S shards
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    std::unique_lock<std::mutex> guard;
+    _lockFor(key, guard).Tree.insert(key, value);
+  }
+
+  bool erase(const KeyT& key)
+  {
+    std::unique_lock<std::mutex> guard;
+    return _lockFor(key, guard).Tree.erase(key);
+  }
+
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    std::unique_lock<std::mutex> guard;
+    return _lockFor(key, guard).Tree.search(key, value);
+  }
+
+  ValueT operator[](const KeyT& key) const
+  {
+    std::unique_lock<std::mutex> guard;
+    return _lockFor(key, guard).Tree[key];
+  }
+
+  //
+  // range_for_each
+  //
+  // Calls visit(key, value) for every key in [lower..upper], in order.
+  // Only the shards overlapping the range are locked, all of them for
+  // the duration of the scan, so the result is consistent.
+  //
+  // Time complexity:  O(S lgN + M)
+  //
+  template<typename Visitor>
+  void range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    for (;;)
+    {
+      PIN pin(this);
+      const BOUNDS* bounds = Bounds.load();
+      int first = _shardOf(*bounds, lower);
+      int last = _shardOf(*bounds, upper);
+
+      auto guards = _lockRange(first, last);
+
+      bool current = (Bounds.load() == bounds);
+      pin.unpin();
+
+      //
+      // the bounds can't move while we hold these locks, so if they
+      // still match we scan once and are done:
+      //
+      if (current)
+      {
+        for (int i = first; i <= last; ++i)
+          Shards[i].Tree.range_for_each(lower, upper, visit);
+
+        return;
+      }
+    }
+  }
+
+  //
+  // range_search
+  //
+  // Returns the keys in [lower..upper], in order, across shards.
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper,
+      [&keys](const KeyT& key, const ValueT&) { keys.push_back(key); });
+
+    return keys;
+  }
+
+  //
+  // for_each
+  //
+  // Calls visit(key, value) for every key in the container, in order,
+  // holding all shard locks for a consistent view.
+  //
+  // Time complexity:  O(N)
+  //
+  template<typename Visitor>
+  void for_each(Visitor visit) const
+  {
+    auto guards = _lockAll();
+
+    for (int i = 0; i < Count; ++i)
+      for (auto it = Shards[i].Tree.cbegin(); it != Shards[i].Tree.cend(); ++it)
+        visit(it.key(), it.value());
+  }
+
+  //
+  // skew
+  //
+  // Returns the largest shard size divided by the average shard size:
+  // 1.0 means perfectly even, S means everything is in one shard.
+  //
+  double skew() const
+  {
+    vector<int> sizes = shard_sizes();
+    int total = 0;
+    int largest = 0;
+
+    for (int n : sizes)
+    {
+      total += n;
+      largest = max(largest, n);
+    }
+
+    if (total == 0)
+      return 1.0;
+
+    return (double) largest * Count / total;
+  }
+
+  //
+  // rebalance
+  //
+  // Moves the split keys so every shard holds about N/S keys, and
+  // rebuilds each shard with avlt::assign_sorted.  Blocks all other
+  // operations while it runs.
+  //
+  // Time complexity:  O(N)
+  //
+  void rebalance()
+  {
+    auto guards = _lockAll();
+
+    vector<pair<KeyT, ValueT>> all;
+
+    for (int i = 0; i < Count; ++i)
+    {
+      for (auto it = Shards[i].Tree.cbegin(); it != Shards[i].Tree.cend(); ++it)
+        all.push_back(make_pair(it.key(), it.value()));
+    }
+
+    //
+    // cut the keys into S nearly equal, non-empty pieces; with fewer
+    // keys than shards the last shards stay empty.  The new shards are
+    // built on the side, so if an allocation throws the old ones are
+    // left as they were:
+    //
+    BOUNDS bounds;
+    vector<avlt<KeyT, ValueT>> fresh(Count);
+    size_t start = 0;
+    int    used = 0;
+
+    for (int i = 0; i < Count; ++i)
+    {
+      size_t end = all.size() * (i + 1) / Count;
+      if (end == start)
+        continue;
+
+      if (used > 0)
+        bounds.push_back(all[start].first);
+
+      fresh[used++].assign_sorted(all.begin() + start, all.begin() + end);
+      start = end;
+    }
+
+    unique_ptr<const BOUNDS> published(new BOUNDS(bounds));
+    Retired.reserve(Retired.size() + 1);
+
+    //
+    // nothing below throws.  An operation pinned at an epoch after the
+    // one we retire the old array in loaded Bounds after our store:
+    //
+    for (int i = 0; i < Count; ++i)
+      Shards[i].Tree.swap(fresh[i]);
+
+    Retired.push_back(RETIRED{ Epoch.load(), std::move(Current) });
+    Current = std::move(published);
+    Bounds.store(Current.get());
+    Epoch.fetch_add(1);
+
+    _reclaim();
+  }
+
+  //
+  // rebalance_if_skewed
+  //
+  // Calls rebalance() if the largest shard is more than "factor" times
+  // the average; returns true if it did.
+  //
+  bool rebalance_if_skewed(double factor)
+  {
+    if (skew() <= factor)
+      return false;
+
+    rebalance();
+    return true;
+  }
+
+  //
+  // retired:
+  //
+  // Returns the # of replaced bounds arrays still waiting for pinned
+  // operations to move on before they can be freed.
+  //
+  size_t retired()
+  {
+    auto guards = _lockAll();
+
+    _reclaim();
+    return Retired.size();
+  }
+};
@@ -0,0 +1,93 @@
+/*test02.cpp*/
+
+//
+// Unit tests for range_search on the threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(10) range_search follows the threads")
+{
+  avlt<int, int>  tree;
+
+  vector<int> keys = { 30, 10, 96, 5, 15, 85, 110, 64, 90, 36 };
+
+  for (int key : keys)
+  {
+    tree.insert(key, -key);
+  }
+
+  REQUIRE(tree.range_search(10, 64) == vector<int>({ 10, 15, 30, 36, 64 }));
+  REQUIRE(tree.range_search(11, 63) == vector<int>({ 15, 30, 36 }));
+  REQUIRE(tree.range_search(0, 4).empty());
+  REQUIRE(tree.range_search(111, 200).empty());
+  REQUIRE(tree.range_search(110, 110) == vector<int>({ 110 }));
+  REQUIRE(tree.range_search(-1000, 1000).size() == keys.size());
+}
+
+TEST_CASE("(11) range_search on sparse 64-bit and string keys")
+{
+  avlt<int64_t, int>  tree;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    tree.insert((int64_t) i << 40, i);
+  }
+
+  vector<int64_t> found = tree.range_search(INT64_MIN, INT64_MAX);
+  REQUIRE(found.size() == 1000);
+  REQUIRE(found.front() == 0);
+  REQUIRE(found.back() == (int64_t) 999 << 40);
+
+  avlt<string, int>  words;
+
+  vector<string> keys = { "pear", "apple", "fig", "kiwi", "banana", "grape" };
+
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    words.insert(keys[i], (int) i);
+  }
+
+  REQUIRE(words.range_search("b", "h") == vector<string>({ "banana", "fig", "grape" }));
+}
+
+TEST_CASE("(12) range_for_each streams keys and values")
+{
+  avlt<int, int>  tree;
+
+  for (int key = 0; key < 100; key += 3)
+  {
+    tree.insert(key, key * 2);
+  }
+
+  int count = 0;
+  int sum = 0;
+  int last = -1;
+  bool ordered = true;
+
+  tree.range_for_each(20, 40, [&](const int& key, const int& value)
+  {
+    ordered = ordered && (key > last);
+    last = key;
+    sum += value;
+    count++;
+  });
+
+  REQUIRE(ordered);
+  REQUIRE(count == 7);  // 21, 24, ..., 39
+  REQUIRE(sum == 2 * (21 + 24 + 27 + 30 + 33 + 36 + 39));
+
+  vector<int> out;
+  tree.range_search(0, 9, back_inserter(out));
+  REQUIRE(out == vector<int>({ 0, 3, 6, 9 }));
+}
@@ -0,0 +1,67 @@
+/*test03.cpp*/
+
+//
+// Unit tests for the pooled node allocation of the threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(13) clear and reuse a pooled tree")
+{
+  avlt<int, int>  tree;
+
+  for (int round = 0; round < 3; ++round)
+  {
+    for (int key = 0; key < 5000; ++key)
+    {
+      tree.insert((key * 7919) % 5000, key);
+    }
+
+    REQUIRE(tree.size() == 5000);
+    REQUIRE(tree.height() <= 17);  // 1.44 * lg(5000)
+
+    int value;
+    REQUIRE(tree.search(4999, value));
+    REQUIRE(!tree.search(5000, value));
+
+    tree.clear();
+
+    REQUIRE(tree.size() == 0);
+    REQUIRE(tree.height() == -1);
+    REQUIRE(!tree.search(0, value));
+  }
+}
+
+TEST_CASE("(14) pooled tree with non-trivial keys and values")
+{
+  avlt<string, vector<int>>  tree;
+
+  for (int i = 0; i < 300; ++i)
+  {
+    tree.insert("key" + to_string(i), vector<int>(i % 5, i));
+  }
+
+  REQUIRE(tree.size() == 300);
+  REQUIRE(tree["key42"] == vector<int>(2, 42));
+
+  avlt<string, vector<int>>  copy(tree);
+
+  tree.clear();
+  REQUIRE(tree.size() == 0);
+
+  REQUIRE(copy.size() == 300);
+  REQUIRE(copy["key299"] == vector<int>(4, 299));
+
+  tree.insert("again", vector<int>(1, 1));
+  REQUIRE(tree.size() == 1);
+  REQUIRE(tree["again"] == vector<int>(1, 1));
+}
@@ -0,0 +1,92 @@
+/*test04.cpp*/
+
+//
+// Unit tests for building a threaded AVL tree from sorted input
+//
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(15) assign_sorted builds a balanced threaded tree")
+{
+  for (int n : { 0, 1, 2, 3, 7, 8, 100, 1023, 1024, 5000 })
+  {
+    vector<pair<int, int>> pairs;
+
+    for (int i = 0; i < n; ++i)
+    {
+      pairs.push_back(make_pair(i * 2, -i));
+    }
+
+    avlt<int, int>  tree(pairs.begin(), pairs.end());
+
+    REQUIRE(tree.size() == n);
+
+    int expected = -1;
+    while ((1 << (expected + 1)) <= n)
+      expected++;
+    REQUIRE(tree.height() == expected);
+
+    int value;
+    for (int i = 0; i < n; ++i)
+    {
+      REQUIRE(tree.search(i * 2, value));
+      REQUIRE(value == -i);
+      REQUIRE(!tree.search(i * 2 + 1, value));
+    }
+
+    //
+    // the threads must give back every key in order:
+    //
+    vector<int> keys = tree.range_search(-1, 2 * n);
+    REQUIRE(keys.size() == (size_t) n);
+    for (int i = 0; i < n; ++i)
+    {
+      REQUIRE(keys[i] == i * 2);
+    }
+
+    //
+    // and the tree is still a normal AVL tree afterwards:
+    //
+    for (int i = 0; i < n; ++i)
+    {
+      tree.insert(i * 2 + 1, i);
+    }
+    REQUIRE(tree.size() == 2 * n);
+    REQUIRE(tree.range_search(-1, 2 * n).size() == (size_t) (2 * n));
+  }
+}
+
+TEST_CASE("(16) assign_sorted with duplicates, maps and unsorted input")
+{
+  vector<pair<int, int>> pairs = { {1, 10}, {1, 11}, {2, 20}, {3, 30}, {3, 31} };
+
+  avlt<int, int>  tree;
+  tree.assign_sorted(pairs.begin(), pairs.end());
+
+  REQUIRE(tree.size() == 3);
+  REQUIRE(tree[1] == 10);
+  REQUIRE(tree[3] == 30);
+
+  map<string, int> words = { {"b", 2}, {"a", 1}, {"c", 3} };
+  avlt<string, int>  wtree(words.begin(), words.end());
+
+  REQUIRE(wtree.size() == 3);
+  REQUIRE(wtree.range_search("a", "z") == vector<string>({ "a", "b", "c" }));
+
+  vector<pair<int, int>> unsorted = { {5, 5}, {6, 6}, {1, 1}, {9, 9}, {3, 3} };
+  tree.assign_sorted(unsorted.begin(), unsorted.end());
+
+  REQUIRE(tree.size() == 5);
+  REQUIRE(tree.range_search(0, 10) == vector<int>({ 1, 3, 5, 6, 9 }));
+}
@@ -0,0 +1,239 @@
+/*test05.cpp*/
+
+//
+// Unit tests for erase, erase_range and erase_batch
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <cstdlib>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// checks the tree against the reference set: same keys, same order
+// through the threads, and a height within the AVL bound.
+//
+static void checkAgainst(avlt<int, int>& tree, const set<int>& expected)
+{
+  REQUIRE(tree.size() == (int) expected.size());
+
+  vector<int> keys = tree.range_search(INT32_MIN, INT32_MAX);
+  REQUIRE(keys == vector<int>(expected.begin(), expected.end()));
+
+  vector<int> walked;
+  int key;
+  tree.begin();
+  while (tree.next(key))
+    walked.push_back(key);
+  REQUIRE(walked == keys);
+
+  int n = (int) expected.size();
+  REQUIRE(tree.height() <= (int) (1.45 * log2(n + 2)));
+
+  int value;
+  for (int k : expected)
+  {
+    REQUIRE(tree.search(k, value));
+    REQUIRE(value == -k);
+  }
+}
+
+
+TEST_CASE("(17) erase from small trees")
+{
+  avlt<int, int>  tree;
+
+  REQUIRE(!tree.erase(5));
+
+  vector<int> keys = { 30, 10, 96, 5, 15, 85, 110, 64, 90, 36 };
+  set<int> expected(keys.begin(), keys.end());
+
+  for (int key : keys)
+  {
+    tree.insert(key, -key);
+  }
+
+  REQUIRE(!tree.erase(31));
+
+  //
+  // leaf, one child, two children, the root:
+  //
+  for (int key : { 5, 110, 85, 30, 10, 96, 15, 64, 90, 36 })
+  {
+    REQUIRE(tree.erase(key));
+    expected.erase(key);
+    checkAgainst(tree, expected);
+  }
+
+  REQUIRE(tree.height() == -1);
+}
+
+TEST_CASE("(18) random insert and erase against std::set")
+{
+  avlt<int, int>  tree;
+  set<int> expected;
+
+  srand(251);
+
+  for (int i = 0; i < 4000; ++i)
+  {
+    int key = rand() % 1000;
+
+    if (rand() % 3 == 0)
+    {
+      REQUIRE(tree.erase(key) == (expected.erase(key) == 1));
+    }
+    else
+    {
+      tree.insert(key, -key);
+      expected.insert(key);
+    }
+
+    if (i % 500 == 0)
+      checkAgainst(tree, expected);
+  }
+
+  checkAgainst(tree, expected);
+}
+
+TEST_CASE("(19) erase_range and erase_batch")
+{
+  avlt<int, int>  tree;
+  set<int> expected;
+
+  for (int key = 0; key < 2000; ++key)
+  {
+    tree.insert(key, -key);
+    expected.insert(key);
+  }
+
+  //
+  // a few keys (one erase each) and then many (rebuild):
+  //
+  REQUIRE(tree.erase_range(100, 104) == 5);
+  expected.erase(expected.find(100), expected.find(105));
+  checkAgainst(tree, expected);
+
+  REQUIRE(tree.erase_range(500, 1499) == 1000);
+  expected.erase(expected.find(500), expected.find(1500));
+  checkAgainst(tree, expected);
+
+  REQUIRE(tree.erase_range(3000, 4000) == 0);
+
+  vector<int> few = { 0, 7, 50, 5000 };
+  REQUIRE(tree.erase_batch(few) == 3);
+  for (int k : few)
+    expected.erase(k);
+  checkAgainst(tree, expected);
+
+  vector<int> many;
+  for (int key = 1; key < 2100; key += 2)
+    many.push_back(key);
+
+  int removed = 0;
+  for (int k : many)
+    removed += (int) expected.erase(k);
+
+  REQUIRE(tree.erase_batch(many) == removed);
+  checkAgainst(tree, expected);
+
+  //
+  // and the tree keeps working afterwards:
+  //
+  for (int key = 0; key < 2000; key += 5)
+  {
+    tree.insert(key, -key);
+    expected.insert(key);
+  }
+  checkAgainst(tree, expected);
+}
+
+TEST_CASE("(66) erase_range and erase_batch keep counts, sums and the cursor")
+{
+  avlt<int, int, true, avlt_sum<int>>  tree;
+  set<int> expected;
+
+  srand(66);
+
+  for (int i = 0; i < 3000; ++i)
+  {
+    int key = rand() % 10000;
+    tree.insert(key, key);
+    expected.insert(key);
+  }
+
+  for (int round = 0; round < 200; ++round)
+  {
+    int lower = rand() % 10000;
+    int upper = lower + rand() % 60;
+
+    auto from = expected.lower_bound(lower);
+    auto to = expected.upper_bound(upper);
+    int n = (int) distance(from, to);
+    expected.erase(from, to);
+
+    REQUIRE(tree.erase_range(lower, upper) == n);
+
+    vector<int> batch;
+    for (int j = 0; j < 5; ++j)
+      batch.push_back(rand() % 10000);
+    sort(batch.begin(), batch.end());
+    batch.erase(unique(batch.begin(), batch.end()), batch.end());
+
+    n = 0;
+    for (int k : batch)
+      n += (int) expected.erase(k);
+
+    REQUIRE(tree.erase_batch(batch) == n);
+  }
+
+  REQUIRE(tree.size() == (int) expected.size());
+  REQUIRE(tree.count_range(INT32_MIN, INT32_MAX) == (int) expected.size());
+  REQUIRE(tree.height() <= (int) (1.45 * log2(expected.size() + 2)));
+
+  int sum = 0, rank = 0;
+  for (int k : expected)
+  {
+    REQUIRE(tree.rank(k) == rank++);
+    sum += k;
+  }
+  REQUIRE(tree.aggregate(INT32_MIN, INT32_MAX) == sum);
+  REQUIRE(tree.range_search(INT32_MIN, INT32_MAX) == vector<int>(expected.begin(), expected.end()));
+
+  //
+  // a begin()/next() traversal goes on past keys erased under it:
+  //
+  avlt<int, int>  walk;
+  for (int key = 0; key < 100; ++key)
+    walk.insert(key, key);
+
+  int key;
+  walk.begin();
+  REQUIRE(walk.next(key));
+  REQUIRE(walk.next(key));  // the cursor is on 2 now
+  REQUIRE(walk.erase_range(1, 10) == 10);
+  REQUIRE(walk.next(key));
+  REQUIRE(key == 11);
+
+  vector<int> batch = { 12, 13, 15 };
+  REQUIRE(walk.erase_batch(batch) == 3);
+  REQUIRE(walk.next(key));
+  REQUIRE(key == 14);
+  REQUIRE(walk.next(key));
+  REQUIRE(key == 16);
+
+  REQUIRE(walk.erase_range(17, 1000) == 83);
+  REQUIRE(!walk.next(key));
+  REQUIRE(walk.erase_range(5, 4) == 0);
+  REQUIRE(walk.size() == 4);
+}
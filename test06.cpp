@@ -0,0 +1,119 @@
+/*test06.cpp*/
+
+//
+// Unit tests for the external iterators of the threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(20) iterators walk the keys in order")
+{
+  avlt<int, int>  tree;
+
+  REQUIRE(tree.begin() == tree.end());
+
+  vector<int> keys = { 55, 48, 64, 38, 51, 60, 78, 16, 40, 45 };
+
+  for (int key : keys)
+  {
+    tree.insert(key, -key);
+  }
+
+  vector<int> walked;
+  for (int key : tree)
+    walked.push_back(key);
+
+  vector<int> sorted = keys;
+  sort(sorted.begin(), sorted.end());
+  REQUIRE(walked == sorted);
+
+  REQUIRE(distance(tree.begin(), tree.end()) == (ptrdiff_t) keys.size());
+  REQUIRE(is_sorted(tree.begin(), tree.end()));
+
+  //
+  // values through the iterator, writable through a non-const one:
+  //
+  for (auto it = tree.begin(); it != tree.end(); ++it)
+  {
+    REQUIRE(it.value() == -*it);
+    it.value() = *it * 10;
+  }
+  REQUIRE(tree[45] == 450);
+}
+
+TEST_CASE("(21) find, lower_bound and independent scans on a const tree")
+{
+  avlt<int, int>  tree;
+
+  for (int key = 0; key < 100; key += 10)
+  {
+    tree.insert(key, key);
+  }
+
+  const avlt<int, int>& ctree = tree;
+
+  REQUIRE(ctree.find(30) != ctree.end());
+  REQUIRE(*ctree.find(30) == 30);
+  REQUIRE(ctree.find(31) == ctree.end());
+
+  REQUIRE(*ctree.lower_bound(31) == 40);
+  REQUIRE(*ctree.lower_bound(40) == 40);
+  REQUIRE(ctree.lower_bound(91) == ctree.end());
+
+  //
+  // two scans at once, neither disturbing the other:
+  //
+  avlt<int, int>::const_iterator a = ctree.begin();
+  avlt<int, int>::const_iterator b = ctree.lower_bound(50);
+
+  int pairs = 0;
+  while (b != ctree.end())
+  {
+    REQUIRE(*b - *a == 50);
+    ++a;
+    b++;
+    pairs++;
+  }
+  REQUIRE(pairs == 5);
+
+  //
+  // the old begin()/next() interface still works alongside:
+  //
+  int key;
+  tree.begin();
+  REQUIRE(tree.next(key));
+  REQUIRE(key == 0);
+  REQUIRE(tree.next(key));
+  REQUIRE(key == 10);
+
+  avlt<int, int>::const_iterator c = tree.find(70);
+  REQUIRE(c.key() == 70);
+}
+
+TEST_CASE("(22) dump leaves the threads intact")
+{
+  avlt<int, int>  tree;
+
+  for (int key : { 100, 50, 150, 25, 75, 175, 200 })
+  {
+    tree.insert(key, -key);
+  }
+
+  stringstream out;
+  tree.dump(out);
+  tree.dump(out);
+
+  REQUIRE(tree.range_search(0, 1000) == vector<int>({ 25, 50, 75, 100, 150, 175, 200 }));
+}
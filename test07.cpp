@@ -0,0 +1,127 @@
+/*test07.cpp*/
+
+//
+// Unit tests for the single-writer, lock-free-reader AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "concurrent_avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(23) concurrent_avlt behaves like an AVL tree")
+{
+  concurrent_avlt<int, int>  tree;
+
+  REQUIRE(tree.size() == 0);
+  REQUIRE(tree.height() == -1);
+
+  for (int key = 0; key < 1000; ++key)
+  {
+    tree.insert(key, -key);
+  }
+  tree.insert(500, 0);  // duplicate, ignored
+
+  REQUIRE(tree.size() == 1000);
+  REQUIRE(tree.height() <= 14);  // 1.44 * lg(1000)
+
+  int value;
+  REQUIRE(tree.search(500, value));
+  REQUIRE(value == -500);
+  REQUIRE(!tree.search(1000, value));
+  REQUIRE(tree[999] == -999);
+  REQUIRE(tree[-1] == 0);
+
+  REQUIRE(tree.range_search(10, 15) == vector<int>({ 10, 11, 12, 13, 14, 15 }));
+
+  //
+  // with no readers around, everything replaced has been freed:
+  //
+  REQUIRE(tree.retired() == 0);
+}
+
+TEST_CASE("(24) a pinned reader keeps its snapshot")
+{
+  concurrent_avlt<int, int>  tree;
+
+  for (int key = 0; key < 100; ++key)
+  {
+    tree.insert(key, key);
+  }
+
+  {
+    auto snapshot = tree.read();
+
+    for (int key = 100; key < 200; ++key)
+    {
+      tree.insert(key, key);
+    }
+
+    int value;
+    REQUIRE(snapshot.search(99, value));
+    REQUIRE(!snapshot.search(150, value));
+    REQUIRE(tree.search(150, value));
+
+    REQUIRE(tree.retired() > 0);  // held back by the snapshot
+  }
+
+  REQUIRE(tree.retired() == 0);
+}
+
+TEST_CASE("(25) readers run concurrently with a writer")
+{
+  concurrent_avlt<int, int>  tree;
+  const int N = 20000;
+
+  std::atomic<bool> done(false);
+  std::atomic<int>  errors(0);
+
+  vector<thread> readers;
+
+  for (int t = 0; t < 4; ++t)
+  {
+    readers.push_back(thread([&]()
+    {
+      while (!done.load())
+      {
+        auto r = tree.read();
+
+        //
+        // inserts happen in increasing order, so whatever version we
+        // see must hold a prefix 0..n-1 of the keys:
+        //
+        int n = 0;
+        int value;
+        r.range_for_each(0, N, [&](const int& key, const int& v)
+        {
+          if (key != n || v != -key)
+            errors++;
+          n++;
+        });
+
+        if (n > 0 && !r.search(n - 1, value))
+          errors++;
+      }
+    }));
+  }
+
+  for (int key = 0; key < N; ++key)
+  {
+    tree.insert(key, -key);
+  }
+
+  done.store(true);
+  for (thread& t : readers)
+    t.join();
+
+  REQUIRE(errors.load() == 0);
+  REQUIRE(tree.size() == N);
+  REQUIRE(tree.retired() == 0);
+}
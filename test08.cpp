@@ -0,0 +1,153 @@
+/*test08.cpp*/
+
+//
+// Unit tests for the key-range sharded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+
+#include "sharded_avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(26) sharded_avlt routes keys by range")
+{
+  sharded_avlt<int, int>  tree(4, { 100, 200, 300 });
+
+  REQUIRE(tree.shards() == 4);
+  REQUIRE(tree.size() == 0);
+
+  for (int key = 0; key < 400; ++key)
+  {
+    tree.insert(key, -key);
+  }
+
+  REQUIRE(tree.size() == 400);
+  REQUIRE(tree.shard_sizes() == vector<int>({ 100, 100, 100, 100 }));
+  REQUIRE(tree.skew() == 1.0);
+
+  int value;
+  REQUIRE(tree.search(250, value));
+  REQUIRE(value == -250);
+  REQUIRE(tree[399] == -399);
+  REQUIRE(!tree.search(400, value));
+
+  //
+  // ranges that cross shard boundaries come back in order:
+  //
+  vector<int> keys = tree.range_search(95, 305);
+  REQUIRE(keys.size() == 211);
+  REQUIRE(keys.front() == 95);
+  REQUIRE(keys.back() == 305);
+  REQUIRE(is_sorted(keys.begin(), keys.end()));
+
+  REQUIRE(tree.erase(200));
+  REQUIRE(!tree.erase(200));
+  REQUIRE(tree.size() == 399);
+
+  int count = 0;
+  int last = -1;
+  bool ordered = true;
+  tree.for_each([&](const int& key, const int&)
+  {
+    ordered = ordered && key > last;
+    last = key;
+    count++;
+  });
+  REQUIRE(ordered);
+  REQUIRE(count == 399);
+
+  //
+  // a visitor that throws leaves no shard locked behind it:
+  //
+  REQUIRE_THROWS(tree.for_each([](const int&, const int&) { throw 1; }));
+  REQUIRE_THROWS(tree.range_for_each(0, 399, [](const int&, const int&) { throw 1; }));
+  tree.insert(200, -200);
+  REQUIRE(tree.size() == 400);
+  REQUIRE(tree.range_search(95, 305).size() == 211);
+}
+
+TEST_CASE("(27) rebalance evens out skewed shards")
+{
+  sharded_avlt<int, int>  tree(4);
+
+  for (int key = 0; key < 1000; ++key)
+  {
+    tree.insert(key, key);
+  }
+
+  REQUIRE(tree.skew() == 4.0);  // everything in the first shard
+
+  REQUIRE(tree.rebalance_if_skewed(1.5));
+  REQUIRE(tree.shard_sizes() == vector<int>({ 250, 250, 250, 250 }));
+  REQUIRE(!tree.rebalance_if_skewed(1.5));
+
+  REQUIRE(tree.size() == 1000);
+  REQUIRE(tree.range_search(0, 999).size() == 1000);
+  REQUIRE(tree[750] == 750);
+
+  //
+  // fewer keys than shards:
+  //
+  sharded_avlt<int, int>  small(8);
+  small.insert(1, 1);
+  small.insert(2, 2);
+  small.rebalance();
+  REQUIRE(small.size() == 2);
+  REQUIRE(small[1] == 1);
+  REQUIRE(small[2] == 2);
+  REQUIRE(small.range_search(0, 10) == vector<int>({ 1, 2 }));
+}
+
+TEST_CASE("(28) concurrent writers on different shards")
+{
+  sharded_avlt<int, int>  tree(8);
+
+  for (int key = 0; key < 8000; key += 8)
+  {
+    tree.insert(key, key);
+  }
+  tree.rebalance();
+
+  vector<thread> writers;
+
+  for (int t = 0; t < 8; ++t)
+  {
+    writers.push_back(thread([&tree, t]()
+    {
+      for (int key = t * 1000; key < (t + 1) * 1000; ++key)
+      {
+        tree.insert(key, key);
+      }
+
+      if (t == 0)
+        tree.rebalance();  // while the others keep writing
+    }));
+  }
+
+  for (thread& w : writers)
+    w.join();
+
+  REQUIRE(tree.size() == 8000);
+
+  //
+  // replaced split keys are freed, not kept for the container's life:
+  //
+  for (int i = 0; i < 100; ++i)
+  {
+    tree.rebalance();
+  }
+  REQUIRE(tree.retired() == 0);
+
+  vector<int> keys = tree.range_search(0, 7999);
+  REQUIRE(keys.size() == 8000);
+  for (int i = 0; i < 8000; ++i)
+  {
+    REQUIRE(keys[i] == i);
+  }
+}
@@ -0,0 +1,275 @@
+/*test09.cpp*/
+
+//
+// Unit tests for the compact, index-based threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include <sstream>
+#include <map>
+#include <utility>
+#include <iterator>
+#include <cstdlib>
+#include <cstdint>
+
+#include "avlt.h"
+#include "compact_avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// checks the compact tree holds exactly the expected keys, with values
+// -key, both through the iterators and the heights avlt would have:
+//
+static void checkCompact(compact_avlt<int, int>& tree, const set<int>& expected)
+{
+  REQUIRE(tree.size() == (int) expected.size());
+  REQUIRE(vector<int>(tree.begin(), tree.end()) == vector<int>(expected.begin(), expected.end()));
+
+  for (auto it = tree.cbegin(); it != tree.cend(); ++it)
+    REQUIRE(it.value() == -it.key());
+
+  avlt<int, int>  reference;
+  for (int key : expected)
+    reference.insert(key, -key);
+
+  for (int key : expected)
+    REQUIRE(tree % key >= 0);
+  REQUIRE(tree.height() <= reference.height() + 1);
+}
+
+
+TEST_CASE("(29) compact_avlt matches avlt heights and threads")
+{
+  vector<int> keys = { 30, 10, 96, 5, 15, 85, 110, 64, 90, 36 };
+  vector<int> heights = { 3, 1, 1, 0, 0, 2, 0, 1, 0, 0 };
+
+  compact_avlt<int, int>  tree;
+  avlt<int, int>  reference;
+
+  for (int key : keys)
+  {
+    tree.insert(key, -key);
+    reference.insert(key, -key);
+  }
+
+  REQUIRE(tree.size() == (int) keys.size());
+  REQUIRE(tree.height() == 3);
+
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    REQUIRE((tree % keys[i]) == heights[i]);
+    REQUIRE(tree[keys[i]] == -keys[i]);
+    REQUIRE(tree(keys[i]) == reference(keys[i]));
+  }
+  REQUIRE(tree % 31 == -1);
+  REQUIRE(tree[31] == 0);
+
+  stringstream a, b;
+  tree.dump(a);
+  reference.dump(b);
+  REQUIRE(a.str().substr(a.str().find("** size")) == b.str().substr(b.str().find("** size")));
+}
+
+TEST_CASE("(30) compact_avlt insert, erase and traversal against std::set")
+{
+  compact_avlt<int, int>  tree;
+  set<int> expected;
+
+  srand(8);
+
+  for (int i = 0; i < 5000; ++i)
+  {
+    int key = rand() % 1500;
+
+    if (rand() % 3 == 0)
+    {
+      REQUIRE(tree.erase(key) == (expected.erase(key) == 1));
+    }
+    else
+    {
+      tree.insert(key, -key);
+      expected.insert(key);
+    }
+  }
+
+  REQUIRE(tree.size() == (int) expected.size());
+  REQUIRE(tree.range_search(INT32_MIN, INT32_MAX) == vector<int>(expected.begin(), expected.end()));
+
+  vector<int> walked;
+  int key;
+  tree.begin();
+  while (tree.next(key))
+    walked.push_back(key);
+  REQUIRE(walked == vector<int>(expected.begin(), expected.end()));
+
+  int value;
+  for (int k : expected)
+  {
+    REQUIRE(tree.search(k, value));
+    REQUIRE(value == -k);
+  }
+
+  //
+  // copies are independent:
+  //
+  compact_avlt<int, int>  copy = tree;
+  tree.clear();
+  REQUIRE(copy.size() == (int) expected.size());
+  REQUIRE(copy.range_search(INT32_MIN, INT32_MAX).size() == expected.size());
+}
+
+TEST_CASE("(31) compact layout uses fewer bytes per entry")
+{
+  REQUIRE(compact_avlt<int, int>::node_bytes() < avlt<int, int>::node_bytes());
+  REQUIRE(compact_avlt<int64_t, int64_t>::node_bytes() < avlt<int64_t, int64_t>::node_bytes());
+}
+
+TEST_CASE("(64) compact_avlt assign_sorted, erase_range and erase_batch")
+{
+  vector<pair<int, int>> pairs;
+  for (int key = 0; key < 2000; ++key)
+    pairs.push_back(make_pair(key, -key));
+
+  compact_avlt<int, int>  tree(pairs.begin(), pairs.end());
+  set<int> expected;
+  for (auto& p : pairs)
+    expected.insert(p.first);
+
+  // a perfectly balanced tree, in exactly as many nodes as keys
+  REQUIRE(tree.height() == 10);
+  checkCompact(tree, expected);
+
+  //
+  // a few keys (one erase each) and then many (rebuild):
+  //
+  REQUIRE(tree.erase_range(100, 104) == 5);
+  expected.erase(expected.find(100), expected.find(105));
+  checkCompact(tree, expected);
+
+  REQUIRE(tree.erase_range(500, 1499) == 1000);
+  expected.erase(expected.find(500), expected.find(1500));
+  checkCompact(tree, expected);
+
+  REQUIRE(tree.erase_range(3000, 4000) == 0);
+
+  vector<int> few = { 0, 7, 50, 5000 };
+  REQUIRE(tree.erase_batch(few) == 3);
+  for (int k : few)
+    expected.erase(k);
+  checkCompact(tree, expected);
+
+  vector<int> many;
+  for (int key = 1; key < 2100; key += 2)
+    many.push_back(key);
+
+  int removed = 0;
+  for (int k : many)
+    removed += (int) expected.erase(k);
+
+  REQUIRE(tree.erase_batch(many) == removed);
+  checkCompact(tree, expected);
+
+  // the freed nodes are reused, and the tree keeps working
+  for (int key = 0; key < 2000; key += 5)
+  {
+    tree.insert(key, -key);
+    expected.insert(key);
+  }
+  checkCompact(tree, expected);
+
+  //
+  // duplicates keep the first value; unsorted input still goes in:
+  //
+  vector<pair<int, int>> dups = { {1, -1}, {1, 5}, {2, -2}, {4, -4}, {3, -3}, {0, 0} };
+  tree.assign_sorted(dups.begin(), dups.end());
+  checkCompact(tree, set<int>{ 0, 1, 2, 3, 4 });
+
+  map<int, int> source = { {10, -10}, {20, -20}, {30, -30} };
+  tree.assign_sorted(source.begin(), source.end());
+  checkCompact(tree, set<int>{ 10, 20, 30 });
+
+  tree.assign_sorted(source.end(), source.end());
+  REQUIRE(tree.size() == 0);
+  REQUIRE(tree.begin() == tree.end());
+}
+
+TEST_CASE("(65) compact_avlt iterators, find, lower_bound and range_search")
+{
+  compact_avlt<int, int>  tree;
+  map<int, int> expected;
+
+  srand(65);
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    int key = rand() % 3000;
+    tree.insert(key, -key);
+    expected.insert(make_pair(key, -key));
+  }
+
+  // iterators survive the node array growing
+  auto first = tree.begin();
+  REQUIRE(first.key() == expected.begin()->first);
+  for (int key = 5000; key < 6000; ++key)
+  {
+    tree.insert(key, -key);
+    expected.insert(make_pair(key, -key));
+  }
+  REQUIRE(first.key() == expected.begin()->first);
+
+  auto it = tree.begin();
+  for (auto& p : expected)
+  {
+    REQUIRE(it != tree.end());
+    REQUIRE(*it == p.first);
+    REQUIRE(it.value() == p.second);
+    it++;
+  }
+  REQUIRE(it == tree.end());
+
+  for (int key = -1; key <= 6001; key += 7)
+  {
+    auto found = tree.find(key);
+    auto lower = tree.lower_bound(key);
+
+    if (expected.count(key) == 1)
+      REQUIRE(found.key() == key);
+    else
+      REQUIRE(found == tree.end());
+
+    if (expected.lower_bound(key) == expected.end())
+      REQUIRE(lower == tree.end());
+    else
+      REQUIRE(lower.key() == expected.lower_bound(key)->first);
+  }
+
+  // values can be changed through an iterator, and read through a const one
+  tree.find(5000).value() = 42;
+  const compact_avlt<int, int>& readOnly = tree;
+  compact_avlt<int, int>::const_iterator c = tree.find(5000);
+  REQUIRE(c.value() == 42);
+  REQUIRE(readOnly.find(5000) == c);
+  REQUIRE(readOnly.lower_bound(4000).key() == 5000);
+  REQUIRE(distance(readOnly.begin(), readOnly.end()) == (long) expected.size());
+
+  // begin() resets the next() cursor as before
+  int key;
+  tree.begin();
+  REQUIRE(tree.next(key));
+  REQUIRE(key == expected.begin()->first);
+
+  // range_search into any output iterator
+  vector<int> keys, want;
+  tree.range_search(1000, 2000, back_inserter(keys));
+  for (auto p = expected.lower_bound(1000); p != expected.upper_bound(2000); ++p)
+    want.push_back(p->first);
+  REQUIRE(keys == want);
+  REQUIRE(tree.range_search(1000, 2000) == want);
+}
@@ -0,0 +1,94 @@
+/*test10.cpp*/
+
+//
+// Unit tests for frozen snapshots of the threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdlib>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(32) freeze gives the same answers as the tree")
+{
+  for (int n : { 0, 1, 2, 5, 31, 32, 33, 1000 })
+  {
+    avlt<int, int>  tree;
+
+    srand(n);
+    for (int i = 0; i < n; ++i)
+    {
+      tree.insert(rand() % (4 * n), i);
+    }
+
+    frozen_avlt<int, int>  frozen = tree.freeze();
+
+    REQUIRE(frozen.size() == tree.size());
+
+    for (int key = -1; key <= 4 * n; ++key)
+    {
+      int a = -7, b = -7;
+      REQUIRE(frozen.search(key, a) == tree.search(key, b));
+      REQUIRE(a == b);
+      REQUIRE(frozen[key] == tree[key]);
+    }
+
+    REQUIRE(frozen.range_search(INT32_MIN, INT32_MAX) == tree.range_search(INT32_MIN, INT32_MAX));
+    REQUIRE(frozen.range_search(n, 2 * n) == tree.range_search(n, 2 * n));
+    REQUIRE(frozen.range_search(4 * n, 5 * n).empty());
+  }
+}
+
+TEST_CASE("(33) frozen snapshot operator() and independence")
+{
+  avlt<string, int>  tree;
+
+  for (string word : { "delta", "alpha", "echo", "bravo", "charlie" })
+  {
+    tree.insert(word, (int) word.size());
+  }
+
+  frozen_avlt<string, int>  frozen = tree.freeze();
+
+  REQUIRE(frozen("alpha") == "bravo");
+  REQUIRE(frozen("charlie") == "delta");
+  REQUIRE(frozen("echo") == "");
+  REQUIRE(frozen("zulu") == "");
+
+  tree.insert("foxtrot", 7);
+  tree.erase("alpha");
+
+  REQUIRE(frozen.size() == 5);
+  REQUIRE(frozen["alpha"] == 5);
+  REQUIRE(frozen["foxtrot"] == 0);
+
+  vector<pair<int, int>> pairs = { {1, 10}, {2, 20}, {3, 30} };
+  frozen_avlt<int, int>  direct(pairs.begin(), pairs.end());
+  REQUIRE(direct[2] == 20);
+  REQUIRE(direct.range_search(2, 9) == vector<int>({ 2, 3 }));
+
+  //
+  // 1..7 in order builds a perfect tree in both, so () must agree
+  // whether it follows a right child (4 -> 6) or a thread (5 -> 6):
+  //
+  avlt<int, int>  perfect;
+  for (int key = 1; key <= 7; ++key)
+  {
+    perfect.insert(key, key);
+  }
+
+  frozen_avlt<int, int>  frozenPerfect = perfect.freeze();
+  for (int key = 0; key <= 8; ++key)
+  {
+    REQUIRE(frozenPerfect(key) == perfect(key));
+  }
+  REQUIRE(frozenPerfect(4) == 6);
+}
@@ -0,0 +1,140 @@
+/*test11.cpp*/
+
+//
+// Unit tests for the block-laid-out frozen snapshot (SIMD search)
+//
+
+#include <iostream>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+
+#ifndef AVLT_TEST_HOOKS
+#error "test11.cpp looks inside frozen_btree: build with -DAVLT_TEST_HOOKS, as the makefile does"
+#endif
+
+#include "avlt.h"
+#include "frozen_btree.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(34) frozen_btree<int> agrees with the tree")
+{
+  for (int n : { 0, 1, 15, 16, 17, 272, 273, 5000 })
+  {
+    avlt<int, int>  tree;
+
+    srand(n + 1);
+    for (int i = 0; i < n; ++i)
+    {
+      tree.insert(rand() % (3 * n) - n, i);
+    }
+
+    frozen_btree<int, int>  frozen(tree);
+
+    REQUIRE(frozen.size() == tree.size());
+
+    for (int key = -n - 2; key <= 2 * n + 2; ++key)
+    {
+      int a = -7, b = -7;
+      REQUIRE(frozen.search(key, a) == tree.search(key, b));
+      REQUIRE(a == b);
+    }
+  }
+}
+
+TEST_CASE("(35) frozen_btree<int64_t> and extreme keys")
+{
+  avlt<int64_t, int>  tree;
+
+  int64_t big = numeric_limits<int64_t>::max();
+  int64_t small = numeric_limits<int64_t>::min();
+
+  for (int i = 0; i < 100; ++i)
+  {
+    tree.insert((int64_t) i << 40, i);
+  }
+
+  frozen_btree<int64_t, int>  frozen(tree);
+
+  int value;
+  REQUIRE(frozen.search((int64_t) 42 << 40, value));
+  REQUIRE(value == 42);
+  REQUIRE(!frozen.search(((int64_t) 42 << 40) + 1, value));
+  REQUIRE(!frozen.search(big, value));  // only padding holds this key
+  REQUIRE(!frozen.search(small, value));
+
+  tree.insert(big, -1);
+  tree.insert(small, -2);
+
+  frozen_btree<int64_t, int>  extremes(tree);
+  REQUIRE(extremes[big] == -1);
+  REQUIRE(extremes[small] == -2);
+  REQUIRE(extremes.size() == 102);
+
+  vector<pair<double, int>> pairs = { {-1.5, 1}, {0.25, 2}, {3.0, 3} };
+  frozen_btree<double, int>  doubles(pairs.begin(), pairs.end());
+  REQUIRE(doubles[0.25] == 2);
+  REQUIRE(doubles[0.5] == 0);
+}
+
+TEST_CASE("(68) copied snapshots keep their blocks on a cache line")
+{
+  typedef avlt_inspect<frozen_btree<int, int>>  inspect;
+
+  avlt<int, int>  tree;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    tree.insert(3 * i, i);
+  }
+
+  frozen_btree<int, int>  frozen(tree);
+  REQUIRE((uintptr_t) inspect::keys(frozen) % 64 == 0);
+
+  //
+  // the copies land wherever the allocator puts them; odd-sized blocks
+  // in between shift that around, so some buffers start off a boundary:
+  //
+  vector<frozen_btree<int, int>>  copies;
+  vector<vector<char>>  spacers;
+
+  for (int i = 0; i < 16; ++i)
+  {
+    spacers.push_back(vector<char>(16 * i + 8));
+
+    frozen_btree<int, int>  copy(frozen);
+    frozen_btree<int, int>  assigned;
+    assigned = frozen;
+
+    copies.push_back(copy);
+    copies.push_back(assigned);
+    copies.push_back(std::move(copy));
+  }
+
+  for (const frozen_btree<int, int>& copy : copies)
+  {
+    REQUIRE((uintptr_t) inspect::keys(copy) % 64 == 0);
+    REQUIRE(copy.size() == 1000);
+
+    for (int key = -1; key <= 3000; ++key)
+    {
+      bool present = (key >= 0 && key < 3000 && key % 3 == 0);
+      int value = -7;
+
+      REQUIRE(copy.search(key, value) == present);
+      if (present)
+        REQUIRE(value == key / 3);
+    }
+  }
+
+  const frozen_btree<int, int>&  same = frozen;
+  frozen = same;  // self-assignment keeps the snapshot
+  REQUIRE((uintptr_t) inspect::keys(frozen) % 64 == 0);
+  REQUIRE(frozen[2997] == 999);
+}
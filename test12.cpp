@@ -0,0 +1,97 @@
+/*test12.cpp*/
+
+//
+// Unit tests for batched lookups in the threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(36) search_batch on unsorted and sorted batches")
+{
+  avlt<int, int>  tree;
+
+  for (int key = 0; key < 3000; key += 3)
+  {
+    tree.insert(key, -key);
+  }
+
+  vector<int> keys;
+  srand(36);
+  for (int i = 0; i < 1000; ++i)
+  {
+    keys.push_back(rand() % 3100 - 50);
+  }
+
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    if (pass == 1)
+      sort(keys.begin(), keys.end());
+
+    vector<int> values;
+    vector<bool> found;
+    tree.search_batch(keys, values, found);
+
+    REQUIRE(values.size() == keys.size());
+    REQUIRE(found.size() == keys.size());
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      int value;
+      REQUIRE(found[i] == tree.search(keys[i], value));
+      if (found[i])
+        REQUIRE(values[i] == value);
+    }
+  }
+}
+
+TEST_CASE("(37) search_batch with raw arrays and edge cases")
+{
+  avlt<int, int>  tree;
+
+  int keys[] = { 5, 1, 9, 1, 7 };
+  int values[5] = { 0, 0, 0, 0, 0 };
+  bool found[5] = { true, true, true, true, true };
+
+  tree.search_batch(keys, 5, values, found);  // empty tree
+  for (bool f : found)
+    REQUIRE(!f);
+
+  for (int key : { 1, 5, 7 })
+  {
+    tree.insert(key, key * 10);
+  }
+
+  tree.search_batch(keys, 5, values, found);
+  REQUIRE(found[0]);
+  REQUIRE(values[0] == 50);
+  REQUIRE(found[1]);
+  REQUIRE(!found[2]);
+  REQUIRE(found[3]);
+  REQUIRE(values[3] == 10);
+  REQUIRE(values[4] == 70);
+
+  //
+  // sorted, with repeats and keys past the end:
+  //
+  int sorted[] = { 0, 1, 1, 7, 8, 100 };
+  bool hits[6];
+  tree.search_batch(sorted, 6, values, hits);
+  REQUIRE(!hits[0]);
+  REQUIRE(hits[1]);
+  REQUIRE(hits[2]);
+  REQUIRE(hits[3]);
+  REQUIRE(!hits[4]);
+  REQUIRE(!hits[5]);
+
+  tree.search_batch(sorted, 0, values, hits);  // nothing to do
+}
@@ -0,0 +1,132 @@
+/*test13.cpp*/
+
+//
+// Unit tests for the move-aware insert / lookup API of the threaded AVL tree
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <utility>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// a value that counts how often it is constructed and copied:
+//
+struct Tracked
+{
+  static int Built;
+  static int Copies;
+
+  string Text;
+
+  Tracked() : Text() { Built++; }
+  Tracked(const string& a, const string& b) : Text(a + b) { Built++; }
+  Tracked(const Tracked& other) : Text(other.Text) { Built++; Copies++; }
+  Tracked(Tracked&& other) : Text(std::move(other.Text)) { Built++; }
+
+  Tracked& operator=(const Tracked& other) { Text = other.Text; Copies++; return *this; }
+  Tracked& operator=(Tracked&& other) { Text = std::move(other.Text); return *this; }
+};
+
+int Tracked::Built = 0;
+int Tracked::Copies = 0;
+
+
+TEST_CASE("(38) try_emplace, emplace and insert_or_assign")
+{
+  avlt<string, Tracked>  tree;
+
+  Tracked::Built = 0;
+  Tracked::Copies = 0;
+
+  auto r = tree.try_emplace("m", "ab", "cd");
+  REQUIRE(r.second);
+  REQUIRE(r.first.key() == "m");
+  REQUIRE(r.first.value().Text == "abcd");
+  REQUIRE(Tracked::Built == 1);
+
+  // duplicate: nothing is built
+  r = tree.try_emplace("m", "xx", "yy");
+  REQUIRE(!r.second);
+  REQUIRE(r.first.value().Text == "abcd");
+  REQUIRE(Tracked::Built == 1);
+
+  // emplace builds first, so a duplicate is built and thrown away
+  r = tree.emplace("m", "zz", "zz");
+  REQUIRE(!r.second);
+  REQUIRE(Tracked::Built == 2);
+  REQUIRE(tree["m"].Text == "abcd");
+
+  r = tree.emplace("c", "c", "1");
+  REQUIRE(r.second);
+  REQUIRE(tree.size() == 2);
+
+  // rvalue insert moves rather than copies
+  string key = "t";
+  Tracked value("t", "1");
+  tree.insert(std::move(key), std::move(value));
+  REQUIRE(tree["t"].Text == "t1");
+
+  r = tree.insert_or_assign("t", Tracked("t", "2"));
+  REQUIRE(!r.second);
+  REQUIRE(tree["t"].Text == "t2");
+
+  r = tree.insert_or_assign("a", Tracked("a", "1"));
+  REQUIRE(r.second);
+  REQUIRE(tree.size() == 4);
+  REQUIRE(Tracked::Copies == 0);
+
+  // plain insert still ignores duplicates
+  tree.insert("a", Tracked("a", "2"));
+  REQUIRE(tree["a"].Text == "a1");
+
+  vector<string> keys;
+  for (auto it = tree.cbegin(); it != tree.cend(); ++it)
+    keys.push_back(it.key());
+
+  REQUIRE(keys == vector<string>({ "a", "c", "m", "t" }));
+}
+
+TEST_CASE("(39) at and reference-returning lookups")
+{
+  avlt<int, string>  tree;
+
+  for (int key = 0; key < 1000; ++key)
+  {
+    tree.insert(key * 2, to_string(key));
+    REQUIRE(tree.height() <= 1.45 * log2(key + 2));
+  }
+
+  REQUIRE(tree.at(10) == "5");
+
+  tree.at(10) += "!";
+  REQUIRE(tree[10] == "5!");
+
+  const avlt<int, string>& ctree = tree;
+  REQUIRE(ctree.at(0) == "0");
+  REQUIRE_THROWS_AS(ctree.at(11), out_of_range);
+  REQUIRE_THROWS_AS(tree.at(-1), out_of_range);
+
+  // [] on a missing key gives a default without inserting
+  REQUIRE(tree[11] == "");
+  REQUIRE(tree.size() == 1000);
+
+  const string& ref = tree[1998];
+  REQUIRE(&ref == &tree.at(1998));
+
+  // erase still rebalances along the fixed path buffer
+  for (int key = 0; key < 2000; key += 4)
+    REQUIRE(tree.erase(key));
+
+  REQUIRE(tree.size() == 500);
+  REQUIRE(tree.height() <= 1.45 * log2(500 + 2));
+  REQUIRE(tree.at(2) == "1");
+}
@@ -0,0 +1,141 @@
+/*test14.cpp*/
+
+//
+// Unit tests for copying, moving and swapping threaded AVL trees
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <utility>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// returns every key of the tree in order, following the threads:
+//
+template<typename Tree>
+static vector<int> keysOf(const Tree& tree)
+{
+  vector<int> keys;
+  for (auto it = tree.cbegin(); it != tree.cend(); ++it)
+    keys.push_back(it.key());
+  return keys;
+}
+
+
+TEST_CASE("(40) copies are exact, independent and correctly threaded")
+{
+  //
+  // small trees take the sequential path, large ones the parallel one:
+  //
+  for (int n : { 0, 1, 2, 7, 100, 50000 })
+  {
+    avlt<int, int>* source = new avlt<int, int>();
+    vector<int> keys;
+
+    srand(40 + n);
+    for (int i = 0; i < n; ++i)
+    {
+      int key = rand() % (4 * n + 1);
+      source->insert(key, -key);
+    }
+    keys = keysOf(*source);
+
+    avlt<int, int> copy(*source);
+
+    REQUIRE(copy.size() == source->size());
+    REQUIRE(copy.height() == source->height());
+
+    for (int key : keys)
+    {
+      REQUIRE((copy % key) == (*source % key));  // same shape
+      REQUIRE(copy(key) == (*source)(key));      // same right links
+    }
+
+    avlt<int, int> assigned;
+    assigned.insert(-5, 5);
+    assigned = *source;
+
+    // the copies must not point back into the source
+    delete source;
+
+    REQUIRE(keysOf(copy) == keys);
+    REQUIRE(keysOf(assigned) == keys);
+
+    copy.insert(-1, 1);
+    REQUIRE(copy.size() == (int) keys.size() + 1);
+    REQUIRE(assigned.size() == (int) keys.size());
+
+    assigned = assigned;  // self-assignment keeps everything
+    REQUIRE(keysOf(assigned) == keys);
+  }
+}
+
+TEST_CASE("(41) move, swap and a throwing copy")
+{
+  avlt<int, string>  a;
+
+  for (int key = 0; key < 100; ++key)
+    a.insert(key, to_string(key));
+
+  auto it = a.find(42);
+
+  avlt<int, string> b(std::move(a));
+  REQUIRE(a.size() == 0);
+  REQUIRE(a.cbegin() == a.cend());
+  REQUIRE(b.size() == 100);
+  REQUIRE(it.value() == "42");  // nodes were not moved, only the tree
+
+  a.insert(7, "seven");
+
+  avlt<int, string> c;
+  c = std::move(b);
+  REQUIRE(b.size() == 0);
+  REQUIRE(c.size() == 100);
+
+  swap(a, c);
+  REQUIRE(a.size() == 100);
+  REQUIRE(c.size() == 1);
+  REQUIRE(c[7] == "seven");
+  REQUIRE(a[99] == "99");
+
+  b.insert(1, "one");  // moved-from trees are usable
+  REQUIRE(b[1] == "one");
+
+  //
+  // a copy that throws part way leaves nothing behind:
+  //
+  {
+    typedef avlt<int, Fragile> FragileTree;
+
+    FragileTree source;
+    for (int key = 0; key < 1000; ++key)
+      source.insert(key, Fragile(key));
+
+    int alive = Fragile::Alive;
+
+    Fragile::CopiesLeft = 500;
+    REQUIRE_THROWS_AS(FragileTree(source), runtime_error);
+    REQUIRE(Fragile::Alive == alive);
+
+    FragileTree target;
+    target.insert(-1, Fragile(-1));
+
+    Fragile::CopiesLeft = 10;
+    REQUIRE_THROWS_AS(target = source, runtime_error);
+    REQUIRE(target.size() == 1);
+    REQUIRE(target.at(-1).Data == -1);
+
+    Fragile::CopiesLeft = -1;
+  }
+  REQUIRE(Fragile::Alive == 0);
+}
@@ -0,0 +1,136 @@
+/*test15.cpp*/
+
+//
+// Unit tests for the order-statistic threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// checks rank, select and count_range against the sorted keys:
+//
+static void checkOrder(const avlt<int, int, true>& tree, const set<int>& expected)
+{
+  vector<int> keys(expected.begin(), expected.end());
+
+  REQUIRE(tree.size() == (int) keys.size());
+
+  for (int k = 0; k < (int) keys.size(); ++k)
+  {
+    auto it = tree.select(k);
+    REQUIRE(it != tree.cend());
+    REQUIRE(it.key() == keys[k]);
+    REQUIRE(tree.rank(keys[k]) == k);
+    REQUIRE(tree.rank(keys[k] + 1) == k + 1);
+  }
+
+  REQUIRE(tree.select(-1) == tree.cend());
+  REQUIRE(tree.select((int) keys.size()) == tree.cend());
+
+  for (int i = 0; i < 50; ++i)
+  {
+    int lower = rand() % 1100 - 50;
+    int upper = lower + rand() % 300 - 20;
+
+    int count = 0;
+    for (int key : keys)
+      if (lower <= key && key <= upper)
+        count++;
+
+    REQUIRE(tree.count_range(lower, upper) == count);
+    REQUIRE(tree.rank(lower) == (int) (lower_bound(keys.begin(), keys.end(), lower) - keys.begin()));
+  }
+}
+
+
+TEST_CASE("(42) rank, select and count_range through inserts and erases")
+{
+  avlt<int, int, true>  tree;
+  set<int>  expected;
+
+  REQUIRE(tree.rank(5) == 0);
+  REQUIRE(tree.count_range(0, 10) == 0);
+  REQUIRE(tree.select(0) == tree.cend());
+
+  srand(42);
+
+  for (int round = 0; round < 6; ++round)
+  {
+    for (int i = 0; i < 300; ++i)
+    {
+      int key = rand() % 1000;
+
+      tree.insert(key, key);
+      expected.insert(key);
+    }
+
+    for (int i = 0; i < 150; ++i)
+    {
+      int key = rand() % 1000;
+
+      REQUIRE(tree.erase(key) == (expected.erase(key) == 1));
+    }
+
+    checkOrder(tree, expected);
+  }
+
+  //
+  // the bulk paths rebuild the counts too:
+  //
+  int lower = 200, upper = 700;
+  tree.erase_range(lower, upper);
+  expected.erase(expected.lower_bound(lower), expected.upper_bound(upper));
+  checkOrder(tree, expected);
+
+  avlt<int, int, true> copy(tree);
+  checkOrder(copy, expected);
+
+  vector<pair<int, int>> pairs;
+  for (int key = 0; key < 1000; key += 3)
+    pairs.push_back(make_pair(key, key));
+
+  tree.assign_sorted(pairs.begin(), pairs.end());
+  expected.clear();
+  for (auto& p : pairs)
+    expected.insert(p.first);
+  checkOrder(tree, expected);
+
+  tree.insert_or_assign(1, 1);
+  tree.try_emplace(2, 2);
+  expected.insert(1);
+  expected.insert(2);
+  checkOrder(tree, expected);
+}
+
+TEST_CASE("(43) order statistics leave plain trees unchanged")
+{
+  // plain trees pay nothing for the count
+  REQUIRE(avlt<int, int>::node_bytes() == 32);
+  REQUIRE(avlt<int, int, true>::node_bytes() <= 40);
+
+  avlt<int, int, true>  tree;
+
+  for (int key = 1; key <= 100; ++key)
+    tree.insert(key * 10, key);
+
+  // percentile lookups
+  REQUIRE(tree.select(49).key() == 500);
+  REQUIRE(tree.select(98).value() == 99);
+  REQUIRE(tree.count_range(15, 55) == 4);
+  REQUIRE(tree.count_range(55, 15) == 0);
+  REQUIRE(tree.rank(1000) == 99);
+  REQUIRE(tree.rank(1001) == 100);
+  REQUIRE(tree.rank(-1) == 0);
+}
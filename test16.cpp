@@ -0,0 +1,124 @@
+/*test16.cpp*/
+
+//
+// Unit tests for range aggregates in the threaded AVL tree
+//
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <utility>
+#include <cstdlib>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(44) sum, min and max over key ranges")
+{
+  avlt<int, long, false, avlt_sum<long>>  sums;
+  avlt<int, long, true, avlt_min<long>>   mins;
+  avlt<int, long, false, avlt_max<long>>  maxs;
+  map<int, long>  expected;
+
+  REQUIRE(sums.aggregate(0, 100) == 0);
+  REQUIRE(mins.aggregate(0, 100) == numeric_limits<long>::max());
+
+  srand(44);
+
+  for (int round = 0; round < 4; ++round)
+  {
+    for (int i = 0; i < 400; ++i)
+    {
+      int key = rand() % 1000;
+      long value = rand() % 2001 - 1000;
+
+      sums.insert_or_assign(key, value);
+      mins.insert_or_assign(key, value);
+      maxs.insert_or_assign(key, value);
+      expected[key] = value;
+    }
+
+    for (int i = 0; i < 200; ++i)
+    {
+      int key = rand() % 1000;
+
+      sums.erase(key);
+      mins.erase(key);
+      maxs.erase(key);
+      expected.erase(key);
+    }
+
+    if (round == 2)  // the bulk path rebuilds the aggregates
+    {
+      sums.erase_range(100, 400);
+      mins.erase_range(100, 400);
+      maxs.erase_range(100, 400);
+      expected.erase(expected.lower_bound(100), expected.upper_bound(400));
+    }
+
+    for (int i = 0; i < 200; ++i)
+    {
+      int lower = rand() % 1100 - 50;
+      int upper = lower + rand() % 400 - 10;
+
+      long sum = 0;
+      long lo = numeric_limits<long>::max();
+      long hi = numeric_limits<long>::lowest();
+      int count = 0;
+
+      for (auto it = expected.lower_bound(lower); it != expected.end() && it->first <= upper; ++it)
+      {
+        sum += it->second;
+        lo = min(lo, it->second);
+        hi = max(hi, it->second);
+        count++;
+      }
+
+      REQUIRE(sums.aggregate(lower, upper) == sum);
+      REQUIRE(mins.aggregate(lower, upper) == lo);
+      REQUIRE(maxs.aggregate(lower, upper) == hi);
+      REQUIRE(mins.count_range(lower, upper) == count);
+    }
+  }
+
+  avlt<int, long, false, avlt_sum<long>> copy(sums);
+  long total = 0;
+  for (auto& p : expected)
+    total += p.second;
+
+  REQUIRE(copy.aggregate(-1, 1000) == total);
+}
+
+TEST_CASE("(45) a non-commutative aggregate combines in key order")
+{
+  // summing strings concatenates them, so order matters
+  avlt<int, string, false, avlt_sum<string>>  tree;
+
+  string letters = "abcdefghijklmnopqrstuvwxyz";
+
+  for (int i = 0; i < 26; ++i)
+  {
+    int key = (i * 7) % 26;  // scrambled insertion order
+    tree.insert(key, string(1, letters[key]));
+  }
+
+  REQUIRE(tree.aggregate(0, 25) == letters);
+  REQUIRE(tree.aggregate(3, 9) == "defghij");
+  REQUIRE(tree.aggregate(25, 100) == "z");
+  REQUIRE(tree.aggregate(9, 3) == "");
+
+  tree.insert_or_assign(4, string("E"));
+  tree.erase(5);
+  REQUIRE(tree.aggregate(3, 9) == "dEghij");
+
+  vector<pair<int, string>> pairs;
+  for (int i = 0; i < 10; ++i)
+    pairs.push_back(make_pair(i * 2, string(1, letters[i])));
+
+  tree.assign_sorted(pairs.begin(), pairs.end());
+  REQUIRE(tree.aggregate(1, 13) == "bcdefg");
+}
@@ -0,0 +1,161 @@
+/*test17.cpp*/
+
+//
+// Unit tests for binary snapshots of the threaded AVL tree
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "mapped_avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// flips bits of one byte of a file in place:
+//
+static void corrupt(const string& path, long offset, char mask = 0x5A)
+{
+  fstream file(path, ios::in | ios::out | ios::binary);
+  file.seekg(offset);
+  char c = (char) file.get();
+  file.seekp(offset);
+  file.put((char) (c ^ mask));
+}
+
+
+TEST_CASE("(46) save and load keep the exact tree")
+{
+  const string path = "test17_a.avlt";
+
+  avlt<int, double>  tree;
+
+  srand(46);
+  for (int i = 0; i < 5000; ++i)
+  {
+    int key = rand() % 20000;
+    tree.insert(key, key / 2.0);
+  }
+  for (int i = 0; i < 1000; ++i)
+    tree.erase(rand() % 20000);
+
+  REQUIRE(tree.save(path));
+
+  avlt<int, double> loaded;
+  loaded.insert(-1, -1);  // replaced by the load
+
+  REQUIRE(loaded.load(path));
+  REQUIRE(loaded.size() == tree.size());
+  REQUIRE(loaded.height() == tree.height());
+
+  auto it = tree.cbegin();
+  for (auto lit = loaded.cbegin(); lit != loaded.cend(); ++lit, ++it)
+  {
+    REQUIRE(lit.key() == it.key());
+    REQUIRE(lit.value() == it.value());
+    REQUIRE((loaded % lit.key()) == (tree % it.key()));  // same shape
+    REQUIRE(loaded(lit.key()) == tree(it.key()));        // same right links
+  }
+  REQUIRE(it == tree.cend());
+
+  // a loaded tree is a normal tree
+  loaded.insert(-5, 0.5);
+  REQUIRE(loaded.erase(tree.cbegin().key()));
+  REQUIRE(loaded.size() == tree.size());
+
+  // counts and aggregates are rebuilt on load
+  avlt<int, double, true, avlt_sum<double>> augmented;
+  REQUIRE(augmented.load(path));
+
+  double sum = 0;
+  int count = 0;
+  tree.range_for_each(100, 9000, [&](int, double value) { sum += value; count++; });
+
+  REQUIRE(augmented.count_range(100, 9000) == count);
+  REQUIRE(augmented.aggregate(100, 9000) == sum);
+
+  // empty trees round trip too
+  avlt<int, double> empty;
+  REQUIRE(empty.save(path));
+  REQUIRE(loaded.load(path));
+  REQUIRE(loaded.size() == 0);
+
+  remove(path.c_str());
+}
+
+TEST_CASE("(47) bad snapshots are rejected and mapped snapshots searched")
+{
+  const string path = "test17_b.avlt";
+
+  avlt<int, int>  tree;
+  for (int key = 0; key < 1000; ++key)
+    tree.insert(key * 2, key);
+
+  REQUIRE(tree.save(path));
+
+  avlt<int, int> loaded;
+  loaded.insert(7, 7);
+
+  REQUIRE(!loaded.load("no_such_file.avlt"));
+
+  avlt<long, int> wrongKeys;
+  REQUIRE(!wrongKeys.load(path));
+
+  avlt_file_header header = avlt_file_make_header<int, int>(1000);
+
+  corrupt(path, (long) header.HeightsAt + 500);  // an impossible height
+  REQUIRE(!loaded.load(path));
+  corrupt(path, (long) header.HeightsAt + 500);
+
+  corrupt(path, (long) header.HeightsAt + 500, 1);  // a wrong height
+  REQUIRE(!loaded.load(path));
+  corrupt(path, (long) header.HeightsAt + 500, 1);
+
+  corrupt(path, (long) header.KeysAt + 4 * 10);  // keys out of order
+  REQUIRE(!loaded.load(path));
+  corrupt(path, (long) header.KeysAt + 4 * 10);
+
+  corrupt(path, 0);  // bad magic
+  REQUIRE(!loaded.load(path));
+  corrupt(path, 0);
+
+  // failed loads leave the tree alone
+  REQUIRE(loaded.size() == 1);
+  REQUIRE(loaded[7] == 7);
+
+  REQUIRE(loaded.load(path));
+  REQUIRE(loaded.size() == 1000);
+
+  //
+  // the mapped view:
+  //
+  mapped_avlt<int, int> mapped;
+  REQUIRE(!mapped.is_open());
+  REQUIRE(mapped.open(path));
+  REQUIRE(mapped.size() == 1000);
+
+  int value = -1;
+  REQUIRE(mapped.search(1998, value));
+  REQUIRE(value == 999);
+  REQUIRE(!mapped.search(1999, value));
+  REQUIRE(!mapped.search(-2, value));
+  REQUIRE(mapped[500] == 250);
+  REQUIRE(mapped[501] == 0);
+  REQUIRE(mapped.range_search(9, 17) == vector<int>({ 10, 12, 14, 16 }));
+
+  mapped_avlt<int, long> wrongValues;
+  REQUIRE(!wrongValues.open(path));
+
+  mapped.close();
+  REQUIRE(mapped.size() == 0);
+
+  remove(path.c_str());
+}
@@ -0,0 +1,271 @@
+/*test18.cpp*/
+
+//
+// Unit tests for the crash-safe threaded AVL tree
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+
+#include <csignal>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "durable_avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+static const string DIR18 = "test18_db";
+
+static void removeDb()
+{
+  remove((DIR18 + "/checkpoint.avlt").c_str());
+  remove((DIR18 + "/checkpoint.avlt.tmp").c_str());
+  remove((DIR18 + "/log.wal").c_str());
+  rmdir(DIR18.c_str());
+}
+
+static string readFile(const string& path)
+{
+  ifstream in(path, ios::binary);
+  stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+static void writeFile(const string& path, const string& contents)
+{
+  ofstream out(path, ios::binary | ios::trunc);
+  out << contents;
+}
+
+static void checkSame(const durable_avlt<int, long>& tree, const map<int, long>& expected)
+{
+  REQUIRE(tree.size() == (int) expected.size());
+
+  for (auto& p : expected)
+  {
+    long value = -1;
+    REQUIRE(tree.search(p.first, value));
+    REQUIRE(value == p.second);
+  }
+}
+
+
+TEST_CASE("(48) a durable tree comes back after close and checkpoints")
+{
+  removeDb();
+  mkdir(DIR18.c_str(), 0755);
+
+  durable_options options;
+  options.GroupSize = 16;
+  options.CheckpointEvery = 500;  // so that a few happen on the way
+
+  map<int, long> expected;
+
+  {
+    durable_avlt<int, long> tree(options);
+    REQUIRE(tree.open(DIR18));
+    REQUIRE(tree.size() == 0);
+
+    srand(48);
+    for (int i = 0; i < 2000; ++i)
+    {
+      int key = rand() % 1000;
+      long value = rand();
+
+      switch (rand() % 3)
+      {
+        case 0:
+          tree.insert(key, value);
+          expected.insert(make_pair(key, value));
+          break;
+        case 1:
+          tree.insert_or_assign(key, value);
+          expected[key] = value;
+          break;
+        case 2:
+          REQUIRE(tree.erase(key) == (expected.erase(key) == 1));
+          break;
+      }
+    }
+
+    REQUIRE(tree.log_records() < 500);
+    checkSame(tree, expected);
+  }
+
+  durable_avlt<int, long> tree(options);
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+
+  //
+  // the last few changes, still pending, are written by sync():
+  //
+  tree.insert(5000, 1);
+  tree.erase(5000);
+  tree.insert_or_assign(5001, 2);
+  expected[5001] = 2;
+  REQUIRE(tree.sync());
+
+  string log = readFile(DIR18 + "/log.wal");
+
+  tree.close();
+  writeFile(DIR18 + "/log.wal", log);  // as if we had crashed right here
+
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+
+  tree.close();
+  removeDb();
+}
+
+TEST_CASE("(49) recovery survives torn logs and interrupted checkpoints")
+{
+  removeDb();
+  mkdir(DIR18.c_str(), 0755);
+
+  durable_options options;
+  options.GroupSize = 1;
+  options.Fsync = false;
+  options.CheckpointEvery = 0;
+
+  map<int, long> expected;
+  durable_avlt<int, long> tree(options);
+  REQUIRE(tree.open(DIR18));
+
+  for (int key = 0; key < 100; ++key)
+  {
+    tree.insert(key, key * 10);
+    expected[key] = key * 10;
+  }
+  for (int key = 0; key < 100; key += 3)
+  {
+    tree.erase(key);
+    expected.erase(key);
+  }
+  REQUIRE(tree.sync());
+
+  //
+  // a crash between the new snapshot and the log truncation replays
+  // the old log over the snapshot:
+  //
+  string log = readFile(DIR18 + "/log.wal");
+  REQUIRE(tree.checkpoint());
+  REQUIRE(tree.log_records() == 0);
+  tree.close();
+
+  writeFile(DIR18 + "/log.wal", log);
+
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+
+  //
+  // a half-written record at the end is dropped:
+  //
+  tree.insert_or_assign(1, -1);
+  expected[1] = -1;
+  tree.close();
+
+  log = readFile(DIR18 + "/log.wal");
+  writeFile(DIR18 + "/log.wal", log + string(7, 'x'));
+
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+
+  // and the log was cut back, so new records follow good ones
+  tree.insert(1000, 1000);
+  expected[1000] = 1000;
+  tree.close();
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+
+  //
+  // a corrupt record ends the replay there:
+  //
+  tree.close();
+  log = readFile(DIR18 + "/log.wal");
+  log[log.size() - 1] ^= 0x40;  // inside the last record, insert 1000
+  writeFile(DIR18 + "/log.wal", log);
+  expected.erase(1000);
+
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+
+  // a log written for other types is refused
+  tree.close();
+  durable_avlt<long, long> other;
+  REQUIRE(!other.open(DIR18));
+
+  removeDb();
+}
+
+TEST_CASE("(67) a failed log write is cut back off the log")
+{
+  removeDb();
+  mkdir(DIR18.c_str(), 0755);
+
+  durable_options options;
+  options.GroupSize = 1;
+  options.Fsync = false;
+  options.CheckpointEvery = 0;
+
+  map<int, long> expected;
+  durable_avlt<int, long> tree(options);
+  REQUIRE(tree.open(DIR18));
+
+  for (int key = 0; key < 10; ++key)
+  {
+    tree.insert(key, key);
+    expected[key] = key;
+  }
+  REQUIRE(tree.sync());
+
+  struct stat info;
+  REQUIRE(stat((DIR18 + "/log.wal").c_str(), &info) == 0);
+  off_t size = info.st_size;
+
+  //
+  // a file size limit a few bytes past the end makes the next write
+  // stop partway through its record:
+  //
+  struct rlimit limit, saved;
+  REQUIRE(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+  limit = saved;
+  limit.rlim_cur = (rlim_t) size + 5;
+
+  signal(SIGXFSZ, SIG_IGN);
+  REQUIRE(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+  REQUIRE_THROWS_AS(tree.insert(100, 100), runtime_error);
+  expected[100] = 100;  // in the tree, and still pending
+
+  REQUIRE(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+  signal(SIGXFSZ, SIG_DFL);
+
+  // the torn bytes are gone, so the retry lands where a replay finds it
+  REQUIRE(stat((DIR18 + "/log.wal").c_str(), &info) == 0);
+  REQUIRE(info.st_size == size);
+
+  tree.insert(101, 101);
+  expected[101] = 101;
+  REQUIRE(tree.sync());
+  checkSame(tree, expected);
+
+  tree.close();
+  REQUIRE(tree.open(DIR18));
+  checkSame(tree, expected);
+  REQUIRE(tree.log_records() == 12);
+
+  tree.close();
+  removeDb();
+}
@@ -0,0 +1,128 @@
+/*test19.cpp*/
+
+//
+// Unit tests for appends and hinted inserts in the threaded AVL tree
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(50) appends of increasing keys")
+{
+  avlt<int, int, true>  tree;
+  set<int>  expected;
+
+  for (int key = 0; key < 3000; ++key)
+  {
+    tree.insert(key, key);
+    expected.insert(key);
+
+    if (key % 499 == 0)
+      checkTree(tree, expected);
+  }
+
+  checkTree(tree, expected);
+  REQUIRE(tree.height() <= 1.45 * log2(3000 + 2));
+  REQUIRE(tree.rank(1500) == 1500);
+
+  //
+  // erases drop the cached spine; appends afterwards find it again:
+  //
+  for (int key = 2990; key < 3000; ++key)
+  {
+    tree.erase(key);
+    expected.erase(key);
+  }
+  tree.erase(100);
+  expected.erase(100);
+
+  for (int key = 5000; key < 5500; ++key)
+  {
+    tree.insert(key, key);
+    expected.insert(key);
+
+    if (key % 3 == 0)  // inserts elsewhere in between
+    {
+      tree.insert(key % 1000 + 10000 * (key % 2), key);
+      expected.insert(key % 1000 + 10000 * (key % 2));
+    }
+  }
+
+  checkTree(tree, expected);
+  REQUIRE(tree.select(tree.size() - 1).key() == *expected.rbegin());
+}
+
+TEST_CASE("(51) insert_hint with nearly sorted keys")
+{
+  avlt<int, int>  tree;
+  set<int>  expected;
+
+  srand(51);
+
+  // timestamps that arrive up to 20 late
+  for (int t = 0; t < 5000; ++t)
+  {
+    int key = t - rand() % 20;
+
+    auto it = tree.insert_hint(tree.cend(), key, t);
+    expected.insert(key);
+
+    REQUIRE(it.key() == key);
+  }
+
+  checkTree(tree, expected);
+
+  // a hint elsewhere still inserts correctly
+  auto it = tree.insert_hint(tree.find(2500), -7, 7);
+  REQUIRE(it.key() == -7);
+  REQUIRE(tree[-7] == 7);
+  expected.insert(-7);
+
+  // a key already there is found, not replaced
+  int present = *next(expected.begin(), 4000);
+  it = tree.insert_hint(tree.cend(), present, -1);
+  REQUIRE(it.key() == present);
+  REQUIRE(it.value() != -1);
+
+  // copies and moves don't share the spine
+  avlt<int, int> copy(tree);
+  copy.insert(100000, 1);
+  tree.insert(200000, 2);
+  expected.insert(200000);
+  checkTree(tree, expected);
+
+  avlt<int, int> moved(std::move(copy));
+  moved.insert(100001, 1);
+  REQUIRE(moved.size() == (int) expected.size() + 1);
+
+  swap(moved, tree);
+  tree.insert(300000, 3);
+  REQUIRE(tree.size() == (int) expected.size() + 2);
+
+  // appends to a loaded or bulk built tree start the spine from scratch
+  vector<pair<int, int>> pairs;
+  for (int key = 0; key < 100; ++key)
+    pairs.push_back(make_pair(key, key));
+
+  tree.assign_sorted(pairs.begin(), pairs.end());
+  expected.clear();
+  for (int key = 0; key < 200; ++key)
+  {
+    tree.insert_hint(tree.cend(), key, key);
+    expected.insert(key);
+  }
+
+  checkTree(tree, expected);
+}
@@ -0,0 +1,150 @@
+/*test20.cpp*/
+
+//
+// Unit tests for union, intersection and difference of threaded AVL trees
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(52) union, intersection and difference")
+{
+  srand(52);
+
+  for (int round = 0; round < 60; ++round)
+  {
+    avlt<int, int>  a, b;
+    set<int>  keysA, keysB;
+
+    // small and large, disjoint and overlapping, empty now and then
+    int sizeA = (round % 10 == 0) ? 0 : rand() % (round < 30 ? 40 : 4000);
+    int sizeB = (round % 7 == 0) ? 0 : rand() % (round < 30 ? 40 : 4000);
+    int range = 1 + rand() % 8000;
+
+    for (int i = 0; i < sizeA; ++i)
+    {
+      int key = rand() % range;
+      a.insert(key, 1);
+      keysA.insert(key);
+    }
+    for (int i = 0; i < sizeB; ++i)
+    {
+      int key = rand() % range + (round % 4 == 0 ? range : 0);
+      b.insert(key, 2);
+      keysB.insert(key);
+    }
+
+    set<int> both, either, onlyA;
+
+    for (int key : keysA)
+    {
+      either.insert(key);
+      (keysB.count(key) ? both : onlyA).insert(key);
+    }
+    for (int key : keysB)
+      either.insert(key);
+
+    avlt<int, int> unite(a), intersect(a), subtract(a);
+
+    unite.union_with(b);  // a copy of b
+    intersect.intersect_with(b);
+    subtract.difference_with(std::move(b));
+
+    checkTree(unite, either);
+    checkTree(intersect, both);
+    checkTree(subtract, onlyA);
+
+    // this tree's values win
+    for (int key : keysA)
+      REQUIRE(unite[key] == 1);
+    for (auto it = intersect.cbegin(); it != intersect.cend(); ++it)
+      REQUIRE(it.value() == 1);
+
+    // the moved tree is left empty, and usable
+    REQUIRE(b.size() == 0);
+    REQUIRE(b.begin() == b.end());
+    b.insert(5, 5);
+    REQUIRE(b[5] == 5);
+
+    // the results are normal trees
+    unite.insert(-1, -1);
+    either.insert(-1);
+    if (!keysA.empty())
+    {
+      REQUIRE(unite.erase(*keysA.begin()));
+      either.erase(*keysA.begin());
+    }
+    checkTree(unite, either);
+  }
+}
+
+TEST_CASE("(53) set operations keep counts and aggregates, and share nodes safely")
+{
+  typedef avlt<int, long, true, avlt_sum<long>> Tree;
+
+  Tree a;
+  set<int> expected;
+
+  for (int key = 0; key < 3000; key += 2)
+  {
+    a.insert(key, key);
+    expected.insert(key);
+  }
+
+  {
+    Tree delta;
+    for (int key = 1; key < 600; key += 6)
+    {
+      delta.insert(key, key);
+      expected.insert(key);
+    }
+    delta.insert(100, -1000);  // a already has 100
+
+    a.union_with(std::move(delta));
+  }  // delta's memory now holds some of a's nodes
+
+  checkTree(a, expected);
+  REQUIRE(a[100] == 100);
+  REQUIRE(a.rank(1001) == 501 + 100);
+  REQUIRE(a.count_range(1, 599) == 299 + 100);
+
+  long sum = 0;
+  for (int key : expected)
+    if (key <= 700)
+      sum += key;
+  REQUIRE(a.aggregate(0, 700) == sum);
+
+  Tree evens;
+  for (int key = 0; key < 3000; key += 2)
+    evens.insert(key, 0);
+
+  a.difference_with(evens);
+
+  set<int> odds;
+  for (int key = 1; key < 600; key += 6)
+    odds.insert(key);
+  checkTree(a, odds);
+  REQUIRE(a.select(0).key() == 1);
+  REQUIRE(a.aggregate(0, 3000) == 100 * 298);  // 1 + 7 + ... + 595
+
+  a.intersect_with(Tree());
+  checkTree(a, set<int>());
+
+  // growing again reuses what the pool took over
+  for (int key = 0; key < 500; ++key)
+    a.insert(key, 1);
+  REQUIRE(a.rank(250) == 250);
+  REQUIRE(a.aggregate(0, 1000) == 500);
+}
@@ -0,0 +1,154 @@
+/*test21.cpp*/
+
+//
+// Unit tests for split and concat of threaded AVL trees
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(54) split at any key, then concat back")
+{
+  typedef avlt<int, int> Tree;
+
+  srand(54);
+
+  for (int round = 0; round < 40; ++round)
+  {
+    Tree tree;
+    set<int> keys;
+
+    int n = (round == 0) ? 0 : rand() % (round < 20 ? 30 : 3000);
+    for (int i = 0; i < n; ++i)
+    {
+      int key = rand() % 5000;
+      tree.insert(key, key);
+      keys.insert(key);
+    }
+
+    // at a key in the tree, between keys, and past either end
+    int at = (round % 3 == 0 || keys.empty()) ? rand() % 5200 - 100 : *next(keys.begin(), rand() % keys.size());
+
+    auto halves = Tree::split(std::move(tree), at);
+
+    set<int> less(keys.begin(), keys.lower_bound(at));
+    set<int> more(keys.lower_bound(at), keys.end());
+
+    REQUIRE(tree.size() == 0);
+    checkTree(halves.first, less);
+    checkTree(halves.second, more);
+
+    // the halves are normal trees
+    halves.first.insert(-1, -1);
+    less.insert(-1);
+    halves.second.insert(10000, 0);
+    more.insert(10000);
+    if (!more.empty())
+    {
+      halves.second.erase(*more.begin());
+      more.erase(more.begin());
+    }
+
+    Tree whole = Tree::concat(std::move(halves.first), std::move(halves.second));
+
+    keys = less;
+    keys.insert(more.begin(), more.end());
+    checkTree(whole, keys);
+  }
+}
+
+TEST_CASE("(55) split and concat with counts, copies and bad input")
+{
+  typedef avlt<int, long, true, avlt_sum<long>> Tree;
+
+  Tree tree;
+  for (int key = 0; key < 1000; ++key)
+    tree.insert(key, key);
+
+  // a copied tree is left alone
+  auto halves = Tree::split(tree, 600);
+  REQUIRE(tree.size() == 1000);
+
+  REQUIRE(halves.first.size() == 600);
+  REQUIRE(halves.second.size() == 400);
+  REQUIRE(halves.second.rank(700) == 100);
+  REQUIRE(halves.first.aggregate(0, 1000) == 599L * 600 / 2);
+  REQUIRE(halves.second.select(0).key() == 600);
+
+  // the other way round isn't allowed
+  Tree first(halves.first);
+  REQUIRE_THROWS_AS(Tree::concat(halves.second, first), invalid_argument);
+
+  // shards handed off and back, while the original memory is gone
+  Tree low, high;
+  {
+    auto parts = Tree::split(std::move(halves.first), 300);
+    low = std::move(parts.first);
+    high = Tree::concat(std::move(parts.second), std::move(halves.second));
+  }
+
+  REQUIRE(low.size() == 300);
+  REQUIRE(high.size() == 700);
+  REQUIRE(high.aggregate(0, 1000) == 999L * 1000 / 2 - 299L * 300 / 2);
+
+  Tree all = Tree::concat(std::move(low), std::move(high));
+  REQUIRE(all.size() == 1000);
+  REQUIRE(all.rank(999) == 999);
+
+  set<int> keys;
+  for (int key = 0; key < 1000; ++key)
+    keys.insert(key);
+  checkTree(all, keys);
+
+  // sizes are exact even with no counts to go by, whichever half is smaller
+  avlt<int, int> plain;
+  for (int key = 0; key < 100; ++key)
+    plain.insert(key, key);
+
+  auto parts = avlt<int, int>::split(std::move(plain), 30);
+  REQUIRE(parts.first.size() == 30);
+  REQUIRE(parts.second.size() == 70);
+  parts.first.insert(1000, 0);
+  REQUIRE(parts.first.size() == 31);
+  parts.second.erase(50);
+  REQUIRE(parts.second.size() == 69);
+
+  auto more = avlt<int, int>::split(std::move(parts.second), 95);
+  REQUIRE(more.first.size() == 64);
+  REQUIRE(more.second.size() == 5);
+
+  for (int key : { -1, 30, 1001 })  // one half empty, or both whole
+  {
+    auto ends = avlt<int, int>::split(parts.first, key);
+    REQUIRE(ends.first.size() + ends.second.size() == 31);
+    REQUIRE(ends.first.size() == (key < 0 ? 0 : key == 30 ? 30 : 31));
+  }
+
+  avlt<int, int> joined = avlt<int, int>::concat(std::move(more.first), std::move(more.second));
+  joined.union_with(parts.first);
+  REQUIRE(joined.size() == 100);
+
+  // halves changed before anyone asks their size still count right
+  auto late = avlt<int, int>::split(std::move(joined), 50);
+  late.first.insert(-5, 0);
+  late.first.erase(10);
+  late.second.erase_range(60, 69);
+  vector<pair<int, int>> batch = { {2000, 0}, {2001, 0}, {55, 0} };
+  late.second.insert_bulk(batch.begin(), batch.end());
+  avlt<int, int> rejoined = avlt<int, int>::concat(std::move(late.first), std::move(late.second));
+  REQUIRE(rejoined.size() == 100 + 1 - 1 - 10 + 2);
+  REQUIRE(vector<int>(rejoined.begin(), rejoined.end()).size() == 92);
+}
@@ -0,0 +1,152 @@
+/*test22.cpp*/
+
+//
+// Unit tests for bulk inserts of unsorted batches into threaded AVL trees
+//
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <stdexcept>
+#include <utility>
+#include <cstdio>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(56) bulk inserts of small and large unsorted batches")
+{
+  avlt<int, int>  tree;
+  map<int, int>  expected;
+
+  srand(56);
+
+  // into an empty tree, then batches both small and large next to it
+  for (int size : { 5000, 10, 300, 20000, 1, 0, 4000 })
+  {
+    vector<pair<int, int>> batch;
+
+    for (int i = 0; i < size; ++i)
+    {
+      int key = rand() % 50000;
+      batch.push_back(make_pair(key, i));
+      expected.insert(make_pair(key, i));  // the first of a key wins, as in the tree
+    }
+
+    tree.insert_bulk(batch.begin(), batch.end());
+    checkTree(tree, expected);
+  }
+
+  // from a map, and mixed with single inserts and erases
+  map<int, int> more;
+  for (int key = -100; key < 0; ++key)
+    more[key] = key;
+
+  tree.insert_bulk(more.begin(), more.end());
+  expected.insert(more.begin(), more.end());
+
+  tree.insert(60000, 1);
+  expected[60000] = 1;
+  tree.erase(-50);
+  expected.erase(-50);
+
+  checkTree(tree, expected);
+
+  //
+  // a tree too big to stay in cache takes a small batch sorted, one
+  // insert at a time; keys already there and repeats keep the first value
+  //
+  vector<pair<int, int>> evens;
+  for (int key = 0; key < 140000; key += 2)
+    evens.push_back(make_pair(key, -key));
+
+  avlt<int, int>  big(evens.begin(), evens.end());
+  expected.clear();
+  expected.insert(evens.begin(), evens.end());
+
+  vector<pair<int, int>> batch;
+  for (int i = 0; i < 3000; ++i)
+  {
+    int key = rand() % 150000;
+    batch.push_back(make_pair(key, i));
+    expected.insert(make_pair(key, i));
+  }
+
+  big.insert_bulk(batch.begin(), batch.end());
+  checkTree(big, expected);
+}
+
+TEST_CASE("(57) bulk inserts keep counts and aggregates, and fail cleanly")
+{
+  avlt<int, int, true, avlt_sum<long>>  tree;
+
+  vector<pair<int, int>> batch;
+  for (int key = 999; key >= 0; --key)
+    batch.push_back(make_pair(key, 1));
+
+  tree.insert_bulk(batch.begin(), batch.end());
+  REQUIRE(tree.size() == 1000);
+  REQUIRE(tree.rank(500) == 500);
+  REQUIRE(tree.aggregate(0, 999) == 1000);
+
+  // a small batch is inserted a key at a time
+  batch.clear();
+  for (int key = 2000; key > 1000; key -= 100)
+    batch.push_back(make_pair(key, 2));
+  batch.push_back(make_pair(5, 100));  // already there, not replaced
+
+  tree.insert_bulk(batch.begin(), batch.end());
+  REQUIRE(tree.size() == 1010);
+  REQUIRE(tree.rank(1500) == 1004);
+  REQUIRE(tree.aggregate(0, 5000) == 1000 + 20);
+
+  //
+  // a copy that throws partway leaves the tree as it was, both on the
+  // rebuild path and a key at a time:
+  //
+  avlt<int, Fragile> fragile;
+  for (int key = 0; key < 100; ++key)
+    fragile.insert(key, Fragile(key));
+
+  int alive = Fragile::Alive;
+
+  for (int size : { 500, 3 })
+  {
+    vector<pair<int, Fragile>> values;
+    for (int key = 0; key < size; ++key)
+      values.push_back(make_pair(1000 + key, Fragile(key)));
+
+    // how many copies a bulk insert makes, so it can fail at the last
+    int used;
+    {
+      avlt<int, Fragile> scratch(fragile);
+
+      Fragile::CopiesLeft = 1000000;
+      scratch.insert_bulk(values.begin(), values.end());
+      used = 1000000 - Fragile::CopiesLeft;
+      Fragile::CopiesLeft = -1;
+    }
+
+    alive = Fragile::Alive;
+
+    for (int copies : { 0, used / 2, used - 1 })
+    {
+      Fragile::CopiesLeft = copies;
+      REQUIRE_THROWS_AS(fragile.insert_bulk(values.begin(), values.end()), runtime_error);
+      Fragile::CopiesLeft = -1;
+
+      REQUIRE(Fragile::Alive == alive);
+      REQUIRE(fragile.size() == 100);
+      REQUIRE(fragile.at(50).Data == 50);
+      REQUIRE(fragile.find(1000) == fragile.end());
+    }
+  }
+}
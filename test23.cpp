@@ -0,0 +1,221 @@
+/*test23.cpp*/
+
+//
+// Unit tests for the instrumentation counters of threaded AVL trees
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cstdint>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+TEST_CASE("(58) stats count lookups, rotations, allocations and thread hops")
+{
+  avlt<int, int, false, avlt_no_aggregate, avlt_stats<>>  tree;
+
+  tree.insert(3, 3);
+  tree.insert(2, 2);
+  tree.insert(1, 1);  // left left: one right rotation
+  tree.insert(5, 5);
+  tree.insert(4, 4);  // right left: a right and a left rotation
+
+  avlt_stats_snapshot s = tree.stats();
+  REQUIRE(s.SingleRotations == 1);
+  REQUIRE(s.DoubleRotations == 1);
+  REQUIRE(s.RightRotations == 2);
+  REQUIRE(s.LeftRotations == 1);
+  REQUIRE(s.Allocations == 5);
+  REQUIRE(s.Nexts == 0);
+
+  tree.reset_stats();
+  s = tree.stats();
+  REQUIRE(s.Lookups == 0);
+  REQUIRE(s.Allocations == 0);
+
+  //
+  // the tree is 2 over (1, 4 over (3, 5)); 3 is found two levels down,
+  // with one three-way comparison at each node:
+  //
+  int value;
+  REQUIRE(tree.search(3, value));
+  s = tree.stats();
+  REQUIRE(s.Lookups == 1);
+  REQUIRE(s.PathNodes == 3);
+  REQUIRE(s.Comparisons == 3);
+
+  REQUIRE(tree.find(42) == tree.end());
+  REQUIRE(tree.stats().Lookups == 2);
+
+  // the leaves 1, 3 and 5 are left by their threads
+  int key;
+  tree.begin();
+  while (tree.next(key))
+    ;
+  s = tree.stats();
+  REQUIRE(s.Nexts == 5);
+  REQUIRE(s.ThreadHops == 3);
+
+  // erases rotate too
+  tree.reset_stats();
+  REQUIRE(tree.erase(1));
+  REQUIRE(tree.erase(2));
+  s = tree.stats();
+  REQUIRE(s.Lookups == 2);
+  REQUIRE(s.LeftRotations + s.RightRotations >= 1);
+  REQUIRE(s.SingleRotations + s.DoubleRotations == 0);
+
+  // a copy counts from zero, starting with the nodes it copied
+  auto copy(tree);
+  REQUIRE(copy.stats().Allocations == 3);
+  REQUIRE(copy.stats().Lookups == 0);
+
+  //
+  // a run of appends needs a rotation about every other insert, all of
+  // them single:
+  //
+  tree.reset_stats();
+  for (int key = 10; key < 1010; ++key)
+    tree.insert(key, key);
+
+  s = tree.stats();
+  REQUIRE(s.Allocations == 1000);
+  REQUIRE(s.DoubleRotations == 0);
+  REQUIRE(s.SingleRotations >= 900);
+  REQUIRE(s.SingleRotations <= 1000);
+
+  // without the policy there is nothing to count
+  avlt<int, int>  plain;
+  for (int key = 0; key < 100; ++key)
+    plain.insert(key, key);
+  REQUIRE(plain.search(50, value));
+
+  s = plain.stats();
+  REQUIRE(s.Lookups == 0);
+  REQUIRE(s.Allocations == 0);
+  REQUIRE(s.SingleRotations == 0);
+
+  // an aggregate walks its two boundary paths as one lookup
+  avlt<int, long, false, avlt_sum<long>, avlt_stats<>>  sums;
+  for (int key = 0; key < 100; ++key)
+    sums.insert(key, key);
+
+  sums.reset_stats();
+  REQUIRE(sums.aggregate(10, 19) == 145);
+  s = sums.stats();
+  REQUIRE(s.Lookups == 1);
+  REQUIRE(s.PathNodes >= 2);
+  REQUIRE(s.PathNodes <= 3 * 8);
+}
+
+TEST_CASE("(59) per-thread histograms of lookups")
+{
+  typedef avlt_stats<true> Histograms;
+
+  avlt<int, int, true, avlt_no_aggregate, Histograms>  tree;
+
+  for (int key = 0; key < 1023; ++key)  // a perfect tree of height 9
+    tree.insert(key, key);
+
+  tree.reset_stats();
+
+  const avlt<int, int, true, avlt_no_aggregate, Histograms>& readOnly = tree;
+  const int THREADS = 4;
+  const int LOOKUPS = 1000;
+
+  vector<uint64_t> lookups(THREADS), longest(THREADS);
+  vector<thread> threads;
+
+  for (int t = 0; t < THREADS; ++t)
+  {
+    threads.push_back(thread([&, t]()
+    {
+      for (int i = 0; i < LOOKUPS; ++i)
+      {
+        int value;
+        readOnly.search((i * 7 + t) % 1023, value);
+      }
+
+      // this thread's histogram holds its lookups, and only them
+      const avlt_stats_histogram& h = Histograms::thread_histogram();
+      for (int b = 0; b < avlt_stats_histogram::BUCKETS; ++b)
+      {
+        lookups[t] += h.PathNodes[b];
+        if (h.PathNodes[b] > 0)
+          longest[t] = b;
+      }
+    }));
+  }
+
+  for (thread& t : threads)
+    t.join();
+
+  for (int t = 0; t < THREADS; ++t)
+  {
+    REQUIRE(lookups[t] == LOOKUPS);
+    REQUIRE(longest[t] <= 10);
+  }
+
+  // the tree's counts are the sum over all of them
+  avlt_stats_snapshot s = tree.stats();
+  REQUIRE(s.Lookups == THREADS * LOOKUPS);
+  REQUIRE(s.PathNodes <= THREADS * LOOKUPS * 10);
+  REQUIRE(s.Comparisons == s.PathNodes);
+
+  // the main thread's histogram gets its own lookups
+  const avlt_stats_histogram& mine = Histograms::thread_histogram();
+  uint64_t before = 0;
+  for (int b = 0; b < avlt_stats_histogram::BUCKETS; ++b)
+    before += mine.Comparisons[b];
+
+  int value;
+  REQUIRE(tree.search(511, value));  // the root
+  REQUIRE(mine.Comparisons[1] >= 1);
+
+  uint64_t after = 0;
+  for (int b = 0; b < avlt_stats_histogram::BUCKETS; ++b)
+    after += mine.Comparisons[b];
+  REQUIRE(after == before + 1);
+
+  //
+  // every other descent from the root is a lookup too; in the perfect
+  // tree of 0..1022, 511 is the root and 0 is ten levels down:
+  //
+  tree.reset_stats();
+  REQUIRE(tree(511) == tree.select(767).key());
+  REQUIRE(tree % 0 == 0);
+  s = tree.stats();
+  REQUIRE(s.Lookups == 3);
+  REQUIRE(s.PathNodes == 1 + 2 + 10);
+
+  REQUIRE(tree.rank(100) == 100);
+  REQUIRE(tree.count_range(100, 199) == 100);
+  REQUIRE(tree.stats().Lookups == 3 + 1 + 2);
+
+  //
+  // search_batch reports each key: unsorted ones as lockstep descents,
+  // sorted ones after the first as walks along the threads, here one
+  // step each, every other one over a thread:
+  //
+  vector<int> values;
+  vector<bool> found;
+
+  tree.reset_stats();
+  tree.search_batch({ 511, 0, 767, 2000 }, values, found);
+  s = tree.stats();
+  REQUIRE(s.Lookups == 4);
+  REQUIRE(s.PathNodes == 1 + 10 + 2 + 10);
+  REQUIRE(s.Comparisons == s.PathNodes);
+
+  tree.reset_stats();
+  tree.search_batch({ 0, 1, 2, 3, 4 }, values, found);
+  s = tree.stats();
+  REQUIRE(s.Lookups == 5);
+  REQUIRE(s.ThreadHops == 2);  // 0 -> 1 and 2 -> 3 leave leaves
+}
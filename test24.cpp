@@ -0,0 +1,235 @@
+/*test24.cpp*/
+
+//
+// Unit tests for comparators and lookups by other key types in threaded
+// AVL trees
+//
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <cstdio>
+#include <cstdlib>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include "avlt.h"
+#include "testutil.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// descending order, with a three-way compare() that counts its calls:
+//
+struct Descending
+{
+  static int Calls;
+
+  bool operator()(int a, int b) const { Calls++; return b < a; }
+  int compare(int a, int b) const { Calls++; return (b < a) ? -1 : (a < b ? 1 : 0); }
+};
+
+int Descending::Calls = 0;
+
+//
+// orders by key % Modulus, which is chosen at run time:
+//
+struct Modular
+{
+  int Modulus;
+
+  explicit Modular(int modulus = 1) : Modulus(modulus) { }
+
+  bool operator()(int a, int b) const { return a % Modulus < b % Modulus; }
+};
+
+//
+// a key that counts how many are made, compared with ints:
+//
+struct Id
+{
+  static int Made;
+
+  int Number;
+
+  Id(int number) : Number(number) { Made++; }
+  Id(const Id& other) : Number(other.Number) { Made++; }
+  Id& operator=(const Id& other) { Number = other.Number; return *this; }
+};
+
+int Id::Made = 0;
+
+bool operator<(const Id& a, const Id& b) { return a.Number < b.Number; }
+bool operator<(const Id& a, int b) { return a.Number < b; }
+bool operator<(int a, const Id& b) { return a < b.Number; }
+
+
+TEST_CASE("(60) trees ordered by a custom comparator")
+{
+  typedef avlt<int, int, true, avlt_sum<int>, avlt_stats<>, Descending> Tree;
+
+  Tree  tree;
+  map<int, int, greater<int>>  expected;
+
+  srand(60);
+
+  for (int i = 0; i < 3000; ++i)
+  {
+    int key = rand() % 5000;
+    tree.insert(key, 1);
+    expected.insert(make_pair(key, 1));
+  }
+
+  checkTree(tree, expected);
+
+  // the largest key comes first, and every query follows the order
+  REQUIRE(tree.begin().key() == expected.begin()->first);
+  REQUIRE(tree.rank(2500) == (int) distance(expected.begin(), expected.lower_bound(2500)));
+  REQUIRE(tree.lower_bound(2500).key() == expected.lower_bound(2500)->first);
+  REQUIRE(tree.count_range(4000, 1000) == (int) distance(expected.lower_bound(4000), expected.upper_bound(1000)));
+  REQUIRE(tree.count_range(1000, 4000) == 0);
+  REQUIRE(tree.aggregate(4000, 1000) == tree.count_range(4000, 1000));
+
+  vector<int> keys;
+  for (auto it = expected.lower_bound(4000); it != expected.upper_bound(3990); ++it)
+    keys.push_back(it->first);
+  REQUIRE(tree.range_search(4000, 3990) == keys);
+
+  // a three-way compare() means one comparison per level
+  for (int key : { expected.begin()->first, expected.rbegin()->first, 2500, -1 })
+  {
+    int value;
+    int calls = Descending::Calls;
+    tree.reset_stats();
+
+    REQUIRE(tree.search(key, value) == (expected.count(key) == 1));
+    REQUIRE(Descending::Calls - calls == (int) tree.stats().PathNodes);
+  }
+
+  // erases, bulk inserts, and the join-based operations all keep the order
+  for (int key = 0; key < 5000; key += 3)
+  {
+    tree.erase(key);
+    expected.erase(key);
+  }
+
+  vector<pair<int, int>> batch;
+  for (int key = 6000; key > 4000; key -= 7)
+  {
+    batch.push_back(make_pair(key, 1));
+    expected.insert(make_pair(key, 1));
+  }
+  tree.insert_bulk(batch.begin(), batch.end());
+  checkTree(tree, expected);
+
+  auto halves = Tree::split(tree, 3000);  // keys before 3000, i.e. larger
+  REQUIRE(halves.first.begin().key() == expected.begin()->first);
+  REQUIRE(halves.second.begin().key() == expected.lower_bound(3000)->first);
+  REQUIRE_THROWS_AS(Tree::concat(halves.second, halves.first), invalid_argument);
+
+  tree = Tree::concat(std::move(halves.first), std::move(halves.second));
+  checkTree(tree, expected);
+
+  Tree odds;
+  for (int key = 1; key < 7000; key += 2)
+    odds.insert(key, 0);
+
+  tree.difference_with(odds);
+  for (auto it = expected.begin(); it != expected.end(); )
+    it = (it->first % 2) ? expected.erase(it) : next(it);
+  checkTree(tree, expected);
+
+  //
+  // a comparator with state comes in through the constructor, and goes
+  // along with copies, moves and splits:
+  //
+  typedef avlt<int, int, false, avlt_no_aggregate, avlt_no_stats, Modular> ModTree;
+
+  ModTree mod(Modular(10));
+  for (int key = 0; key < 100; ++key)
+    mod.insert(key, key);  // only 0..9 go in, the rest are the same keys
+
+  REQUIRE(mod.size() == 10);
+  REQUIRE(mod[25] == 5);
+  REQUIRE(mod.key_comp().Modulus == 10);
+
+  ModTree copy(mod);
+  copy.insert(17, 17);
+  REQUIRE(copy.size() == 10);
+
+  auto parts = ModTree::split(std::move(copy), 15);
+  REQUIRE(parts.first.size() == 5);
+  parts.first.insert(33, 33);
+  REQUIRE(parts.first.size() == 5);
+  REQUIRE(parts.first.key_comp().Modulus == 10);
+}
+
+TEST_CASE("(61) lookups by other key types with a transparent comparator")
+{
+  // no Id is made to look one up
+  avlt<Id, int, true, avlt_no_aggregate, avlt_no_stats, avlt_less<>>  ids;
+
+  for (int number = 0; number < 1000; number += 2)
+    ids.insert(Id(number), number);
+
+  int made = Id::Made;
+  int value;
+
+  REQUIRE(ids.search(500, value));
+  REQUIRE(value == 500);
+  REQUIRE(!ids.search(501, value));
+  REQUIRE(ids.find(600) != ids.end());
+  REQUIRE(ids.find(601) == ids.end());
+  REQUIRE(ids.lower_bound(601).key().Number == 602);
+  REQUIRE(ids.at(998) == 998);
+  REQUIRE_THROWS_AS(ids.at(999), out_of_range);
+  REQUIRE(ids.rank(601) == 301);
+
+  const auto& readOnly = ids;
+  REQUIRE(readOnly.find(2).value() == 2);
+  REQUIRE(readOnly.at(4) == 4);
+
+  REQUIRE(Id::Made == made);
+
+  //
+  // strings, searched with C strings and, under C++17, string_views;
+  // the default comparator uses string::compare, one call per level:
+  //
+  avlt<string, int, false, avlt_no_aggregate, avlt_no_stats, avlt_less<>>  names;
+  avlt<string, int>  plain;
+
+  const char* words[] = { "pear", "apple", "fig", "kiwi", "plum", "lime", "date" };
+  for (int i = 0; i < 7; ++i)
+  {
+    names.insert(words[i], i);
+    plain.insert(words[i], i);
+  }
+
+  REQUIRE(names.search("kiwi", value));
+  REQUIRE(value == 3);
+  REQUIRE(names.lower_bound("grape").key() == "kiwi");
+  REQUIRE(names.find("grape") == names.end());
+
+  REQUIRE(plain.search("fig", value));  // through a string, as before
+  REQUIRE(value == 2);
+  REQUIRE(plain.begin().key() == "apple");
+
+#if __cplusplus >= 201703L
+  string text = "a lime and a date";
+  string_view lime(text.data() + 2, 4);
+
+  REQUIRE(names.search(lime, value));
+  REQUIRE(value == 5);
+  REQUIRE(names.at(string_view(text.data() + 13, 4)) == 6);
+  REQUIRE(names.find(string_view(text.data(), 1)) == names.end());
+#endif
+}
@@ -0,0 +1,171 @@
+/*test25.cpp*/
+
+//
+// Unit tests for the neighbor queries of threaded AVL trees: upper_bound,
+// ceiling, floor, successor and predecessor
+//
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include <iterator>
+#include <functional>
+#include <cstdlib>
+
+#include "avlt.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// the floor (or predecessor) of key in a std::set, or keys.end():
+//
+static set<int>::const_iterator setFloor(const set<int>& keys, int key, bool inclusive)
+{
+  auto it = inclusive ? keys.upper_bound(key) : keys.lower_bound(key);
+
+  return it == keys.begin() ? keys.end() : prev(it);
+}
+
+//
+// checks the tree's answer to a query against the set's:
+//
+template<typename It, typename Tree>
+static void checkAnswer(It it, const Tree& tree, set<int>::const_iterator expected, const set<int>& keys)
+{
+  if (expected == keys.end())
+    REQUIRE(it == tree.cend());
+  else
+  {
+    REQUIRE(it != tree.cend());
+    REQUIRE(it.key() == *expected);
+    REQUIRE(it.value() == 2 * *expected);
+  }
+}
+
+
+TEST_CASE("(62) upper_bound, ceiling, floor, successor and predecessor")
+{
+  avlt<int, int>  tree;
+  set<int>  keys;
+
+  // an empty tree has no neighbors
+  REQUIRE(tree.floor(5) == tree.end());
+  REQUIRE(tree.ceiling(5) == tree.end());
+  REQUIRE(tree.successor(5) == tree.end());
+  REQUIRE(tree.predecessor(5) == tree.end());
+  REQUIRE(tree.upper_bound(5) == tree.end());
+
+  srand(62);
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    int key = 10 * (rand() % 1000);
+    tree.insert(key, 2 * key);
+    keys.insert(key);
+  }
+
+  const avlt<int, int>& readOnly = tree;
+
+  // keys in the tree, between keys, and past both ends
+  for (int key = -15; key <= 10015; key += 5)
+  {
+    checkAnswer(tree.upper_bound(key), tree, keys.upper_bound(key), keys);
+    checkAnswer(tree.successor(key), tree, keys.upper_bound(key), keys);
+    checkAnswer(tree.ceiling(key), tree, keys.lower_bound(key), keys);
+    checkAnswer(tree.floor(key), tree, setFloor(keys, key, true), keys);
+    checkAnswer(tree.predecessor(key), tree, setFloor(keys, key, false), keys);
+
+    checkAnswer(readOnly.upper_bound(key), tree, keys.upper_bound(key), keys);
+    checkAnswer(readOnly.floor(key), tree, setFloor(keys, key, true), keys);
+    checkAnswer(readOnly.predecessor(key), tree, setFloor(keys, key, false), keys);
+  }
+
+  //
+  // a scan goes on from the answer without searching again: the keys
+  // from the floor of 5001 through the last one <= 7003
+  //
+  vector<int> scanned, expected;
+
+  auto stop = tree.upper_bound(7003);
+  for (auto it = tree.floor(5001); it != stop; ++it)
+    scanned.push_back(it.key());
+
+  for (auto it = setFloor(keys, 5001, true); it != keys.upper_bound(7003); ++it)
+    expected.push_back(*it);
+
+  REQUIRE(scanned == expected);
+
+  // answers are handles into the tree
+  auto it = tree.successor(*keys.begin());
+  it.value() = -1;
+  REQUIRE(tree[*next(keys.begin())] == -1);
+}
+
+TEST_CASE("(63) neighbor queries with other orders and key types")
+{
+  //
+  // plain is ordered by <, reversed by std::greater; in reversed the
+  // floor of a key is the nearest larger number, the ceiling the nearest
+  // smaller one:
+  //
+  avlt<int, int, true, avlt_no_aggregate, avlt_no_stats, avlt_less<>>  plain;
+  avlt<int, int, true, avlt_no_aggregate, avlt_no_stats, greater<int>>  reversed;
+
+  for (int key = 0; key < 100; key += 10)
+  {
+    plain.insert(key, key);
+    reversed.insert(key, key);
+  }
+
+  REQUIRE(plain.floor(55).key() == 50);
+  REQUIRE(plain.ceiling(55).key() == 60);
+  REQUIRE(plain.predecessor(50).key() == 40);
+  REQUIRE(plain.successor(50).key() == 60);
+  REQUIRE(plain.predecessor(0) == plain.end());
+  REQUIRE(plain.successor(90) == plain.end());
+
+  REQUIRE(reversed.floor(55).key() == 60);
+  REQUIRE(reversed.ceiling(55).key() == 50);
+  REQUIRE(reversed.predecessor(50).key() == 60);
+  REQUIRE(reversed.successor(50).key() == 40);
+  REQUIRE(reversed.predecessor(90) == reversed.end());
+  REQUIRE(reversed.successor(0) == reversed.end());
+
+  // ranks of the answers line up with the order
+  REQUIRE(plain.rank(plain.floor(55).key()) == 5);
+  REQUIRE(reversed.rank(reversed.floor(55).key()) == 3);
+
+  // a transparent comparator takes other key types
+  REQUIRE(plain.floor(55.5).key() == 50);
+  REQUIRE(plain.ceiling(50.5).key() == 60);
+  REQUIRE(plain.predecessor(0.5).key() == 0);
+
+  avlt<string, int, false, avlt_no_aggregate, avlt_no_stats, avlt_less<>>  names;
+  for (const char* name : { "ada", "bob", "cy", "dee" })
+    names.insert(name, 1);
+
+  REQUIRE(names.floor("bz").key() == "bob");
+  REQUIRE(names.successor("bob").key() == "cy");
+  REQUIRE(names.upper_bound("dee") == names.end());
+  REQUIRE(names.predecessor("ada") == names.end());
+
+  //
+  // a time-series index: the last sample at or before a time, and the
+  // next one after it
+  //
+  avlt<long, double>  samples;
+  for (long t = 1000; t <= 2000; t += 100)
+    samples.insert(t, t / 100.0);
+
+  auto at = samples.floor(1550);
+  REQUIRE(at.key() == 1500);
+  REQUIRE(at.value() == 15.0);
+  ++at;
+  REQUIRE(at.key() == 1600);
+  REQUIRE(samples.floor(999) == samples.end());
+  REQUIRE(samples.floor(5000).key() == 2000);
+}
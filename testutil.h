@@ -0,0 +1,279 @@
+/*testutil.h*/
+
+//
+// Helpers shared by the unit tests: a structural checker for avlt that
+// goes through its public interface, a tree-against-container
+// comparison built on it, access to frozen_btree's blocks (with
+// AVLT_TEST_HOOKS, see makefile), and a value whose copies can be made
+// to throw.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "avlt.h"
+#include "frozen_btree.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+
+//
+// avlt_check:
+//
+// check() returns "" if the tree is sound, otherwise what is wrong
+// first, using only the public interface.  Iterating must give size()
+// keys in order.  In a sound AVL tree the root of every subtree is the
+// one tallest node among its keys, so the shape is rebuilt from the
+// heights % reports, and then each node is checked: its height and
+// balance, height() at the root, () giving the right child or else the
+// successor its thread leads to, and rank / count_range or aggregate
+// around the node's subtree, where the tree keeps counts or aggregates.
+//
+template<typename Tree>
+struct avlt_check;
+
+template<typename KeyT, typename ValueT, bool OrderStatistics,
+         typename Aggregate, typename Stats, typename Compare>
+struct avlt_check<avlt<KeyT, ValueT, OrderStatistics, Aggregate, Stats, Compare>>
+{
+  typedef avlt<KeyT, ValueT, OrderStatistics, Aggregate, Stats, Compare> Tree;
+
+  static string check(const Tree& tree)
+  {
+    Compare comp = tree.key_comp();
+    vector<KeyT> keys;
+    vector<ValueT> values;
+    vector<int> heights;
+
+    for (auto it = tree.cbegin(); it != tree.cend(); ++it)
+    {
+      if (keys.size() > (size_t) tree.size())
+        return "more keys than size() (a cycle?)";
+      if (!keys.empty() && !comp(keys.back(), it.key()))
+        return "keys out of order at key #" + to_string(keys.size());
+
+      keys.push_back(it.key());
+      values.push_back(it.value());
+      heights.push_back(tree % it.key());
+    }
+
+    if ((int) keys.size() != tree.size())
+      return "size() is " + to_string(tree.size()) + " but the tree has " + to_string(keys.size()) + " keys";
+
+    SUBTREE whole = { tree, keys, values, heights, "" };
+    size_t root;
+    int height = whole.check(0, keys.size(), root);
+
+    if (whole.Problem.empty() && height != tree.height())
+      whole.Problem = "height() is " + to_string(tree.height()) + ", actual " + to_string(height);
+
+    return whole.Problem;
+  }
+
+private:
+  struct SUBTREE
+  {
+    const Tree&           T;
+    const vector<KeyT>&   Keys;
+    const vector<ValueT>& Values;
+    const vector<int>&    Heights;
+    string                Problem;
+
+    //
+    // checks the subtree holding keys [lo, hi) and returns its height,
+    // with its root in "root"
+    //
+    int check(size_t lo, size_t hi, size_t& root)
+    {
+      if (lo == hi || !Problem.empty())
+        return -1;
+
+      root = lo;
+      for (size_t i = lo + 1; i < hi; ++i)
+        if (Heights[i] > Heights[root])
+          root = i;
+
+      string at = " at key #" + to_string(root);
+
+      for (size_t i = lo; i < hi; ++i)
+        if (i != root && Heights[i] == Heights[root])
+        {
+          Problem = "no single tallest node for a subtree" + at;
+          return -1;
+        }
+
+      size_t left, right;
+      int HL = check(lo, root, left);
+      int HR = check(root + 1, hi, right);
+
+      if (!Problem.empty())
+        return -1;
+
+      //
+      // () is the right child's key, or where the thread goes: the
+      // successor of the subtree's largest key, or nothing:
+      //
+      KeyT next = HR >= 0 ? Keys[right] : hi < Keys.size() ? Keys[hi] : KeyT{};
+
+      if (Heights[root] != 1 + max(HL, HR))
+        Problem = "stored height " + to_string(Heights[root]) + ", actual " + to_string(1 + max(HL, HR)) + at;
+      else if (abs(HL - HR) > 1)
+        Problem = "out of balance" + at;
+      else if (!(T(Keys[root]) == next))
+        Problem = "right child or thread doesn't lead where it should" + at;
+      else if (!_augmentOk(lo, root, hi, integral_constant<bool, OrderStatistics>(),
+                           integral_constant<bool, !is_same<Aggregate, avlt_no_aggregate>::value>()))
+        Problem = "stale subtree count or aggregate" + at;
+
+      return 1 + max(HL, HR);
+    }
+
+    bool _augmentOk(size_t, size_t, size_t, false_type, false_type)
+    {
+      return true;
+    }
+
+    //
+    // the queries run from the key before the subtree to the key after
+    // it, so the subtree hangs off one of their boundary paths and its
+    // cached count or aggregate is what they read.  Nothing reads the
+    // aggregates on the outer spines or the counts of right children,
+    // so those are left unchecked.
+    //
+    void _around(size_t lo, size_t hi, size_t& first, size_t& last)
+    {
+      first = lo > 0 ? lo - 1 : lo;
+      last = hi < Keys.size() ? hi : hi - 1;
+    }
+
+    bool _augmentOk(size_t lo, size_t root, size_t hi, true_type, false_type)
+    {
+      size_t first, last;
+      _around(lo, hi, first, last);
+
+      return T.rank(Keys[root]) == (int) root &&
+             T.count_range(Keys[first], Keys[last]) == (int) (last - first + 1);
+    }
+
+    //
+    // folding the values of every subtree visits each key about once per
+    // ancestor, O(N lgN) in all:
+    //
+    bool _augmentOk(size_t lo, size_t, size_t hi, false_type, true_type)
+    {
+      size_t first, last;
+      _around(lo, hi, first, last);
+
+      typename Aggregate::type expected = Aggregate::identity();
+
+      for (size_t i = first; i <= last; ++i)
+        expected = Aggregate::combine(expected, Aggregate::lift(Values[i]));
+
+      return T.aggregate(Keys[first], Keys[last]) == expected;
+    }
+
+    bool _augmentOk(size_t lo, size_t root, size_t hi, true_type, true_type)
+    {
+      return _augmentOk(lo, root, hi, true_type(), false_type()) &&
+             _augmentOk(lo, root, hi, false_type(), true_type());
+    }
+  };
+};
+
+#ifdef AVLT_TEST_HOOKS
+//
+// avlt_inspect:
+//
+// Friend of frozen_btree when built with AVLT_TEST_HOOKS: keys() is
+// where block 0 starts, which should sit on a 64-byte boundary.
+//
+template<typename Tree>
+struct avlt_inspect;
+
+template<typename KeyT, typename ValueT>
+struct avlt_inspect<frozen_btree<KeyT, ValueT>>
+{
+  static const KeyT* keys(const frozen_btree<KeyT, ValueT>& frozen)
+  {
+    return frozen._keys();
+  }
+};
+#endif
+
+
+//
+// checkTree:
+//
+// Checks the tree is sound (see avlt_check) and holds exactly the
+// expected keys, in its order, walking the threads.  "expected" is a
+// std::set of keys or a std::map, whose values must match too.
+//
+template<typename It, typename K>
+void checkEntry(const It& it, const K& key)
+{
+  REQUIRE(it.key() == key);
+}
+
+template<typename It, typename K, typename V>
+void checkEntry(const It& it, const pair<const K, V>& entry)
+{
+  REQUIRE(it.key() == entry.first);
+  REQUIRE(it.value() == entry.second);
+}
+
+template<typename Tree, typename Expected>
+void checkTree(const Tree& tree, const Expected& expected)
+{
+  REQUIRE(avlt_check<Tree>::check(tree) == "");
+  REQUIRE(tree.size() == (int) expected.size());
+
+  auto it = tree.cbegin();
+  for (auto& entry : expected)
+  {
+    REQUIRE(it != tree.cend());
+    checkEntry(it, entry);
+    ++it;
+  }
+  REQUIRE(it == tree.cend());
+}
+
+
+//
+// Fragile:
+//
+// A value whose copy throws once a countdown runs out; set CopiesLeft
+// to the # of copies to allow (-1 for no limit).  Alive counts the
+// Fragiles in existence, so tests can tell nothing leaked.  The counters
+// live in a class template so that every test file shares one pair.
+//
+template<typename = void>
+struct FragileCounters
+{
+  static int CopiesLeft;
+  static int Alive;
+};
+
+template<typename T> int FragileCounters<T>::CopiesLeft = -1;
+template<typename T> int FragileCounters<T>::Alive = 0;
+
+struct Fragile : FragileCounters<>
+{
+  int Data;
+
+  Fragile(int data = 0) : Data(data) { Alive++; }
+  Fragile(const Fragile& other) : Data(other.Data)
+  {
+    if (CopiesLeft-- == 0)
+      throw runtime_error("copy failed");
+    Alive++;
+  }
+  Fragile& operator=(const Fragile& other) { Data = other.Data; return *this; }
+  ~Fragile() { Alive--; }
+};